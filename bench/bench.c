@@ -0,0 +1,253 @@
+// The benchmark suite: every grammar in grammars.c, on generated inputs from
+// 1 KB to 100 MB, with every backend that compiles it.
+//
+// Usage: bench [--max-size SIZE] [--grammar NAME] [--samples N] [--csv FILE]
+//              [--json FILE] [--baseline FILE] [--tolerance PERCENT]
+//
+// Corpora are generated from fixed seeds, so results from different builds
+// and machines compare case by case. With --baseline, a CSV file written by an
+// earlier run, the exit status is 1 if the median throughput of any case fell
+// by more than the tolerance (default 5%).
+
+#include "bench.h"
+
+#include "../src/platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define KB ((size_t)1024)
+#define MB (1024 * KB)
+
+static const size_t sizes[] = {KB, 64 * KB, MB, 16 * MB, 100 * MB};
+#define NSIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+// keep sampling until this much time has gone by, or MAX_SAMPLES
+#define SAMPLE_BUDGET_NS 500000000
+#define MIN_SAMPLES 3
+#define MAX_SAMPLES 30
+
+typedef struct {
+    const char *grammar;
+    const char *backend;
+    size_t bytes;
+    size_t samples;
+    double min_ns;
+    double median_ns;
+    double mean_ns;
+    double mb_per_s; // at the median
+} HBenchRow;
+
+typedef struct {
+    size_t max_size;
+    const char *grammar;
+    size_t samples; // 0 picks a number by time
+    const char *csv;
+    const char *json;
+    const char *baseline;
+    double tolerance;
+} HBenchConfig;
+
+static size_t parse_size(const char *s) {
+    char *end;
+    unsigned long long n = strtoull(s, &end, 10);
+    if (*end == 'K' || *end == 'k')
+        n *= KB, end++;
+    else if (*end == 'M' || *end == 'm')
+        n *= MB, end++;
+    if (end == s || *end)
+        h_platform_errx(1, "bad size %s; try 64K or 16M", s);
+    return (size_t)n;
+}
+
+// Parse every record of the corpus once. False if any fails.
+static bool parse_corpus(const HParser *parser, const HBenchCorpus *corpus) {
+    size_t start = 0;
+    for (size_t r = 0; r < corpus->nrecords; r++) {
+        HParseResult *res = h_parse(parser, corpus->data + start, corpus->ends[r] - start);
+        if (!res)
+            return false;
+        h_parse_result_free(res);
+        start = corpus->ends[r];
+    }
+    return true;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void measure(const HParser *parser, const HBenchCorpus *corpus, size_t nsamples,
+                    HBenchRow *row) {
+    double samples[MAX_SAMPLES];
+    int64_t spent = 0;
+    size_t n = 0;
+    double sum = 0;
+
+    if (nsamples > MAX_SAMPLES)
+        nsamples = MAX_SAMPLES;
+    while (nsamples ? n < nsamples
+                    : n < MIN_SAMPLES || (n < MAX_SAMPLES && spent < SAMPLE_BUDGET_NS)) {
+        int64_t start = h_platform_time_ns();
+        parse_corpus(parser, corpus);
+        int64_t t = h_platform_time_ns() - start;
+        spent += t;
+        samples[n++] = (double)t;
+        sum += (double)t;
+    }
+    qsort(samples, n, sizeof(double), cmp_double);
+    row->samples = n;
+    row->min_ns = samples[0];
+    row->median_ns = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+    row->mean_ns = sum / (double)n;
+    row->mb_per_s = row->median_ns > 0 ? (double)corpus->length * 1e3 / row->median_ns : 0;
+}
+
+static void write_csv(FILE *f, const HBenchRow *rows, size_t n) {
+    fputs("grammar,backend,bytes,samples,min_ns,median_ns,mean_ns,mb_per_s\n", f);
+    for (size_t i = 0; i < n; i++)
+        fprintf(f, "%s,%s,%zu,%zu,%.0f,%.0f,%.0f,%.3f\n", rows[i].grammar, rows[i].backend,
+                rows[i].bytes, rows[i].samples, rows[i].min_ns, rows[i].median_ns,
+                rows[i].mean_ns, rows[i].mb_per_s);
+}
+
+static void write_json(FILE *f, const HBenchRow *rows, size_t n) {
+    fputs("{\"cases\": [", f);
+    for (size_t i = 0; i < n; i++)
+        fprintf(f,
+                "%s\n  {\"grammar\": \"%s\", \"backend\": \"%s\", \"bytes\": %zu, "
+                "\"samples\": %zu, \"min_ns\": %.0f, \"median_ns\": %.0f, \"mean_ns\": %.0f, "
+                "\"mb_per_s\": %.3f}",
+                i ? "," : "", rows[i].grammar, rows[i].backend, rows[i].bytes, rows[i].samples,
+                rows[i].min_ns, rows[i].median_ns, rows[i].mean_ns, rows[i].mb_per_s);
+    fputs("\n]}\n", f);
+}
+
+static FILE *open_output(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f)
+        h_platform_errx(1, "cannot write %s", path);
+    return f;
+}
+
+// Compare with a CSV file from an earlier run. The number of cases that got
+// slower by more than the tolerance.
+static size_t compare(const char *path, const HBenchRow *rows, size_t n, double tolerance) {
+    FILE *f = fopen(path, "r");
+    char line[512], grammar[64], backend[64];
+    size_t bytes, samples, regressions = 0;
+    double min_ns, median_ns, mean_ns, mb_per_s;
+
+    if (!f)
+        h_platform_errx(1, "cannot read %s", path);
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "%63[^,],%63[^,],%zu,%zu,%lf,%lf,%lf,%lf", grammar, backend, &bytes,
+                   &samples, &min_ns, &median_ns, &mean_ns, &mb_per_s) != 8)
+            continue; // the header
+        for (size_t i = 0; i < n; i++) {
+            const HBenchRow *r = &rows[i];
+            if (strcmp(r->grammar, grammar) || strcmp(r->backend, backend) || r->bytes != bytes)
+                continue;
+            double change = mb_per_s > 0 ? (r->mb_per_s / mb_per_s - 1) * 100 : 0;
+            if (change < -tolerance) {
+                printf("REGRESSION %s/%s/%zu: %.2f MB/s, was %.2f (%+.1f%%)\n", grammar, backend,
+                       bytes, r->mb_per_s, mb_per_s, change);
+                regressions++;
+            }
+        }
+    }
+    fclose(f);
+    return regressions;
+}
+
+int main(int argc, char **argv) {
+    HBenchConfig config = {100 * MB, NULL, 0, NULL, NULL, NULL, 5};
+    HBenchRow *rows = NULL;
+    size_t nrows = 0;
+    int status = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i], *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!val)
+            h_platform_errx(1, "usage: %s [--max-size SIZE] [--grammar NAME] [--samples N] "
+                               "[--csv FILE] [--json FILE] [--baseline FILE] "
+                               "[--tolerance PERCENT]",
+                            argv[0]);
+        if (strcmp(arg, "--max-size") == 0)
+            config.max_size = parse_size(val);
+        else if (strcmp(arg, "--grammar") == 0)
+            config.grammar = val;
+        else if (strcmp(arg, "--samples") == 0)
+            config.samples = (size_t)strtoul(val, NULL, 10);
+        else if (strcmp(arg, "--csv") == 0)
+            config.csv = val;
+        else if (strcmp(arg, "--json") == 0)
+            config.json = val;
+        else if (strcmp(arg, "--baseline") == 0)
+            config.baseline = val;
+        else if (strcmp(arg, "--tolerance") == 0)
+            config.tolerance = strtod(val, NULL);
+        else
+            h_platform_errx(1, "unknown option %s", arg);
+        i++;
+    }
+
+    rows = calloc(bench_ngrammars * NSIZES * (PB_MAX - PB_MIN + 1), sizeof(HBenchRow));
+    printf("%-8s %-10s %10s %8s %14s %14s %10s\n", "grammar", "backend", "bytes", "samples",
+           "min us", "median us", "MB/s");
+    for (size_t g = 0; g < bench_ngrammars; g++) {
+        const HBenchGrammar *grammar = &bench_grammars[g];
+        if (config.grammar && strcmp(config.grammar, grammar->name) != 0)
+            continue;
+        HParser *parser = grammar->init();
+
+        for (size_t s = 0; s < NSIZES && sizes[s] <= config.max_size; s++) {
+            // seeded by name, so that adding a grammar leaves the others' corpora alone
+            HBenchCorpus corpus;
+            uint64_t seed = sizes[s];
+            for (const char *c = grammar->name; *c; c++)
+                seed = seed * 31 + (uint8_t)*c;
+            corpus_init(&corpus, seed);
+            grammar->generate(&corpus, sizes[s]);
+
+            for (int b = PB_MIN; b <= PB_MAX; b++) {
+                const char *backend = h_get_name_for_backend((HParserBackend)b);
+                if (!backend || h_compile(parser, (HParserBackend)b, NULL) != 0)
+                    continue;
+                if (!parse_corpus(parser, &corpus)) {
+                    printf("%-8s %-10s %10zu FAILED to parse its corpus\n", grammar->name,
+                           backend, corpus.length);
+                    status = 1;
+                    continue;
+                }
+                HBenchRow *row = &rows[nrows++];
+                row->grammar = grammar->name;
+                row->backend = backend;
+                row->bytes = corpus.length;
+                measure(parser, &corpus, config.samples, row);
+                printf("%-8s %-10s %10zu %8zu %14.1f %14.1f %10.2f\n", row->grammar,
+                       row->backend, row->bytes, row->samples, row->min_ns / 1e3,
+                       row->median_ns / 1e3, row->mb_per_s);
+                fflush(stdout);
+            }
+            corpus_free(&corpus);
+        }
+    }
+
+    if (config.csv) {
+        FILE *f = open_output(config.csv);
+        write_csv(f, rows, nrows);
+        fclose(f);
+    }
+    if (config.json) {
+        FILE *f = open_output(config.json);
+        write_json(f, rows, nrows);
+        fclose(f);
+    }
+    if (config.baseline && compare(config.baseline, rows, nrows, config.tolerance) > 0)
+        status = 1;
+    free(rows);
+    return status;
+}
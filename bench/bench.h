@@ -0,0 +1,42 @@
+#ifndef HAMMER_BENCH__H
+#define HAMMER_BENCH__H
+
+#include "../src/hammer.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A generated input. Most grammars parse the whole corpus in one go; for
+// those that parse one message at a time, each record is parsed on its own.
+typedef struct {
+    uint8_t *data;
+    size_t length;
+    size_t capacity;
+    size_t *ends; // where each record ends
+    size_t nrecords;
+    size_t rcapacity;
+    uint64_t rng;
+} HBenchCorpus;
+
+typedef struct {
+    const char *name;
+    HParser *(*init)(void);
+    // Fill corpus with about size bytes of valid input.
+    void (*generate)(HBenchCorpus *corpus, size_t size);
+} HBenchGrammar;
+
+extern const HBenchGrammar bench_grammars[];
+extern const size_t bench_ngrammars;
+
+void corpus_init(HBenchCorpus *corpus, uint64_t seed);
+void corpus_free(HBenchCorpus *corpus);
+void corpus_put(HBenchCorpus *corpus, const void *bytes, size_t n);
+void corpus_putc(HBenchCorpus *corpus, uint8_t c);
+void corpus_puts(HBenchCorpus *corpus, const char *s);
+void corpus_put_u16(HBenchCorpus *corpus, uint16_t v); // big-endian
+void corpus_put_u32(HBenchCorpus *corpus, uint32_t v);
+void corpus_end_record(HBenchCorpus *corpus);
+// A deterministic pseudo-random number in [0, n).
+uint32_t corpus_rand(HBenchCorpus *corpus, uint32_t n);
+
+#endif
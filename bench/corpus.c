@@ -0,0 +1,67 @@
+// Growable buffers for generated benchmark inputs.
+
+#include "bench.h"
+
+#include "../src/platform.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void corpus_init(HBenchCorpus *corpus, uint64_t seed) {
+    memset(corpus, 0, sizeof(*corpus));
+    corpus->rng = seed ? seed : 1;
+}
+
+void corpus_free(HBenchCorpus *corpus) {
+    free(corpus->data);
+    free(corpus->ends);
+    memset(corpus, 0, sizeof(*corpus));
+}
+
+void corpus_put(HBenchCorpus *corpus, const void *bytes, size_t n) {
+    if (corpus->length + n > corpus->capacity) {
+        size_t capacity = corpus->capacity ? corpus->capacity : 4096;
+        while (capacity < corpus->length + n)
+            capacity *= 2;
+        corpus->data = realloc(corpus->data, capacity);
+        if (!corpus->data)
+            h_platform_errx(1, "out of memory for a %zu byte corpus", capacity);
+        corpus->capacity = capacity;
+    }
+    memcpy(corpus->data + corpus->length, bytes, n);
+    corpus->length += n;
+}
+
+void corpus_putc(HBenchCorpus *corpus, uint8_t c) { corpus_put(corpus, &c, 1); }
+
+void corpus_puts(HBenchCorpus *corpus, const char *s) { corpus_put(corpus, s, strlen(s)); }
+
+void corpus_put_u16(HBenchCorpus *corpus, uint16_t v) {
+    uint8_t b[2] = {(uint8_t)(v >> 8), (uint8_t)v};
+    corpus_put(corpus, b, 2);
+}
+
+void corpus_put_u32(HBenchCorpus *corpus, uint32_t v) {
+    corpus_put_u16(corpus, (uint16_t)(v >> 16));
+    corpus_put_u16(corpus, (uint16_t)v);
+}
+
+void corpus_end_record(HBenchCorpus *corpus) {
+    if (corpus->nrecords == corpus->rcapacity) {
+        corpus->rcapacity = corpus->rcapacity ? corpus->rcapacity * 2 : 256;
+        corpus->ends = realloc(corpus->ends, corpus->rcapacity * sizeof(size_t));
+        if (!corpus->ends)
+            h_platform_errx(1, "out of memory for %zu records", corpus->rcapacity);
+    }
+    corpus->ends[corpus->nrecords++] = corpus->length;
+}
+
+// xorshift64*, so that every run and every machine sees the same corpus
+uint32_t corpus_rand(HBenchCorpus *corpus, uint32_t n) {
+    uint64_t x = corpus->rng;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    corpus->rng = x;
+    return (uint32_t)((x * 0x2545F4914F6CDD1DULL) >> 32) % n;
+}
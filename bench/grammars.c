@@ -0,0 +1,367 @@
+// The grammars of the benchmark suite, and generators for their inputs.
+//
+// Each generator writes records until the corpus reaches the requested
+// size, so every corpus is valid input, a little longer than asked for.
+
+#include "bench.h"
+
+#include "../src/glue.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#define ALPHA "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"
+#define DIGIT "0123456789"
+#define CHARSET(s) h_in((const uint8_t *)(s), sizeof(s) - 1)
+
+static const char base64_chars[] = ALPHA DIGIT "+/";
+
+///
+// DNS messages: the grammar of examples/dns.c, without its actions, which
+// print every message. Names in resource records are compression pointers
+// to the question's name, as most servers write them; that also keeps
+// h_many(question) from taking the first answer for a second question. One
+// record per message, as a server sees them.
+///
+
+typedef struct {
+    uint16_t id;
+    uint8_t qr, opcode, aa, tc, rd, ra, z, rcode;
+    uint16_t question_count, answer_count, authority_count, additional_count;
+} dns_header;
+
+static bool validate_header(HParseResult *p, void *user_data) {
+    return ((const dns_header *)p->ast->user)->z == 0;
+}
+
+static bool validate_message(HParseResult *p, void *user_data) {
+    const dns_header *h = h_seq_index(p->ast, 0)->user;
+    return H_FIELD_SEQ(1)->used == h->question_count &&
+           H_FIELD_SEQ(2)->used ==
+               (size_t)h->answer_count + h->authority_count + h->additional_count;
+}
+
+static HParser *init_dns(void) {
+    static const HStructField header_fields[] = {
+        H_STRUCT_FIELD(dns_header, id, 0, 16),
+        H_STRUCT_FIELD(dns_header, qr, 16, 1),
+        H_STRUCT_FIELD(dns_header, opcode, 17, 4),
+        H_STRUCT_FIELD(dns_header, aa, 21, 1),
+        H_STRUCT_FIELD(dns_header, tc, 22, 1),
+        H_STRUCT_FIELD(dns_header, rd, 23, 1),
+        H_STRUCT_FIELD(dns_header, ra, 24, 1),
+        H_STRUCT_FIELD(dns_header, z, 25, 3),
+        H_STRUCT_FIELD(dns_header, rcode, 28, 4),
+        H_STRUCT_FIELD(dns_header, question_count, 32, 16),
+        H_STRUCT_FIELD(dns_header, answer_count, 48, 16),
+        H_STRUCT_FIELD(dns_header, authority_count, 64, 16),
+        H_STRUCT_FIELD(dns_header, additional_count, 80, 16),
+    };
+    H_VRULE(header, h_struct(TT_USER, sizeof(dns_header), 96, header_fields,
+                             sizeof(header_fields) / sizeof(header_fields[0])));
+    H_RULE(type, h_int_range(h_uint16(), 1, 16));
+    H_RULE(qtype, h_choice(type, h_int_range(h_uint16(), 252, 255), NULL));
+    H_RULE(class, h_int_range(h_uint16(), 1, 4));
+    H_RULE(qclass, h_choice(class, h_int_range(h_uint16(), 255, 255), NULL));
+    H_RULE(len, h_int_range(h_uint8(), 1, 63));
+    H_RULE(label, h_length_value(len, h_uint8()));
+    H_RULE(name, h_sequence(h_many1(label), h_ch('\x00'), NULL));
+    H_RULE(pointer, h_int_range(h_uint16(), 0xc000, 0xffff));
+    H_RULE(question, h_sequence(name, qtype, qclass, NULL));
+    H_RULE(rdata, h_length_value(h_uint16(), h_uint8()));
+    H_RULE(rr, h_sequence(h_choice(pointer, name, NULL), type, class, h_uint32(), rdata, NULL));
+    H_VRULE(message, h_sequence(header, h_many(question), h_many(rr), h_end_p(), NULL));
+    return message;
+}
+
+static void dns_name(HBenchCorpus *c) {
+    for (uint32_t n = 2 + corpus_rand(c, 3); n > 0; n--) {
+        uint32_t len = 3 + corpus_rand(c, 8);
+        corpus_putc(c, (uint8_t)len);
+        while (len-- > 0)
+            corpus_putc(c, (uint8_t)('a' + corpus_rand(c, 26)));
+    }
+    corpus_putc(c, 0);
+}
+
+static void generate_dns(HBenchCorpus *c, size_t size) {
+    while (c->length < size) {
+        uint16_t an = (uint16_t)corpus_rand(c, 4), ar = (uint16_t)corpus_rand(c, 2);
+        corpus_put_u16(c, (uint16_t)corpus_rand(c, 65536));
+        corpus_put_u16(c, an > 0 ? 0x8180 : 0x0100); // a response or a recursive query
+        corpus_put_u16(c, 1);
+        corpus_put_u16(c, an);
+        corpus_put_u16(c, 0);
+        corpus_put_u16(c, ar);
+        dns_name(c);
+        corpus_put_u16(c, (uint16_t)(1 + corpus_rand(c, 16)));
+        corpus_put_u16(c, 1);
+        for (uint16_t i = 0; i < an + ar; i++) {
+            uint16_t type = (uint16_t)(1 + corpus_rand(c, 16));
+            uint16_t rdlength = type == 1 ? 4 : (uint16_t)corpus_rand(c, 32);
+            corpus_put_u16(c, 0xc00c); // the question's name, right after the header
+            corpus_put_u16(c, type);
+            corpus_put_u16(c, 1);
+            corpus_put_u32(c, 3600);
+            corpus_put_u16(c, rdlength);
+            while (rdlength-- > 0)
+                corpus_putc(c, (uint8_t)corpus_rand(c, 256));
+        }
+        corpus_end_record(c);
+    }
+}
+
+///
+// Base64: the grammar of examples/base64.c.
+///
+
+static HParser *init_base64(void) {
+    HParser *digit = h_ch_range(0x30, 0x39);
+    HParser *alpha = h_choice(h_ch_range(0x41, 0x5a), h_ch_range(0x61, 0x7a), NULL);
+
+    HParser *plus = h_ch('+');
+    HParser *slash = h_ch('/');
+    HParser *equals = h_ch('=');
+
+    HParser *bsfdig = h_choice(alpha, digit, plus, slash, NULL);
+    HParser *bsfdig_4bit = h_in((uint8_t *)"AEIMQUYcgkosw048", 16);
+    HParser *bsfdig_2bit = h_in((uint8_t *)"AQgw", 4);
+    HParser *base64_3 = h_repeat_n(bsfdig, 4);
+    HParser *base64_2 = h_sequence(bsfdig, bsfdig, bsfdig_4bit, equals, NULL);
+    HParser *base64_1 = h_sequence(bsfdig, bsfdig_2bit, equals, equals, NULL);
+    HParser *base64 =
+        h_sequence(h_many(base64_3), h_optional(h_choice(base64_2, base64_1, NULL)), NULL);
+
+    return h_sequence(h_whitespace(base64), h_whitespace(h_end_p()), NULL);
+}
+
+static void generate_base64(HBenchCorpus *c, size_t size) {
+    while (c->length + 4 < size) {
+        for (int i = 0; i < 4; i++)
+            corpus_putc(c, (uint8_t)base64_chars[corpus_rand(c, 64)]);
+    }
+    corpus_putc(c, (uint8_t)base64_chars[corpus_rand(c, 64)]);
+    corpus_putc(c, (uint8_t)"AQgw"[corpus_rand(c, 4)]);
+    corpus_puts(c, "==");
+    corpus_end_record(c);
+}
+
+///
+// JSON (RFC 8259): an array of records.
+///
+
+static HParser *init_json(void) {
+    H_RULE(ws, h_many(CHARSET(" \t\r\n")));
+#define TOKEN(p) h_left((p), ws)
+
+    H_RULE(hex, CHARSET(DIGIT "abcdefABCDEF"));
+    H_RULE(escape, h_sequence(h_ch('\\'),
+                              h_choice(CHARSET("\"\\/bfnrt"),
+                                       h_sequence(h_ch('u'), h_repeat_n(hex, 4), NULL), NULL),
+                              NULL));
+    H_RULE(unescaped, h_not_in((const uint8_t *)"\"\\\x00\x01\x02\x03\x04\x05\x06\x07\x08\x09"
+                                                "\x0a\x0b\x0c\x0d\x0e\x0f\x10\x11\x12\x13\x14"
+                                                "\x15\x16\x17\x18\x19\x1a\x1b\x1c\x1d\x1e\x1f",
+                                 34));
+    H_RULE(string, TOKEN(h_middle(h_ch('"'), h_many(h_choice(unescaped, escape, NULL)),
+                                  h_ch('"'))));
+
+    H_RULE(digits, h_many1(CHARSET(DIGIT)));
+    H_RULE(integer, h_choice(h_ch('0'), h_sequence(h_ch_range('1', '9'),
+                                                   h_many(CHARSET(DIGIT)), NULL),
+                             NULL));
+    H_RULE(frac, h_sequence(h_ch('.'), digits, NULL));
+    H_RULE(exp, h_sequence(CHARSET("eE"), h_optional(CHARSET("+-")), digits, NULL));
+    H_RULE(number, TOKEN(h_sequence(h_optional(h_ch('-')), integer, h_optional(frac),
+                                    h_optional(exp), NULL)));
+
+    HParser *value = h_indirect();
+    H_RULE(member, h_sequence(string, TOKEN(h_ch(':')), value, NULL));
+    H_RULE(object, h_middle(TOKEN(h_ch('{')), h_sepBy(member, TOKEN(h_ch(','))),
+                            TOKEN(h_ch('}'))));
+    H_RULE(array, h_middle(TOKEN(h_ch('[')), h_sepBy(value, TOKEN(h_ch(','))),
+                           TOKEN(h_ch(']'))));
+    h_bind_indirect(value, h_choice(object, array, string, number, TOKEN(h_literal("true")),
+                                    TOKEN(h_literal("false")), TOKEN(h_literal("null")), NULL));
+#undef TOKEN
+    return h_sequence(ws, value, h_end_p(), NULL);
+}
+
+static void json_word(HBenchCorpus *c) {
+    for (uint32_t n = 1 + corpus_rand(c, 12); n > 0; n--)
+        corpus_putc(c, (uint8_t)('a' + corpus_rand(c, 26)));
+}
+
+static void json_value(HBenchCorpus *c, int depth) {
+    char buf[64];
+    switch (corpus_rand(c, depth > 0 ? 7 : 5)) {
+    case 0:
+        snprintf(buf, sizeof(buf), "%d", (int)corpus_rand(c, 2000000) - 1000000);
+        corpus_puts(c, buf);
+        break;
+    case 1:
+        snprintf(buf, sizeof(buf), "%u.%02ue%d", corpus_rand(c, 1000), corpus_rand(c, 100),
+                 (int)corpus_rand(c, 20) - 10);
+        corpus_puts(c, buf);
+        break;
+    case 2:
+        corpus_putc(c, '"');
+        json_word(c);
+        corpus_puts(c, corpus_rand(c, 4) ? " " : "\\n\\u00e9 ");
+        json_word(c);
+        corpus_putc(c, '"');
+        break;
+    case 3:
+        corpus_puts(c, corpus_rand(c, 2) ? "true" : "false");
+        break;
+    case 4:
+        corpus_puts(c, "null");
+        break;
+    case 5:
+        corpus_putc(c, '[');
+        for (uint32_t n = corpus_rand(c, 5), i = 0; i < n; i++) {
+            if (i > 0)
+                corpus_puts(c, ", ");
+            json_value(c, depth - 1);
+        }
+        corpus_putc(c, ']');
+        break;
+    default:
+        corpus_putc(c, '{');
+        for (uint32_t n = corpus_rand(c, 5), i = 0; i < n; i++) {
+            corpus_puts(c, i > 0 ? ", \"" : "\"");
+            json_word(c);
+            corpus_puts(c, "\": ");
+            json_value(c, depth - 1);
+        }
+        corpus_putc(c, '}');
+        break;
+    }
+}
+
+static void generate_json(HBenchCorpus *c, size_t size) {
+    corpus_puts(c, "[\n");
+    for (int i = 0; c->length + 2 < size; i++) {
+        corpus_puts(c, i > 0 ? ",\n  {\"id\": " : "  {\"id\": ");
+        json_value(c, 0);
+        corpus_puts(c, ", \"name\": \"");
+        json_word(c);
+        corpus_puts(c, "\", \"data\": ");
+        json_value(c, 3);
+        corpus_putc(c, '}');
+    }
+    corpus_puts(c, "\n]\n");
+    corpus_end_record(c);
+}
+
+///
+// HTTP/1.1 request lines (RFC 7230, section 3.1.1), in origin form.
+///
+
+static HParser *init_http(void) {
+    H_RULE(tchar, CHARSET(ALPHA DIGIT "!#$%&'*+-.^_`|~"));
+    H_RULE(method, h_many1(tchar));
+    H_RULE(hex, CHARSET(DIGIT "abcdefABCDEF"));
+    H_RULE(pchar, h_choice(CHARSET(ALPHA DIGIT "-._~!$&'()*+,;=:@"),
+                           h_sequence(h_ch('%'), hex, hex, NULL), NULL));
+    H_RULE(path, h_many1(h_sequence(h_ch('/'), h_many(pchar), NULL)));
+    H_RULE(query, h_many(h_choice(pchar, CHARSET("/?"), NULL)));
+    H_RULE(target, h_sequence(path, h_optional(h_sequence(h_ch('?'), query, NULL)), NULL));
+    H_RULE(digit, CHARSET(DIGIT));
+    H_RULE(version, h_sequence(h_literal("HTTP/"), digit, h_ch('.'), digit, NULL));
+    H_RULE(request_line, h_sequence(method, h_ch(' '), target, h_ch(' '), version,
+                                    h_literal("\r\n"), NULL));
+    return h_sequence(h_many(request_line), h_end_p(), NULL);
+}
+
+static void generate_http(HBenchCorpus *c, size_t size) {
+    static const char *const methods[] = {"GET", "GET", "GET", "POST", "PUT", "DELETE", "HEAD"};
+    static const char *const words[] = {"api", "v1", "users", "items", "static", "img",
+                                        "search", "index.html", "a%20b", "~me"};
+
+    while (c->length < size) {
+        corpus_puts(c, methods[corpus_rand(c, 7)]);
+        corpus_putc(c, ' ');
+        for (uint32_t n = 1 + corpus_rand(c, 4); n > 0; n--) {
+            corpus_putc(c, '/');
+            corpus_puts(c, words[corpus_rand(c, 10)]);
+        }
+        if (corpus_rand(c, 2)) {
+            corpus_puts(c, "?q=");
+            corpus_puts(c, words[corpus_rand(c, 10)]);
+            corpus_puts(c, "&page=");
+            corpus_putc(c, (uint8_t)('0' + corpus_rand(c, 10)));
+        }
+        corpus_puts(c, corpus_rand(c, 8) ? " HTTP/1.1\r\n" : " HTTP/1.0\r\n");
+    }
+    corpus_end_record(c);
+}
+
+///
+// TLV: a stream of one-byte tags, two-byte big-endian lengths and values.
+///
+
+static HParser *init_tlv(void) {
+    H_RULE(tlv, h_sequence(h_uint8(), h_length_value(h_uint16(), h_uint8()), NULL));
+    return h_sequence(h_many(tlv), h_end_p(), NULL);
+}
+
+static void generate_tlv(HBenchCorpus *c, size_t size) {
+    while (c->length < size) {
+        // mostly short values, now and then a long one
+        uint16_t len = (uint16_t)(corpus_rand(c, 16) ? corpus_rand(c, 32) : corpus_rand(c, 1024));
+        corpus_putc(c, (uint8_t)corpus_rand(c, 256));
+        corpus_put_u16(c, len);
+        while (len-- > 0)
+            corpus_putc(c, (uint8_t)corpus_rand(c, 256));
+    }
+    corpus_end_record(c);
+}
+
+///
+// Arithmetic with left-recursive rules, one expression per line.
+///
+
+static HParser *init_arith(void) {
+    HParser *expr = h_indirect();
+    HParser *term = h_indirect();
+    H_RULE(number, h_many1(CHARSET(DIGIT)));
+    H_RULE(factor, h_choice(number, h_middle(h_ch('('), expr, h_ch(')')), NULL));
+    h_bind_indirect(term, h_choice(h_sequence(term, CHARSET("*/"), factor, NULL), factor, NULL));
+    h_bind_indirect(expr, h_choice(h_sequence(expr, CHARSET("+-"), term, NULL), term, NULL));
+    h_name(expr, "expr");
+    h_name(term, "term");
+    return h_sequence(h_many(h_left(expr, h_ch('\n'))), h_end_p(), NULL);
+}
+
+static void arith_expr(HBenchCorpus *c, int depth) {
+    char buf[16];
+    for (uint32_t n = 1 + corpus_rand(c, 8), i = 0; i < n; i++) {
+        if (i > 0)
+            corpus_putc(c, (uint8_t)"+-*/"[corpus_rand(c, 4)]);
+        if (depth > 0 && corpus_rand(c, 6) == 0) {
+            corpus_putc(c, '(');
+            arith_expr(c, depth - 1);
+            corpus_putc(c, ')');
+        } else {
+            snprintf(buf, sizeof(buf), "%u", corpus_rand(c, 100000));
+            corpus_puts(c, buf);
+        }
+    }
+}
+
+static void generate_arith(HBenchCorpus *c, size_t size) {
+    while (c->length < size) {
+        arith_expr(c, 3);
+        corpus_putc(c, '\n');
+    }
+    corpus_end_record(c);
+}
+
+const HBenchGrammar bench_grammars[] = {
+    {"dns", init_dns, generate_dns},       {"base64", init_base64, generate_base64},
+    {"json", init_json, generate_json},    {"http", init_http, generate_http},
+    {"tlv", init_tlv, generate_tlv},       {"arith", init_arith, generate_arith},
+};
+const size_t bench_ngrammars = sizeof(bench_grammars) / sizeof(bench_grammars[0]);
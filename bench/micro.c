@@ -0,0 +1,300 @@
+// Microbenchmarks of the primitives every parse relies on, each in isolation,
+// over a sweep of sizes and, where it matters, alignments.
+//
+// Usage: micro [--case NAME] [--csv FILE]
+//
+// Each result is the fastest of several samples, in nsec per operation. An
+// operation is one call of the primitive; where a case has to start over, as
+// a table that is full or an arena that has grown to a megabyte, the cost of
+// starting over is spread across the operations.
+
+#include "../src/hammer.h"
+#include "../src/internal.h"
+#include "../src/platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SAMPLE_NS 5000000
+#define SAMPLES 5
+
+#define DATA_SIZE (64 * 1024)
+#define KEYS (64 * 1024)
+#define ARENA_SPAN (1024 * 1024) // reset the arena after about this much
+
+static uint8_t data[DATA_SIZE + 64];
+static uintptr_t keys[KEYS];
+static volatile uint64_t sink; // results go here, so that no work is optimized away
+
+// state shared by a case's setup, run and teardown
+static HArena *arena;
+static HHashTable *table;
+static HCharset charset;
+
+typedef struct {
+    const char *name;
+    const char *param_name;
+    const char *align_name; // NULL if the case has no alignments to sweep
+    size_t params[6];       // up to the first 0
+    size_t aligns[2];
+    void (*setup)(size_t param);
+    void (*run)(size_t n, size_t param, size_t align); // n operations
+    void (*teardown)(void);
+} HMicroCase;
+
+///
+// The bit reader, reading from a contiguous big-endian buffer.
+///
+
+static void run_read_bits(size_t n, size_t bits, size_t align) {
+    HInputStream is = {.input = data, .length = DATA_SIZE, .bit_offset = (char)align,
+                       .endianness = BIT_BIG_ENDIAN | BYTE_BIG_ENDIAN};
+    uint64_t acc = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (is.index + 9 > is.length) {
+            is.index = 0;
+            is.bit_offset = (char)align;
+        }
+        acc += (uint64_t)h_read_bits(&is, (int)bits, false);
+    }
+    sink += acc;
+}
+
+static void run_skip_bits(size_t n, size_t bits, size_t align) {
+    HInputStream is = {.input = data, .length = DATA_SIZE, .bit_offset = (char)align,
+                       .endianness = BIT_BIG_ENDIAN | BYTE_BIG_ENDIAN};
+    for (size_t i = 0; i < n; i++) {
+        if (is.index + bits / 8 + 2 > is.length) {
+            is.index = 0;
+            is.bit_offset = (char)align;
+        }
+        h_skip_bits(&is, bits);
+    }
+    sink += is.index;
+}
+
+///
+// Hashing, as the packrat cache hashes its keys.
+///
+
+static void run_djbhash(size_t n, size_t len, size_t align) {
+    uint64_t acc = 0;
+    for (size_t i = 0; i < n; i++)
+        acc += h_djbhash(data + align, len);
+    sink += acc;
+}
+
+///
+// Hash tables keyed by pointer, as the profile and the grammar analyses use
+// them. Puts fill a fresh table of the given size; gets hit every time.
+///
+
+static void run_hashtable_put(size_t n, size_t size, size_t align) {
+    for (size_t done = 0; done < n;) {
+        HArena *a = h_new_arena(&system_allocator, 0);
+        HHashTable *ht = h_hashtable_new(a, h_eq_ptr, h_hash_ptr);
+        for (size_t i = 0; i < size && done < n; i++, done++)
+            h_hashtable_put(ht, &keys[i], &keys[i]);
+        sink += ht->used;
+        h_delete_arena(a);
+    }
+}
+
+static void setup_hashtable_get(size_t size) {
+    arena = h_new_arena(&system_allocator, 0);
+    table = h_hashtable_new(arena, h_eq_ptr, h_hash_ptr);
+    for (size_t i = 0; i < size; i++)
+        h_hashtable_put(table, &keys[i], &keys[i]);
+}
+
+static void run_hashtable_get(size_t n, size_t size, size_t align) {
+    uint64_t acc = 0;
+    for (size_t i = 0, k = 0; i < n; i++) {
+        acc += (uintptr_t)h_hashtable_get(table, &keys[k]);
+        if (++k == size)
+            k = 0;
+    }
+    sink += acc;
+}
+
+static void delete_arena(void) {
+    h_delete_arena(arena);
+    arena = NULL;
+}
+
+///
+// Arena allocation, and the structures that grow in arenas.
+///
+
+static void setup_arena(size_t param) { arena = h_new_arena(&system_allocator, 0); }
+
+static void run_arena_malloc(size_t n, size_t size, size_t align) {
+    size_t per_reset = ARENA_SPAN / size;
+    uint64_t acc = 0;
+    for (size_t i = 0, k = 0; i < n; i++) {
+        acc += (uintptr_t)h_arena_malloc(arena, size);
+        if (++k == per_reset) {
+            h_arena_reset(arena);
+            k = 0;
+        }
+    }
+    sink += acc;
+}
+
+static void run_carray_append(size_t n, size_t length, size_t align) {
+    HCountedArray *array = h_carray_new(arena);
+    for (size_t i = 0; i < n; i++) {
+        if (array->used == length) {
+            h_arena_reset(arena);
+            array = h_carray_new(arena);
+        }
+        h_carray_append(array, &keys[i % KEYS]);
+    }
+    sink += array->used;
+}
+
+static void run_slist_push(size_t n, size_t length, size_t align) {
+    HSlist *list = h_slist_new(arena);
+    for (size_t i = 0, k = 0; i < n; i++) {
+        if (k++ == length) {
+            h_arena_reset(arena);
+            list = h_slist_new(arena);
+            k = 1;
+        }
+        h_slist_push(list, &keys[i % KEYS]);
+    }
+    sink += (uintptr_t)list->head;
+}
+
+///
+// Charset membership, as h_in and h_not_in test it, on random bytes.
+///
+
+static void setup_charset(size_t members) {
+    charset = new_charset(&system_allocator);
+    for (size_t i = 0; i < members; i++)
+        charset_set(charset, (uint8_t)(i * 167), 1); // 167 is odd, so these are all different
+}
+
+static void run_charset_isset(size_t n, size_t members, size_t align) {
+    uint64_t acc = 0;
+    for (size_t i = 0; i < n; i++)
+        acc += (uint64_t)charset_isset(charset, data[i % DATA_SIZE]);
+    sink += acc;
+}
+
+static void free_charset(void) {
+    system_allocator.free(&system_allocator, charset);
+    charset = NULL;
+}
+
+///
+// Resolving a backend spec such as "packrat(0)", as h_compile_for_backend_with_params
+// callers do, allocation and freeing of the result included.
+///
+
+static void run_backend_spec(size_t n, size_t params, size_t align) {
+    uint64_t acc = 0;
+    for (size_t i = 0; i < n; i++) {
+        HParserBackendWithParams *be = h_get_backend_with_params_by_name("packrat(0)");
+        acc += (uint64_t)be->backend;
+        h_free_backend_with_params(be);
+    }
+    sink += acc;
+}
+
+static const HMicroCase cases[] = {
+    {"read_bits", "bits", "bit offset", {1, 8, 13, 32, 64}, {0, 3}, NULL, run_read_bits, NULL},
+    {"skip_bits", "bits", "bit offset", {1, 8, 64, 4096}, {0, 3}, NULL, run_skip_bits, NULL},
+    {"djbhash", "bytes", "byte offset", {4, 16, 64, 1024, 65536}, {0, 1}, NULL, run_djbhash,
+     NULL},
+    {"hashtable_put", "entries", NULL, {16, 1024, 65536}, {0}, NULL, run_hashtable_put, NULL},
+    {"hashtable_get", "entries", NULL, {16, 1024, 65536}, {0}, setup_hashtable_get,
+     run_hashtable_get, delete_arena},
+    {"arena_malloc", "bytes", NULL, {8, 64, 1024, 16384}, {0}, setup_arena, run_arena_malloc,
+     delete_arena},
+    {"carray_append", "length", NULL, {16, 1024, 65536}, {0}, setup_arena, run_carray_append,
+     delete_arena},
+    {"slist_push", "length", NULL, {16, 1024, 65536}, {0}, setup_arena, run_slist_push,
+     delete_arena},
+    {"charset_isset", "members", NULL, {1, 26, 128}, {0}, setup_charset, run_charset_isset,
+     free_charset},
+    {"backend_spec", "params", NULL, {1}, {0}, NULL, run_backend_spec, NULL},
+};
+
+static int64_t time_run(const HMicroCase *c, size_t n, size_t param, size_t align) {
+    int64_t start = h_platform_time_ns();
+    c->run(n, param, align);
+    return h_platform_time_ns() - start;
+}
+
+// The fastest of SAMPLES runs, each long enough to time, in nsec per operation.
+static double measure(const HMicroCase *c, size_t param, size_t align) {
+    size_t n = 1;
+    while (time_run(c, n, param, align) < SAMPLE_NS)
+        n *= 2;
+    double best = 0;
+    for (int s = 0; s < SAMPLES; s++) {
+        double ns = (double)time_run(c, n, param, align) / (double)n;
+        if (s == 0 || ns < best)
+            best = ns;
+    }
+    return best;
+}
+
+int main(int argc, char **argv) {
+    const char *only = NULL, *csv_path = NULL;
+    FILE *csv = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "--case") == 0)
+            only = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--csv") == 0)
+            csv_path = argv[++i];
+        else
+            h_platform_errx(1, "usage: %s [--case NAME] [--csv FILE]", argv[0]);
+    }
+    if (csv_path) {
+        csv = fopen(csv_path, "w");
+        if (!csv)
+            h_platform_errx(1, "cannot write %s", csv_path);
+        fputs("case,param,align,ns_per_op\n", csv);
+    }
+
+    uint64_t x = 88172645463325252ULL; // xorshift64, for the same data on every run
+    for (size_t i = 0; i < sizeof(data); i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        data[i] = (uint8_t)x;
+    }
+
+    printf("%-14s %-22s %-16s %10s\n", "case", "size", "alignment", "ns/op");
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        const HMicroCase *c = &cases[i];
+        if (only && strcmp(only, c->name) != 0)
+            continue;
+        for (size_t p = 0; p < sizeof(c->params) / sizeof(c->params[0]) && c->params[p]; p++) {
+            size_t naligns = c->align_name ? sizeof(c->aligns) / sizeof(c->aligns[0]) : 1;
+            if (c->setup)
+                c->setup(c->params[p]);
+            for (size_t a = 0; a < naligns; a++) {
+                char size[32], align[32] = "";
+                double ns = measure(c, c->params[p], c->aligns[a]);
+                snprintf(size, sizeof(size), "%zu %s", c->params[p], c->param_name);
+                if (c->align_name)
+                    snprintf(align, sizeof(align), "%s %zu", c->align_name, c->aligns[a]);
+                printf("%-14s %-22s %-16s %10.2f\n", c->name, size, align, ns);
+                fflush(stdout);
+                if (csv)
+                    fprintf(csv, "%s,%zu,%zu,%.3f\n", c->name, c->params[p], c->aligns[a], ns);
+            }
+            if (c->teardown)
+                c->teardown();
+        }
+    }
+    if (csv)
+        fclose(csv);
+    return 0;
+}
@@ -16,10 +16,8 @@
 // Validations
 ///
 
-bool validate_hdzero(HParseResult *p, void *user_data) {
-    if (TT_UINT != p->ast->token_type)
-        return false;
-    return (0 == p->ast->uint);
+bool validate_header(HParseResult *p, void *user_data) {
+    return (0 == H_CAST(dns_header_t, p->ast)->z);
 }
 
 /**
@@ -119,27 +117,6 @@ void set_rdata(struct dns_rr *rr, HCountedArray *rdata) {
     }
 }
 
-HParsedToken *act_header(const HParseResult *p, void *user_data) {
-    HParsedToken **fields = h_seq_elements(p->ast);
-    dns_header_t header_ = {.id = H_CAST_UINT(fields[0]),
-                            .qr = H_CAST_UINT(fields[1]),
-                            .opcode = H_CAST_UINT(fields[2]),
-                            .aa = H_CAST_UINT(fields[3]),
-                            .tc = H_CAST_UINT(fields[4]),
-                            .rd = H_CAST_UINT(fields[5]),
-                            .ra = H_CAST_UINT(fields[6]),
-                            .rcode = H_CAST_UINT(fields[7]),
-                            .question_count = H_CAST_UINT(fields[8]),
-                            .answer_count = H_CAST_UINT(fields[9]),
-                            .authority_count = H_CAST_UINT(fields[10]),
-                            .additional_count = H_CAST_UINT(fields[11])};
-
-    dns_header_t *header = H_ALLOC(dns_header_t);
-    *header = header_;
-
-    return H_MAKE(dns_header_t, header);
-}
-
 HParsedToken *act_label(const HParseResult *p, void *user_data) {
     dns_label_t *r = H_ALLOC(dns_label_t);
 
@@ -230,7 +207,6 @@ HParsedToken *act_message(const HParseResult *p, void *user_data) {
     return H_MAKE(dns_message_t, msg);
 }
 
-#define act_hdzero h_act_ignore
 #define act_qname act_index0
 
 ///
@@ -243,21 +219,24 @@ const HParser *init_parser() {
         return ret;
 
     H_RULE(domain, init_domain());
-    H_AVRULE(hdzero, h_bits(3, false));
-    H_ARULE(header, h_sequence(h_bits(16, false), // ID
-                               h_bits(1, false),  // QR
-                               h_bits(4, false),  // opcode
-                               h_bits(1, false),  // AA
-                               h_bits(1, false),  // TC
-                               h_bits(1, false),  // RD
-                               h_bits(1, false),  // RA
-                               hdzero,            // Z
-                               h_bits(4, false),  // RCODE
-                               h_uint16(),        // QDCOUNT
-                               h_uint16(),        // ANCOUNT
-                               h_uint16(),        // NSCOUNT
-                               h_uint16(),        // ARCOUNT
-                               NULL));
+    // decoded straight into a dns_header_t
+    static const HStructField header_fields[] = {
+        H_STRUCT_FIELD(dns_header_t, id, 0, 16),
+        H_STRUCT_FIELD(dns_header_t, qr, 16, 1),
+        H_STRUCT_FIELD(dns_header_t, opcode, 17, 4),
+        H_STRUCT_FIELD(dns_header_t, aa, 21, 1),
+        H_STRUCT_FIELD(dns_header_t, tc, 22, 1),
+        H_STRUCT_FIELD(dns_header_t, rd, 23, 1),
+        H_STRUCT_FIELD(dns_header_t, ra, 24, 1),
+        H_STRUCT_FIELD(dns_header_t, z, 25, 3),
+        H_STRUCT_FIELD(dns_header_t, rcode, 28, 4),
+        H_STRUCT_FIELD(dns_header_t, question_count, 32, 16),
+        H_STRUCT_FIELD(dns_header_t, answer_count, 48, 16),
+        H_STRUCT_FIELD(dns_header_t, authority_count, 64, 16),
+        H_STRUCT_FIELD(dns_header_t, additional_count, 80, 16),
+    };
+    H_VRULE(header, h_struct((HTokenType)TT_dns_header_t, sizeof(dns_header_t), 96, header_fields,
+                             sizeof(header_fields) / sizeof(header_fields[0])));
     H_RULE(type, h_int_range(h_uint16(), 1, 16));
     H_RULE(qtype, h_choice(type, h_int_range(h_uint16(), 252, 255), NULL));
     H_RULE(class, h_int_range(h_uint16(), 1, 4));
@@ -24,7 +24,7 @@ typedef uint8_t *dns_cstr_t;
 typedef struct dns_header {
     uint16_t id;
     bool qr, aa, tc, rd, ra;
-    char opcode, rcode;
+    char opcode, z, rcode;
     size_t question_count;
     size_t answer_count;
     size_t authority_count;
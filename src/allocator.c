@@ -42,15 +42,10 @@ struct HArena_ {
     size_t block_size;
     size_t used;
     size_t wasted;
-#ifdef DETAILED_ARENA_STATS
-    size_t mm_malloc_count, mm_malloc_bytes;
-    size_t memset_count, memset_bytes;
-    size_t arena_malloc_count, arena_malloc_bytes;
-    size_t arena_su_malloc_count, arena_su_malloc_bytes;
-    size_t arena_si_malloc_count, arena_si_malloc_bytes;
-    size_t arena_lu_malloc_count, arena_lu_malloc_bytes;
-    size_t arena_li_malloc_count, arena_li_malloc_bytes;
-#endif
+    struct arena_link *spare; /* empty standard blocks kept by h_arena_reset */
+    struct HArena_ *children; /* arenas adopted with h_arena_adopt */
+    struct HArena_ *sibling;
+    HArenaDetailedStats counts; /* all but used and wasted, which are kept above */
 
     jmp_buf *except;
 };
@@ -75,6 +70,77 @@ void *h_realloc(HAllocator *mm__, void *ptr, size_t size) {
     return p;
 }
 
+// An allocation of an HAllocTracker starts with its size, padded so that the
+// rest keeps the alignment the inner allocator gave it.
+typedef union {
+    size_t size;
+    long double ld;
+    void *p;
+    long long ll;
+} tracker_header;
+
+static void track(HAllocTracker *t, size_t size) {
+    size_t c = 0;
+    while (c < H_ALLOC_SIZE_CLASSES - 1 && size > ((size_t)16 << c))
+        c++;
+    t->size_classes[c]++;
+    t->allocs++;
+    t->bytes += size;
+    t->live += size;
+    if (t->live > t->peak)
+        t->peak = t->live;
+}
+
+static void *tracker_alloc(HAllocator *allocator, size_t size) {
+    HAllocTracker *t = (HAllocTracker *)allocator;
+    tracker_header *h = t->inner->alloc(t->inner, sizeof(tracker_header) + size);
+    if (!h)
+        return NULL;
+    h->size = size;
+    track(t, size);
+    return h + 1;
+}
+
+static void *tracker_realloc(HAllocator *allocator, void *ptr, size_t size) {
+    HAllocTracker *t = (HAllocTracker *)allocator;
+    if (!ptr)
+        return tracker_alloc(allocator, size);
+    tracker_header *h = (tracker_header *)ptr - 1;
+    size_t old = h->size;
+    h = t->inner->realloc(t->inner, h, sizeof(tracker_header) + size);
+    if (!h)
+        return NULL;
+    h->size = size;
+    t->live -= old;
+    track(t, size);
+    return h + 1;
+}
+
+static void tracker_free(HAllocator *allocator, void *ptr) {
+    HAllocTracker *t = (HAllocTracker *)allocator;
+    if (!ptr)
+        return;
+    tracker_header *h = (tracker_header *)ptr - 1;
+    t->live -= h->size;
+    t->frees++;
+    t->inner->free(t->inner, h);
+}
+
+void h_alloc_tracker_init(HAllocTracker *tracker, HAllocator *inner) {
+    memset(tracker, 0, sizeof(*tracker));
+    tracker->allocator.alloc = tracker_alloc;
+    tracker->allocator.realloc = tracker_realloc;
+    tracker->allocator.free = tracker_free;
+    tracker->inner = inner;
+}
+
+void h_alloc_tracker_reset(HAllocTracker *tracker) {
+    size_t live = tracker->live;
+    tracker->allocs = tracker->frees = tracker->bytes = 0;
+    memset(tracker->size_classes, 0, sizeof(tracker->size_classes));
+    tracker->peak = live;
+}
+
 HArena *h_new_arena(HAllocator *mm__, size_t block_size) {
     if (block_size == 0)
         block_size = 4096;
@@ -90,26 +156,30 @@ HArena *h_new_arena(HAllocator *mm__, size_t block_size) {
     ret->block_size = block_size;
     ret->used = 0;
     ret->mm__ = mm__;
-#ifdef DETAILED_ARENA_STATS
-    ret->mm_malloc_count = 2;
-    ret->mm_malloc_bytes = sizeof(*ret) + sizeof(struct arena_link) + block_size;
-    ret->memset_count = 0;
-    ret->memset_bytes = 0;
-    ret->arena_malloc_count = ret->arena_malloc_bytes = 0;
-    ret->arena_su_malloc_count = ret->arena_su_malloc_bytes = 0;
-    ret->arena_si_malloc_count = ret->arena_si_malloc_bytes = 0;
-    ret->arena_lu_malloc_count = ret->arena_lu_malloc_bytes = 0;
-    ret->arena_li_malloc_count = ret->arena_li_malloc_bytes = 0;
-#endif
+    memset(&ret->counts, 0, sizeof(ret->counts));
+    ret->counts.blocks = 1;
+    ret->counts.mm_malloc_count = 2;
+    ret->counts.mm_malloc_bytes = sizeof(*ret) + sizeof(struct arena_link) + block_size;
     /* XXX provide a mechanism to indicate mm__ returns zeroed blocks */
     ret->malloc_zeros = false;
     ret->wasted = sizeof(struct arena_link) + sizeof(struct HArena_) + block_size;
+    ret->spare = NULL;
+    ret->children = NULL;
+    ret->sibling = NULL;
     ret->except = NULL;
     return ret;
 }
 
 void h_arena_set_except(HArena *arena, jmp_buf *except) { arena->except = except; }
 
+HAllocator *h_arena_allocator(HArena *arena) { return arena->mm__; }
+
+void h_arena_abort(HArena *arena) {
+    if (!arena->except)
+        h_platform_errx(1, "arena aborted without an except handler");
+    longjmp(*arena->except, 1);
+}
+
 static void *alloc_block(HArena *arena, size_t size) {
     void *block = arena->mm__->alloc(arena->mm__, size);
     if (!block) {
@@ -117,6 +187,8 @@ static void *alloc_block(HArena *arena, size_t size) {
             longjmp(*arena->except, 1);
         h_platform_errx(1, "memory allocation failed (%uB requested)\n", (unsigned int)size);
     }
+    arena->counts.mm_malloc_count++;
+    arena->counts.mm_malloc_bytes += size;
     return block;
 }
 
@@ -137,18 +209,13 @@ static void *h_arena_malloc_raw(HArena *arena, size_t size, bool need_zero) {
         arena->wasted -= size;
         arena->head->used += size;
         arena->head->free -= size;
-
-#ifdef DETAILED_ARENA_STATS
-        ++(arena->arena_malloc_count);
-        arena->arena_malloc_bytes += size;
         if (need_zero) {
-            ++(arena->arena_si_malloc_count);
-            arena->arena_si_malloc_bytes += size;
+            arena->counts.arena_si_malloc_count++;
+            arena->counts.arena_si_malloc_bytes += size;
         } else {
-            ++(arena->arena_su_malloc_count);
-            arena->arena_su_malloc_bytes += size;
+            arena->counts.arena_su_malloc_count++;
+            arena->counts.arena_su_malloc_bytes += size;
         }
-#endif
     } else if (size > arena->block_size) {
         /*
          * We need a new, dedicated block for it, because it won't fit in a
@@ -178,26 +245,37 @@ static void *h_arena_malloc_raw(HArena *arena, size_t size, bool need_zero) {
         link->next = arena->head->next;
         arena->head->next = link;
         ret = link->rest;
-
-#ifdef DETAILED_ARENA_STATS
-        ++(arena->arena_malloc_count);
-        arena->arena_malloc_bytes += size;
+        arena->counts.blocks++;
         if (need_zero) {
-            ++(arena->arena_li_malloc_count);
-            arena->arena_li_malloc_bytes += size;
+            arena->counts.arena_li_malloc_count++;
+            arena->counts.arena_li_malloc_bytes += size;
         } else {
-            ++(arena->arena_lu_malloc_count);
-            arena->arena_lu_malloc_bytes += size;
+            arena->counts.arena_lu_malloc_count++;
+            arena->counts.arena_lu_malloc_bytes += size;
         }
-#endif
+    } else if (arena->spare) {
+        /* reuse a block kept by h_arena_reset. */
+        link = arena->spare;
+        arena->spare = link->next;
+        link->free = arena->block_size - size;
+        link->used = size;
+        link->next = arena->head;
+        arena->head = link;
+        arena->used += size;
+        arena->wasted += sizeof(struct arena_link) + arena->block_size - size;
+        arena->counts.blocks++;
+        if (need_zero) {
+            arena->counts.arena_si_malloc_count++;
+            arena->counts.arena_si_malloc_bytes += size;
+        } else {
+            arena->counts.arena_su_malloc_count++;
+            arena->counts.arena_su_malloc_bytes += size;
+        }
+        ret = link->rest;
     } else {
         /* we just need to allocate an ordinary new block. */
         link = alloc_block(arena, sizeof(struct arena_link) + arena->block_size);
         assert(link != NULL);
-#ifdef DETAILED_ARENA_STATS
-        ++(arena->mm_malloc_count);
-        arena->mm_malloc_bytes += sizeof(struct arena_link) + arena->block_size;
-#endif
         link->free = arena->block_size - size;
         link->used = size;
         link->next = arena->head;
@@ -205,18 +283,14 @@ static void *h_arena_malloc_raw(HArena *arena, size_t size, bool need_zero) {
         arena->used += size;
         arena->wasted += sizeof(struct arena_link) + arena->block_size - size;
         ret = link->rest;
-
-#ifdef DETAILED_ARENA_STATS
-        ++(arena->arena_malloc_count);
-        arena->arena_malloc_bytes += size;
+        arena->counts.blocks++;
         if (need_zero) {
-            ++(arena->arena_si_malloc_count);
-            arena->arena_si_malloc_bytes += size;
+            arena->counts.arena_si_malloc_count++;
+            arena->counts.arena_si_malloc_bytes += size;
         } else {
-            ++(arena->arena_su_malloc_count);
-            arena->arena_su_malloc_bytes += size;
+            arena->counts.arena_su_malloc_count++;
+            arena->counts.arena_su_malloc_bytes += size;
         }
-#endif
     }
 
     /*
@@ -224,10 +298,8 @@ static void *h_arena_malloc_raw(HArena *arena, size_t size, bool need_zero) {
      */
     if (need_zero && !(arena->malloc_zeros)) {
         memset(ret, 0, size);
-#ifdef DETAILED_ARENA_STATS
-        ++(arena->memset_count);
-        arena->memset_bytes += size;
-#endif
+        arena->counts.memset_count++;
+        arena->counts.memset_bytes += size;
     }
 
     return ret;
@@ -237,9 +309,7 @@ void h_arena_free(HArena *arena, void *ptr) {
     // To be used later...
 }
 
-void h_delete_arena(HArena *arena) {
-    HAllocator *mm__ = arena->mm__;
-    struct arena_link *link = arena->head;
+static void free_links(HAllocator *mm__, struct arena_link *link) {
     while (link) {
         struct arena_link *next = link->next;
         // Even in the case of a special block, without the full arena
@@ -248,28 +318,121 @@ void h_delete_arena(HArena *arena) {
         h_free(link);
         link = next;
     }
+}
+
+void h_delete_arena(HArena *arena) {
+    HAllocator *mm__ = arena->mm__;
+    HArena *child = arena->children;
+    while (child) {
+        HArena *next = child->sibling;
+        h_delete_arena(child);
+        child = next;
+    }
+    free_links(mm__, arena->head);
+    free_links(mm__, arena->spare);
     h_free(arena);
 }
 
+void h_arena_reset(HArena *arena) {
+    HAllocator *mm__ = arena->mm__;
+    struct arena_link *link = arena->head;
+    struct arena_link *keep = NULL;
+
+    assert(arena->children == NULL);
+
+    /* keep the standard-sized blocks around for reuse, free the large ones */
+    while (link) {
+        struct arena_link *next = link->next;
+        if (link->used + link->free == arena->block_size) {
+            link->used = 0;
+            link->free = arena->block_size;
+            if (!keep) {
+                keep = link;
+                keep->next = NULL;
+            } else {
+                link->next = arena->spare;
+                arena->spare = link;
+            }
+        } else {
+            h_free(link);
+        }
+        link = next;
+    }
+    if (!keep) {
+        keep = alloc_block(arena, sizeof(struct arena_link) + arena->block_size);
+        keep->used = 0;
+        keep->free = arena->block_size;
+        keep->next = NULL;
+    }
+    arena->head = keep;
+    arena->counts.blocks = 1;
+    arena->used = 0;
+    arena->wasted = sizeof(struct arena_link) + sizeof(struct HArena_) + arena->block_size;
+}
+
+void h_arena_adopt(HArena *arena, HArena *child) {
+    assert(child->sibling == NULL);
+    child->sibling = arena->children;
+    arena->children = child;
+}
+
+static void add_counts(HArenaDetailedStats *to, const HArenaDetailedStats *from) {
+    to->blocks += from->blocks;
+    to->mm_malloc_count += from->mm_malloc_count;
+    to->mm_malloc_bytes += from->mm_malloc_bytes;
+    to->memset_count += from->memset_count;
+    to->memset_bytes += from->memset_bytes;
+    to->arena_su_malloc_count += from->arena_su_malloc_count;
+    to->arena_su_malloc_bytes += from->arena_su_malloc_bytes;
+    to->arena_si_malloc_count += from->arena_si_malloc_count;
+    to->arena_si_malloc_bytes += from->arena_si_malloc_bytes;
+    to->arena_lu_malloc_count += from->arena_lu_malloc_count;
+    to->arena_lu_malloc_bytes += from->arena_lu_malloc_bytes;
+    to->arena_li_malloc_count += from->arena_li_malloc_count;
+    to->arena_li_malloc_bytes += from->arena_li_malloc_bytes;
+}
+
 void h_allocator_stats(HArena *arena, HArenaStats *stats) {
-    stats->used = arena->used;
-    stats->wasted = arena->wasted;
 #ifdef DETAILED_ARENA_STATS
-    stats->mm_malloc_count = arena->mm_malloc_count;
-    stats->mm_malloc_bytes = arena->mm_malloc_bytes;
-    stats->memset_count = arena->memset_count;
-    stats->memset_bytes = arena->memset_bytes;
-    stats->arena_malloc_count = arena->arena_malloc_count;
-    stats->arena_malloc_bytes = arena->arena_malloc_bytes;
-    stats->arena_su_malloc_count = arena->arena_su_malloc_count;
-    stats->arena_su_malloc_bytes = arena->arena_su_malloc_bytes;
-    stats->arena_si_malloc_count = arena->arena_si_malloc_count;
-    stats->arena_si_malloc_bytes = arena->arena_si_malloc_bytes;
-    stats->arena_lu_malloc_count = arena->arena_lu_malloc_count;
-    stats->arena_lu_malloc_bytes = arena->arena_lu_malloc_bytes;
-    stats->arena_li_malloc_count = arena->arena_li_malloc_count;
-    stats->arena_li_malloc_bytes = arena->arena_li_malloc_bytes;
+    HArenaDetailedStats all;
+    h_allocator_detailed_stats(arena, &all);
+    stats->mm_malloc_count = all.mm_malloc_count;
+    stats->mm_malloc_bytes = all.mm_malloc_bytes;
+    stats->memset_count = all.memset_count;
+    stats->memset_bytes = all.memset_bytes;
+    stats->arena_malloc_count = all.arena_malloc_count;
+    stats->arena_malloc_bytes = all.arena_malloc_bytes;
+    stats->arena_su_malloc_count = all.arena_su_malloc_count;
+    stats->arena_su_malloc_bytes = all.arena_su_malloc_bytes;
+    stats->arena_si_malloc_count = all.arena_si_malloc_count;
+    stats->arena_si_malloc_bytes = all.arena_si_malloc_bytes;
+    stats->arena_lu_malloc_count = all.arena_lu_malloc_count;
+    stats->arena_lu_malloc_bytes = all.arena_lu_malloc_bytes;
+    stats->arena_li_malloc_count = all.arena_li_malloc_count;
+    stats->arena_li_malloc_bytes = all.arena_li_malloc_bytes;
 #endif
+    stats->used = arena->used;
+    stats->wasted = arena->wasted;
+    for (HArena *child = arena->children; child; child = child->sibling) {
+        stats->used += child->used;
+        stats->wasted += child->wasted;
+    }
+}
+
+void h_allocator_detailed_stats(HArena *arena, HArenaDetailedStats *stats) {
+    *stats = arena->counts;
+    stats->used = arena->used;
+    stats->wasted = arena->wasted;
+    for (HArena *child = arena->children; child; child = child->sibling) {
+        add_counts(stats, &child->counts);
+        stats->used += child->used;
+        stats->wasted += child->wasted;
+    }
+    // the totals are the sums of the classes
+    stats->arena_malloc_count = stats->arena_su_malloc_count + stats->arena_si_malloc_count +
+                                stats->arena_lu_malloc_count + stats->arena_li_malloc_count;
+    stats->arena_malloc_bytes = stats->arena_su_malloc_bytes + stats->arena_si_malloc_bytes +
+                                stats->arena_lu_malloc_bytes + stats->arena_li_malloc_bytes;
 }
 
 void *h_arena_realloc(HArena *arena, void *ptr, size_t n) {
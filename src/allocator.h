@@ -38,8 +38,6 @@ extern "C" {
 #define ATTR_MALLOC(n)
 #endif
 
-/* #define DETAILED_ARENA_STATS */
-
 // TODO(thequux): Turn this into an "HAllocatorVtable", and add a wrapper that also takes an
 // environment pointer.
 typedef struct HAllocator_ {
@@ -51,6 +49,28 @@ typedef struct HAllocator_ {
 void *h_alloc(HAllocator *allocator, size_t size) ATTR_MALLOC(2);
 void *h_realloc(HAllocator *allocator, void *ptr, size_t size);
 
+// Size classes of an HAllocTracker: class 0 counts requests of up to 16 bytes,
+// class i those of up to 16 << i, and the last class all the bigger ones.
+#define H_ALLOC_SIZE_CLASSES 16
+
+// An HAllocator that passes every call on to another one and keeps count, for
+// profiling. Pass &tracker.allocator to the __m functions; it sees the blocks
+// of their arenas too. Each allocation carries a small header with its size.
+typedef struct {
+    HAllocator allocator;
+    HAllocator *inner;
+    size_t allocs; /* calls to alloc and realloc */
+    size_t frees;
+    size_t bytes; /* asked for by alloc and realloc, in total */
+    size_t live;  /* held now */
+    size_t peak;  /* the most held at once */
+    size_t size_classes[H_ALLOC_SIZE_CLASSES];
+} HAllocTracker;
+
+void h_alloc_tracker_init(HAllocTracker *tracker, HAllocator *inner);
+// Zero the counts, and start the peak over from what is held now.
+void h_alloc_tracker_reset(HAllocTracker *tracker);
+
 typedef struct HArena_ HArena; // hidden implementation
 
 HArena *h_new_arena(HAllocator *allocator, size_t block_size); // pass 0 for default...
@@ -62,6 +82,17 @@ void h_arena_free(HArena *arena,
                   void *ptr); // For future expansion, with alternate memory managers.
 void h_delete_arena(HArena *arena);
 void h_arena_set_except(HArena *arena, jmp_buf *except);
+// The allocator the arena takes its blocks from.
+HAllocator *h_arena_allocator(HArena *arena);
+// Give up on whatever the arena is being used for, by jumping to its except
+// handler as if it had run out of memory. It must have one.
+void h_arena_abort(HArena *arena);
+// Release everything allocated from the arena at once, keeping its standard
+// blocks around to be reused by later allocations.
+void h_arena_reset(HArena *arena);
+// Make child part of arena: it is deleted along with arena and counted in its
+// stats. The child stays usable for allocation.
+void h_arena_adopt(HArena *arena, HArena *child);
 
 typedef struct {
     size_t used;
@@ -90,6 +121,36 @@ typedef struct {
 
 void h_allocator_stats(HArena *arena, HArenaStats *stats);
 
+// Everything an arena counts, whatever DETAILED_ARENA_STATS says; a struct of
+// its own so that HArenaStats keeps its layout.
+typedef struct {
+    size_t used;
+    size_t wasted;
+    size_t blocks; /* holding allocations, not counting those kept for reuse by h_arena_reset */
+    size_t mm_malloc_count;
+    size_t mm_malloc_bytes;
+    size_t memset_count;
+    size_t memset_bytes;
+    size_t arena_malloc_count;
+    size_t arena_malloc_bytes;
+    /* small, uninited */
+    size_t arena_su_malloc_count;
+    size_t arena_su_malloc_bytes;
+    /* small, inited */
+    size_t arena_si_malloc_count;
+    size_t arena_si_malloc_bytes;
+    /* large, uninited */
+    size_t arena_lu_malloc_count;
+    size_t arena_lu_malloc_bytes;
+    /* large, inited */
+    size_t arena_li_malloc_count;
+    size_t arena_li_malloc_bytes;
+} HArenaDetailedStats;
+
+// used, wasted and blocks describe the arena as it is now; the other counters
+// cover its whole life, across h_arena_reset. Adopted children are included.
+void h_allocator_detailed_stats(HArena *arena, HArenaDetailedStats *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,23 +1,15 @@
+#include "../cfgrammar.h"
 #include "../internal.h"
 #include "../parsers/parser_internal.h"
 
 #include <assert.h>
 #include <string.h>
 
-/* #define DETAILED_PACKRAT_STATISTICS */
-
-#ifdef DETAILED_PACKRAT_STATISTICS
-static size_t packrat_hash_count = 0;
-static size_t packrat_hash_bytes = 0;
-static size_t packrat_cmp_count = 0;
-static size_t packrat_cmp_bytes = 0;
-#endif
-
 static uint32_t cache_key_hash(const void *key);
 
 // short-hand for creating lowlevel parse cache values (parse result case)
 static HParserCacheValue *cached_result(HParseState *state, HParseResult *result) {
-    HParserCacheValue *ret = a_new(HParserCacheValue, 1);
+    HParserCacheValue *ret = a_new_(state->memo_arena, HParserCacheValue, 1);
     ret->value_type = PC_RIGHT;
     ret->right = result;
     ret->input_stream = state->input_stream;
@@ -26,7 +18,7 @@ static HParserCacheValue *cached_result(HParseState *state, HParseResult *result
 
 // short-hand for creating lowlevel parse cache values (left recursion case)
 static HParserCacheValue *cached_lr(HParseState *state, HLeftRec *lr) {
-    HParserCacheValue *ret = a_new(HParserCacheValue, 1);
+    HParserCacheValue *ret = a_new_(state->memo_arena, HParserCacheValue, 1);
     ret->value_type = PC_LEFT;
     ret->left = lr;
     ret->input_stream = state->input_stream;
@@ -110,9 +102,9 @@ HParserCacheValue *recall(HParserCacheKey *k, HParseState *state, HHashValue key
 
 void setupLR(const HParser *p, HParseState *state, HLeftRec *rec_detect) {
     if (!rec_detect->head) {
-        HRecursionHead *some = a_new(HRecursionHead, 1);
+        HRecursionHead *some = a_new_(state->memo_arena, HRecursionHead, 1);
         some->head_parser = p;
-        some->involved_set = h_slist_new(state->arena);
+        some->involved_set = h_slist_new(state->memo_arena);
         some->eval_set = NULL;
         rec_detect->head = some;
     }
@@ -131,8 +123,10 @@ void setupLR(const HParser *p, HParseState *state, HLeftRec *rec_detect) {
 
 // helper: true iff pos1 is less than pos2
 static inline bool pos_lt(HInputStream pos1, HInputStream pos2) {
-    return ((pos1.index < pos2.index) ||
-            (pos1.index == pos2.index && pos1.bit_offset < pos2.bit_offset));
+    // compare absolute byte positions; these differ from index for segmented input
+    size_t i1 = pos1.pos + pos1.index;
+    size_t i2 = pos2.pos + pos2.index;
+    return ((i1 < i2) || (i1 == i2 && pos1.bit_offset < pos2.bit_offset));
 }
 
 /* If recall() returns NULL, we need to store a dummy failure in the cache and compute the
@@ -147,6 +141,9 @@ HParseResult *grow(HParserCacheKey *k, HParseState *state, HRecursionHead *head)
         h_platform_errx(1, "impossible match");
     HParseResult *old_res = old_cached->right;
 
+    if (state->options && state->options->complexity)
+        h_complexity_grow(state->options->complexity, k->parser);
+
     // rewind the input
     state->input_stream = k->input_pos;
 
@@ -195,8 +192,13 @@ HParseResult *lr_answer(HParserCacheKey *k, HParseState *state, HLeftRec *growab
 }
 
 /* Warth's recursion. Hi Alessandro! */
-HParseResult *h_do_parse(const HParser *parser, HParseState *state) {
-    HParserCacheKey *key = a_new(HParserCacheKey, 1);
+static HParseResult *do_parse(const HParser *parser, HParseState *state) {
+    // primitives cannot recurse, and h_compile finds higher-order parsers
+    // that are never run twice at the same position; neither needs the cache
+    if (!parser->vtable->higher || h_parser_private(parser)->memo == H_MEMO_OFF)
+        return perform_lowlevel_parse(state, parser);
+
+    HParserCacheKey *key = a_new_(state->memo_arena, HParserCacheKey, 1);
     HHashValue keyhash;
     HLeftRec *base = NULL;
     HParserCacheValue *m = NULL, *cached = NULL;
@@ -205,45 +207,43 @@ HParseResult *h_do_parse(const HParser *parser, HParseState *state) {
     key->parser = parser;
     keyhash = cache_key_hash(key);
 
-    if (parser->vtable->higher) {
-        m = recall(key, state, keyhash);
+    m = recall(key, state, keyhash);
+    if (state->options) {
+        if (state->options->profile)
+            h_profile_memo(state->options->profile, m != NULL);
+        if (state->options->complexity)
+            h_complexity_memo(state->options->complexity, m != NULL);
+        if (state->options->stats) {
+            state->options->stats->memo_lookups++;
+            state->options->stats->memo_hits += m != NULL;
+        }
     }
 
     /* check to see if there is already a result for this object... */
     if (!m) {
-        /*
-         * But only cache it now if there's some chance it could grow; primitive
-         * parsers can't
-         */
-        if (parser->vtable->higher) {
-            base = a_new(HLeftRec, 1);
-            base->seed = NULL;
-            base->rule = parser;
-            base->head = NULL;
-            h_slist_push(state->lr_stack, base);
-            /* cache it */
-            h_hashtable_put_precomp(state->cache, key, cached_lr(state, base), keyhash);
-        }
+        base = a_new_(state->memo_arena, HLeftRec, 1);
+        base->seed = NULL;
+        base->rule = parser;
+        base->head = NULL;
+        h_slist_push(state->lr_stack, base);
+        /* cache it */
+        h_hashtable_put_precomp(state->cache, key, cached_lr(state, base), keyhash);
 
         /* parse the input */
         HParseResult *tmp_res = perform_lowlevel_parse(state, parser);
-        if (parser->vtable->higher) {
-            /* the base variable has passed equality tests with the cache */
-            h_slist_pop(state->lr_stack);
-            /* update the cached value to our new position */
-            cached = h_hashtable_get_precomp(state->cache, key, keyhash);
-            assert(cached != NULL);
-            cached->input_stream = state->input_stream;
-        }
+        /* the base variable has passed equality tests with the cache */
+        h_slist_pop(state->lr_stack);
+        /* update the cached value to our new position */
+        cached = h_hashtable_get_precomp(state->cache, key, keyhash);
+        assert(cached != NULL);
+        cached->input_stream = state->input_stream;
 
         /*
          * setupLR, used below, mutates the LR to have a head if appropriate,
          * so we check to see if we have one
          */
-        if (!base || NULL == base->head) {
-            if (parser->vtable->higher) {
-                h_hashtable_put_precomp(state->cache, key, cached_result(state, tmp_res), keyhash);
-            }
+        if (NULL == base->head) {
+            h_hashtable_put_precomp(state->cache, key, cached_result(state, tmp_res), keyhash);
             return tmp_res;
         } else {
             base->seed = tmp_res;
@@ -254,6 +254,8 @@ HParseResult *h_do_parse(const HParser *parser, HParseState *state) {
         /* it exists! */
         state->input_stream = m->input_stream;
         if (PC_LEFT == m->value_type) {
+            if (state->options && state->options->complexity)
+                h_complexity_left_recursion(state->options->complexity, parser);
             setupLR(parser, state, m->left);
             return m->left->seed;
         } else {
@@ -262,11 +264,217 @@ HParseResult *h_do_parse(const HParser *parser, HParseState *state) {
     }
 }
 
+// Abandon the parse once it is over budget, through the handler the arena
+// has for running out of memory.
+static void check_budget(HParseBudget *budget, HParseState *state) {
+    HBudgetReason over = H_BUDGET_OK;
+
+    budget->steps++;
+    if (budget->max_steps && budget->steps > budget->max_steps) {
+        over = H_BUDGET_STEPS;
+    } else if (budget->max_memo_entries && state->cache->used > budget->max_memo_entries) {
+        over = H_BUDGET_MEMO_ENTRIES;
+    } else if (budget->steps % H_BUDGET_INTERVAL == 0) {
+        HArenaStats stats;
+        if (budget->max_arena_bytes) {
+            h_allocator_stats(state->arena, &stats);
+            if (stats.used > budget->max_arena_bytes)
+                over = H_BUDGET_ARENA_BYTES;
+        }
+        if (!over && state->deadline && h_platform_time_ns() > state->deadline)
+            over = H_BUDGET_DEADLINE;
+    }
+    if (over) {
+        budget->exceeded = over;
+        h_arena_abort(state->arena);
+    }
+}
+
+HParseResult *h_do_parse(const HParser *parser, HParseState *state) {
+    const HParseOptions *opts = state->options;
+    if (!opts)
+        return do_parse(parser, state);
+    if (opts->budget)
+        check_budget(opts->budget, state);
+
+    HProfileFrame frame;
+    HComplexityFrame cframe;
+    if (opts->profile)
+        h_profile_enter(opts->profile, parser, state, &frame);
+    if (opts->complexity)
+        h_complexity_enter(opts->complexity, parser, state, &cframe);
+    if (opts->trace)
+        h_trace_record(opts->trace, H_TRACE_ENTER, parser, &state->input_stream);
+    HParseResult *res = do_parse(parser, state);
+    if (opts->trace)
+        h_trace_record(opts->trace, res ? H_TRACE_EXIT : H_TRACE_FAIL, parser,
+                       &state->input_stream);
+    if (opts->complexity)
+        h_complexity_exit(opts->complexity, state, &cframe, res != NULL);
+    if (opts->profile)
+        h_profile_exit(opts->profile, state, &frame, res != NULL);
+    return res;
+}
+
+typedef struct {
+    HAllocator *mm__;
+    const HParser *root;
+    HCFGrammar *grammar; // NULL until a choice needs it, or if root is not context-free
+    bool built;
+} HPackratCompile;
+
+static void compile_node(const HParser *p, void *ctx) {
+    HPackratCompile *c = ctx;
+    // only the dispatch tables of choices use the grammar, so a grammar
+    // without choices never goes through the CFG layer
+    if (p->vtable == &choice_vt && !c->built) {
+        c->grammar = h_cfgrammar(c->mm__, c->root);
+        c->built = true;
+    }
+    h_choice_compile(c->mm__, p, c->grammar);
+    h_sequence_compile(c->mm__, p);
+}
+
+// Memoization only pays off where a parser can run twice at the same input
+// position. In a part of the grammar that is a tree, a failed alternative
+// is never retried through another path, so its parsers are run at most once
+// per position, like a recursive descent parser's. The cache stays on for
+// parsers with more than one parent or on a cycle, where left recursion
+// needs it; for the children of those on a cycle, which grow() runs again,
+// and of permutations, which try their children in every order; and for
+// those that reach the symbol table or h_bind, whose effects would repeat.
+
+typedef struct {
+    size_t index, low; // Tarjan's
+    size_t parents;
+    const HParser *parent; // the first
+    bool on_stack;
+    bool cyclic;
+    bool effects;
+} HMemoNode;
+
+typedef struct {
+    HArena *arena;
+    HHashTable *nodes; // parser -> HMemoNode
+    HCountedArray *all;
+    HCountedArray *stack;
+    size_t next;
+    const HParser *cur; // whose children are being visited
+} HMemoAnalysis;
+
+static bool has_effects(const HParser *p) {
+    return p->vtable == &put_value_vt || p->vtable == &get_value_vt ||
+           p->vtable == &free_value_vt || p->vtable == &bind_vt;
+}
+
+static void memo_visit(HMemoAnalysis *a, const HParser *p);
+
+static void memo_edge(const HParser *child, void *ctx) {
+    HMemoAnalysis *a = ctx;
+    const HParser *parent = a->cur;
+    HMemoNode *c = h_hashtable_get(a->nodes, child);
+    if (!c) {
+        memo_visit(a, child);
+        a->cur = parent;
+        c = h_hashtable_get(a->nodes, child);
+        HMemoNode *n = h_hashtable_get(a->nodes, parent);
+        if (c->low < n->low)
+            n->low = c->low;
+    } else if (c->on_stack) {
+        HMemoNode *n = h_hashtable_get(a->nodes, parent);
+        if (c->index < n->low)
+            n->low = c->index;
+    }
+    if (c->parents++ == 0)
+        c->parent = parent;
+    if (child == parent)
+        c->cyclic = true;
+}
+
+typedef struct {
+    HMemoAnalysis *a;
+    bool effects;
+} HEffectsCtx;
+
+static void child_effects(const HParser *child, void *ctx) {
+    HEffectsCtx *e = ctx;
+    e->effects |= ((HMemoNode *)h_hashtable_get(e->a->nodes, child))->effects;
+}
+
+static void memo_visit(HMemoAnalysis *a, const HParser *p) {
+    HMemoNode *n = h_arena_malloc(a->arena, sizeof(HMemoNode));
+    n->index = n->low = a->next++;
+    n->parents = 0;
+    n->parent = NULL;
+    n->on_stack = true;
+    n->cyclic = false;
+    n->effects = false;
+    h_hashtable_put(a->nodes, p, n);
+    h_carray_append(a->all, (HParsedToken *)p);
+    h_carray_append(a->stack, (HParsedToken *)p);
+
+    a->cur = p;
+    if (p->vtable->walk)
+        p->vtable->walk(p->env, memo_edge, a);
+    if (n->low != n->index)
+        return;
+
+    // p roots a strongly connected component, which is on top of the stack;
+    // everything it reaches outside of it is done
+    size_t top = a->stack->used;
+    while ((const HParser *)a->stack->elements[--a->stack->used] != p)
+        ;
+    HEffectsCtx e = {a, false};
+    for (size_t i = a->stack->used; i < top; i++) {
+        const HParser *q = (const HParser *)a->stack->elements[i];
+        e.effects |= has_effects(q);
+        if (q->vtable->walk)
+            q->vtable->walk(q->env, child_effects, &e);
+    }
+    for (size_t i = a->stack->used; i < top; i++) {
+        HMemoNode *m = h_hashtable_get(a->nodes, (const HParser *)a->stack->elements[i]);
+        m->on_stack = false;
+        m->cyclic |= top - a->stack->used > 1;
+        m->effects = e.effects;
+    }
+}
+
+static void mark_memo(HAllocator *mm__, HParser *parser) {
+    HArena *arena = h_new_arena(mm__, 0);
+    HMemoAnalysis a = {arena, h_hashtable_new(arena, h_eq_ptr, h_hash_ptr), h_carray_new(arena),
+                       h_carray_new(arena), 0, NULL};
+
+    memo_visit(&a, parser);
+    for (size_t i = 0; i < a.all->used; i++) {
+        HParser *p = (HParser *)a.all->elements[i];
+        HParserPrivate *priv = h_parser_private(p);
+        const HMemoNode *n = h_hashtable_get(a.nodes, p);
+        bool retried = false;
+        if (n->parent) {
+            const HMemoNode *up = h_hashtable_get(a.nodes, n->parent);
+            retried = up->cyclic || n->parent->vtable == &permutation_vt;
+        }
+        if (n->cyclic || n->parents > 1 || n->effects || retried)
+            priv->memo = H_MEMO_ON;
+        else if (priv->memo != H_MEMO_ON)
+            priv->memo = H_MEMO_OFF;
+    }
+    h_delete_arena(arena);
+}
+
 int h_packrat_compile(HAllocator *mm__, HParser *parser, const void *params) {
     parser->backend_vtable = &h__packrat_backend_vtable;
     parser->backend = PB_PACKRAT;
-    return 0; // No compilation necessary, and everything should work
-              // out of the box.
+
+    // Everything works out of the box; this only adds dispatch tables so
+    // that choices can skip alternatives that cannot match the next byte,
+    // and fuses runs of literals in sequences into single comparisons.
+    HPackratCompile c = {mm__, parser, NULL, false};
+    h_walk_parsers(mm__, parser, compile_node, &c);
+    if (c.grammar)
+        h_cfgrammar_free(c.grammar);
+    mark_memo(mm__, parser);
+    return 0;
 }
 
 void h_packrat_free(HParser *parser) {
@@ -275,58 +483,101 @@ void h_packrat_free(HParser *parser) {
 }
 
 static uint32_t cache_key_hash(const void *key) {
-#ifdef DETAILED_PACKRAT_STATISTICS
-    ++(packrat_hash_count);
-    packrat_hash_bytes += sizeof(HParserCacheKey);
-#endif
     return h_djbhash(key, sizeof(HParserCacheKey));
 }
 
 static bool cache_key_equal(const void *key1, const void *key2) {
-#ifdef DETAILED_PACKRAT_STATISTICS
-    ++(packrat_cmp_count);
-    packrat_cmp_bytes += sizeof(HParserCacheKey);
-#endif
     return memcmp(key1, key2, sizeof(HParserCacheKey)) == 0;
 }
 
 static uint32_t pos_hash(const void *key) {
-#ifdef DETAILED_PACKRAT_STATISTICS
-    ++(packrat_hash_count);
-    packrat_hash_bytes += sizeof(HInputStream);
-#endif
     return h_djbhash(key, sizeof(HInputStream));
 }
 
 static bool pos_equal(const void *key1, const void *key2) {
-#ifdef DETAILED_PACKRAT_STATISTICS
-    ++(packrat_cmp_count);
-    packrat_cmp_bytes += sizeof(HInputStream);
-#endif
     return memcmp(key1, key2, sizeof(HInputStream)) == 0;
 }
 
-HParseResult *h_packrat_parse(HAllocator *mm__, const HParser *parser, HInputStream *input_stream) {
+static HParseState *new_parse_state(HArena *arena, HArena *memo_arena,
+                                    const HInputStream *input_stream) {
+    HParseState *parse_state = a_new_(memo_arena, HParseState, 1);
+    parse_state->cache = h_hashtable_new(memo_arena, cache_key_equal, // key_equal_func
+                                         cache_key_hash);             // hash_func
+    parse_state->input_stream = *input_stream;
+    parse_state->lr_stack = h_slist_new(memo_arena);
+    parse_state->recursion_heads = h_hashtable_new(memo_arena, pos_equal, pos_hash);
+    parse_state->arena = arena;
+    parse_state->memo_arena = memo_arena;
+    parse_state->symbol_table = NULL;
+    parse_state->options = NULL;
+    parse_state->deadline = 0;
+    return parse_state;
+}
+
+// Fill in the stats of the memo table and the arena at the end of a parse.
+static void parse_stats(const HParseState *state, HParseStats *stats) {
+    const HHashTable *ht = state->cache;
+    size_t chains = 0;
+
+    stats->memo_hash_bytes = stats->memo_lookups * sizeof(HParserCacheKey);
+    stats->memo_entries = 0;
+    stats->memo_capacity = ht->capacity;
+    stats->memo_chain_max = 0;
+    for (size_t i = 0; i < ht->capacity; i++) {
+        size_t len = 0;
+        for (const HHashTableEntry *hte = &ht->contents[i]; hte; hte = hte->next)
+            len += hte->key != NULL;
+        if (len > 0)
+            chains++;
+        if (len > stats->memo_chain_max)
+            stats->memo_chain_max = len;
+        stats->memo_entries += len;
+    }
+    stats->memo_load = ht->capacity ? (double)stats->memo_entries / ht->capacity : 0;
+    stats->memo_chain_mean = chains ? (double)stats->memo_entries / chains : 0;
+    h_allocator_detailed_stats(state->arena, &stats->arena);
+}
+
+HParseResult *h_packrat_parse_with_options(HAllocator *mm__, const HParser *parser,
+                                           HInputStream *input_stream,
+                                           const HParseOptions *options) {
     HArena *arena = h_new_arena(mm__, 0);
 
-    // out-of-memory handling
+    // out-of-memory handling, and running over budget
+    HParseState *volatile parse_state = NULL;
     jmp_buf except;
     h_arena_set_except(arena, &except);
     if (setjmp(except)) {
+        // a parse abandoned for its budget stopped between two calls
+        if (parse_state && options && options->stats && options->budget &&
+            options->budget->exceeded)
+            parse_stats(parse_state, options->stats);
         h_delete_arena(arena);
         return NULL;
     }
 
-    HParseState *parse_state = a_new_(arena, HParseState, 1);
-    parse_state->cache = h_hashtable_new(arena, cache_key_equal, // key_equal_func
-                                         cache_key_hash);        // hash_func
-    parse_state->input_stream = *input_stream;
-    parse_state->lr_stack = h_slist_new(arena);
-    parse_state->recursion_heads = h_hashtable_new(arena, pos_equal, pos_hash);
-    parse_state->arena = arena;
-    parse_state->symbol_table = NULL;
+    parse_state = new_parse_state(arena, arena, input_stream);
+    if (options && (options->profile || options->trace || options->stats || options->complexity ||
+                    options->budget)) {
+        parse_state->options = options;
+        if (options->budget) {
+            HParseBudget *budget = options->budget;
+            budget->exceeded = H_BUDGET_OK;
+            budget->steps = 0;
+            if (budget->deadline_ns)
+                parse_state->deadline = h_platform_time_ns() + (int64_t)budget->deadline_ns;
+        }
+        if (options->profile)
+            h_profile_begin(options->profile);
+        if (options->complexity)
+            h_complexity_begin(options->complexity);
+        if (options->stats)
+            memset(options->stats, 0, sizeof(HParseStats));
+    }
     HParseResult *res = h_do_parse(parser, parse_state);
     *input_stream = parse_state->input_stream;
+    if (options && options->stats)
+        parse_stats(parse_state, options->stats);
     h_slist_free(parse_state->lr_stack);
     h_hashtable_free(parse_state->recursion_heads);
     // tear down the parse state
@@ -337,11 +588,77 @@ HParseResult *h_packrat_parse(HAllocator *mm__, const HParser *parser, HInputStr
     return res;
 }
 
+HParseResult *h_packrat_parse(HAllocator *mm__, const HParser *parser, HInputStream *input_stream) {
+    return h_packrat_parse_with_options(mm__, parser, input_stream, NULL);
+}
+
+// Parse from *input in a parse state of its own, so that several of these
+// can run at once on different threads. Results go into arena, memo tables
+// into memo_arena. Values stored with h_put_value are not visible.
+HParseResult *h_packrat_parse_isolated(HArena *arena, HArena *memo_arena, const HParser *parser,
+                                       HInputStream *input) {
+    HParseState *parse_state = new_parse_state(arena, memo_arena, input);
+    HParseResult *res = h_do_parse(parser, parse_state);
+    *input = parse_state->input_stream;
+    return res;
+}
+
+// Batches put all results into one arena and keep the memo tables in a
+// second one that is reset between items, so its blocks are reused instead
+// of being allocated and freed again for every input.
+size_t h_packrat_parse_batch(HAllocator *mm__, const HParser *parser, const uint8_t *const inputs[],
+                             const size_t lengths[], size_t n, HParseResult *results[]) {
+    HArena *arena = h_new_arena(mm__, 0);
+    HArena *memo = h_new_arena(mm__, 0);
+    volatile size_t nok = 0;
+    size_t i;
+
+    // out-of-memory handling
+    jmp_buf except;
+    h_arena_set_except(arena, &except);
+    h_arena_set_except(memo, &except);
+    if (setjmp(except)) {
+        for (i = 0; i < n; i++)
+            results[i] = NULL;
+        h_delete_arena(memo);
+        h_delete_arena(arena);
+        return 0;
+    }
+
+    for (i = 0; i < n; i++) {
+        HInputStream input_stream = {.pos = 0,
+                                     .index = 0,
+                                     .bit_offset = 0,
+                                     .overrun = 0,
+                                     .endianness = DEFAULT_ENDIANNESS,
+                                     .length = lengths[i],
+                                     .input = inputs[i],
+                                     .last_chunk = true};
+        if (i + 1 < n)
+            H_PREFETCH(inputs[i + 1]);
+
+        HParseState *parse_state = new_parse_state(arena, memo, &input_stream);
+        results[i] = h_do_parse(parser, parse_state);
+        if (results[i])
+            nok++;
+        h_arena_reset(memo);
+    }
+
+    h_delete_arena(memo);
+    if (nok == 0)
+        h_delete_arena(arena);
+    return nok;
+}
+
 // The following naive implementation of the iterative (chunked) parsing API
-// concatenates chunks and blindly re-runs the full parse on every call to
+// saves the chunks and blindly re-runs the full parse on every call to
 // h_packrat_parse_chunk.
 //
-// NB: A full implementation will still have to concatenate the chunks to
+// Each chunk is copied exactly once into a buffer of its own and the parse
+// runs over the list of saved chunks as a segmented input stream, so the
+// input received so far is never reallocated or copied again.
+//
+// NB: A full implementation will still have to keep the chunks around to
 // support arbitrary backtracking, but should be able save much, if not all, of
 // the HParseState between calls.
 // Cutting unneeded past input should also be possible but is complicated by
@@ -354,6 +671,40 @@ HParseResult *h_packrat_parse(HAllocator *mm__, const HParser *parser, HInputStr
 // earlier chunks will be reported as fully consumed and as being part of the
 // HParseResult in terms of its bit_length field.
 
+typedef struct {
+    HInputSegment *segs; // saved chunks, each in its own buffer
+    size_t capacity;
+    HInputSegments desc;
+} HPackratChunks;
+
+static void save_chunk(HAllocator *mm__, HPackratChunks *chunks, const HInputStream *input) {
+    uint8_t *data;
+
+    if (input->length == 0)
+        return;
+    if (input->length > SIZE_MAX - chunks->desc.length)
+        h_platform_errx(1, "input length would overflow");
+
+    if (chunks->desc.count == chunks->capacity) {
+        chunks->capacity = chunks->capacity ? 2 * chunks->capacity : 4;
+        chunks->segs = h_realloc(mm__, chunks->segs, chunks->capacity * sizeof(HInputSegment));
+    }
+    data = h_alloc(mm__, input->length);
+    memcpy(data, input->input, input->length);
+    chunks->segs[chunks->desc.count].data = data;
+    chunks->segs[chunks->desc.count].length = input->length;
+    chunks->desc.segs = chunks->segs;
+    chunks->desc.count++;
+    chunks->desc.length += input->length;
+}
+
+static void free_chunks(HAllocator *mm__, HPackratChunks *chunks) {
+    for (size_t i = 0; i < chunks->desc.count; i++)
+        h_free((void *)chunks->segs[i].data);
+    h_free(chunks->segs);
+    h_free(chunks);
+}
+
 void h_packrat_parse_start(HSuspendedParser *s) {
     // nothing to do here, we allocate lazily below
 }
@@ -361,8 +712,9 @@ void h_packrat_parse_start(HSuspendedParser *s) {
 bool h_packrat_parse_chunk(HSuspendedParser *s, HInputStream *input) {
     HAllocator *mm__ = s->mm__;
     HParseResult *res;
-    HInputStream *cat;
-    size_t newlen;
+    HPackratChunks *chunks;
+    HInputStream cat;
+    size_t end;
 
     if (s->backend_state == NULL) { // this is the first chunk
         // attempt to finish the parse on just the given input.
@@ -372,37 +724,29 @@ bool h_packrat_parse_chunk(HSuspendedParser *s, HInputStream *input) {
             return true;            // and signal we're done
         }
 
-        // we ran out of input and are expecting more
-        // allocate and initialize an input stream to concatenate the chunks
-        cat = h_new(HInputStream, 1);
-        *cat = *input;
-        cat->input = h_alloc(mm__, input->length);
-        memcpy((void *)cat->input, input->input, input->length);
-        s->backend_state = cat;
+        // we ran out of input and are expecting more; start saving chunks
+        chunks = h_new(HPackratChunks, 1);
+        memset(chunks, 0, sizeof(HPackratChunks));
+        save_chunk(mm__, chunks, input);
+        s->backend_state = chunks;
 
         goto suspend;
     }
 
-    // we have received additional input - append it to the saved stream
-    cat = s->backend_state;
-    assert(input->pos == cat->length);
-    if (input->length > SIZE_MAX - cat->length)
-        h_platform_errx(1, "input length would overflow");
-    newlen = cat->length + input->length;
-    cat->input = h_realloc(mm__, (void *)cat->input, newlen);
-    memcpy((void *)cat->input + cat->length, input->input, input->length);
-    cat->length = newlen;
-    cat->last_chunk = input->last_chunk;
-
-    // reset our input stream and call the parser on it (again)
-    cat->index = 0;
-    cat->bit_offset = 0;
-    cat->margin = 0;
-    cat->endianness = DEFAULT_ENDIANNESS;
-    cat->overrun = false;
-    res = h_packrat_parse(mm__, s->parser, cat);
-    assert(cat->index <= cat->length);
-    input->overrun = cat->overrun;
+    // we have received additional input - add it to the saved chunks
+    chunks = s->backend_state;
+    assert(input->pos == chunks->desc.length);
+    save_chunk(mm__, chunks, input);
+
+    // set up a fresh stream over all chunks and call the parser on it (again)
+    memset(&cat, 0, sizeof(HInputStream));
+    cat.endianness = DEFAULT_ENDIANNESS;
+    cat.last_chunk = input->last_chunk;
+    h_input_stream_init_segments(&cat, &chunks->desc);
+    res = h_packrat_parse(mm__, s->parser, &cat);
+    end = cat.pos + cat.index;
+    assert(end <= chunks->desc.length);
+    input->overrun = cat.overrun;
 
     // suspend if the parser still needs more input
     if (input->overrun && !input->last_chunk)
@@ -410,20 +754,19 @@ bool h_packrat_parse_chunk(HSuspendedParser *s, HInputStream *input) {
     // otherwise the parse is finished...
 
     // report final input position
-    if (cat->index < input->pos) { // parser just needed some lookahead
-        input->index = 0;          // don't consume this last chunk
+    if (end < input->pos) { // parser just needed some lookahead
+        input->index = 0;   // don't consume this last chunk
         input->bit_offset = 0;
         input->margin = 0;
     } else {
-        input->index = cat->index - input->pos;
-        input->bit_offset = cat->bit_offset;
-        input->margin = cat->margin;
-        input->endianness = cat->endianness;
+        input->index = end - input->pos;
+        input->bit_offset = cat.bit_offset;
+        input->margin = cat.margin;
+        input->endianness = cat.endianness;
     }
 
     // clean up and return the result
-    h_free((void *)cat->input);
-    h_free(cat);
+    free_chunks(mm__, chunks);
     s->backend_state = res;
 
     return true; // don't call me again.
@@ -444,6 +787,8 @@ HParserBackendVTable h__packrat_backend_vtable = {
     .parse_start = h_packrat_parse_start,
     .parse_chunk = h_packrat_parse_chunk,
     .parse_finish = h_packrat_parse_finish,
+    .parse_batch = h_packrat_parse_batch,
+    .parse_with_options = h_packrat_parse_with_options,
     /* Name/param resolution functions */
     .backend_short_name = "packrat",
     .backend_description = "Packrat parser with Warth's recursion",
@@ -2,12 +2,16 @@
 #include "internal.h"
 #include "platform.h"
 
+#include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-static const char *HParserBackendNames[] = {"Packrat", "Regular", "LL(k)", "LALR", "GLR"};
+static const char *backend_name(HParserBackend backend) {
+    const char *name = h_get_name_for_backend(backend);
+    return name ? name : "invalid";
+}
 
 /*
   Usage:
@@ -26,31 +30,203 @@ static const char *HParserBackendNames[] = {"Packrat", "Regular", "LL(k)", "LALR
 
 */
 
+// What h_benchmark hands out, and beside it the timing distributions, one
+// array of n_testcases per backend that was benchmarked.
+typedef struct {
+    HBenchmarkResults results;
+    HBenchmarkStats **stats;
+} HBenchmarkResultsPrivate;
+
+static int64_t time_parses(HParser *parser, const HParserTestcase *tc, size_t count) {
+    struct HStopWatch stopwatch;
+    h_platform_stopwatch_reset(&stopwatch);
+    for (size_t i = 0; i < count; i++)
+        h_parse_result_free(h_parse(parser, tc->input, tc->length));
+    return h_platform_stopwatch_ns(&stopwatch);
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Newton's method, so that libhammer does not need libm.
+static double square_root(double x) {
+    double r = x > 1 ? x : 1;
+    for (int i = 0; i < 64 && x > 0; i++) {
+        double next = (r + x / r) / 2;
+        if (next >= r)
+            break;
+        r = next;
+    }
+    return x > 0 ? r : 0;
+}
+
+// Fill in the counts per parse from counters that ran for `parses` parses.
+static void read_counters(struct HPerfCounters *pc, bool hardware, size_t parses,
+                          HBenchmarkCounters *out) {
+    double *fields[H_PERF_NEVENTS] = {
+        [H_PERF_INSTRUCTIONS] = &out->instructions,
+        [H_PERF_CYCLES] = &out->cycles,
+        [H_PERF_BRANCHES] = &out->branches,
+        [H_PERF_BRANCH_MISSES] = &out->branch_misses,
+        [H_PERF_L1D_MISSES] = &out->l1d_misses,
+        [H_PERF_LLC_MISSES] = &out->llc_misses,
+        [H_PERF_TASK_CLOCK_NS] = &out->task_clock_ns,
+        [H_PERF_PAGE_FAULTS] = &out->page_faults,
+        [H_PERF_CONTEXT_SWITCHES] = &out->context_switches,
+    };
+    out->hardware = hardware;
+    for (int i = 0; i < H_PERF_NEVENTS; i++) {
+        uint64_t value;
+        *fields[i] = h_platform_perf_read(pc, i, &value) ? (double)value / (double)parses : -1;
+    }
+    out->ipc = out->instructions >= 0 && out->cycles > 0 ? out->instructions / out->cycles : -1;
+    out->branch_miss_rate = out->branch_misses >= 0 && out->branches > 0
+                                ? out->branch_misses / out->branches
+                                : -1;
+}
+
+static void no_counters(HBenchmarkCounters *out) {
+    *out = (HBenchmarkCounters){false, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1};
+}
+
+// One more parse, to see what it allocates and which parsers take the arena.
+static void measure_memory(HAllocator *mm__, HParser *parser, const HParserTestcase *tc,
+                           HBenchmarkStats *stats) {
+    HAllocTracker tracker;
+    HProfile *profile = h_profile_new();
+    HParseOptions options = {.profile = profile};
+
+    h_alloc_tracker_init(&tracker, &system_allocator);
+    h_parse_result_free(
+        h_parse_with_options__m(&tracker.allocator, parser, tc->input, tc->length, &options));
+    stats->bytes_allocated = tracker.bytes;
+    stats->allocations = tracker.allocs;
+    stats->peak_bytes = tracker.peak;
+    memcpy(stats->size_classes, tracker.size_classes, sizeof(stats->size_classes));
+
+    h_profile_sort(profile, H_PROFILE_BY_ARENA_EXCLUSIVE);
+    for (size_t i = 0; i < H_BENCHMARK_TOP_ALLOCATORS; i++) {
+        const HProfileEntry *e = h_profile_entry(profile, i);
+        HBenchmarkAllocSite *site = &stats->top_allocators[i];
+        site->parser = NULL;
+        site->arena_bytes = 0;
+        if (e && e->arena_exclusive_bytes > 0) {
+            size_t n = strlen(e->name) + 1;
+            char *name = h_new(char, n);
+            memcpy(name, e->name, n);
+            site->parser = name;
+            site->arena_bytes = e->arena_exclusive_bytes;
+        }
+    }
+    h_profile_free(profile);
+}
+
+static void measure_case(HAllocator *mm__, HParser *parser, const HParserTestcase *tc,
+                         const HBenchmarkOptions *options, HBenchmarkStats *stats) {
+    // Warm up caches and the allocator, growing the batch until one takes
+    // long enough to time reliably.
+    size_t iterations = 1;
+    int64_t spent = 0;
+    for (;;) {
+        int64_t t = time_parses(parser, tc, iterations);
+        spent += t;
+        if (t >= options->sample_ns && spent >= options->warmup_ns)
+            break;
+        if (t < options->sample_ns)
+            iterations *= 2;
+    }
+
+    // The counters run across all the samples, so reading them costs nothing per parse.
+    struct HPerfCounters pc;
+    bool hardware = false;
+    if (options->counters) {
+        hardware = h_platform_perf_open(&pc);
+        h_platform_perf_start(&pc);
+    }
+    double *samples = h_new(double, options->samples);
+    double sum = 0;
+    for (size_t i = 0; i < options->samples; i++) {
+        samples[i] = (double)time_parses(parser, tc, iterations) / (double)iterations;
+        sum += samples[i];
+    }
+    if (options->counters) {
+        h_platform_perf_stop(&pc);
+        read_counters(&pc, hardware, options->samples * iterations, &stats->counters);
+        h_platform_perf_close(&pc);
+    } else {
+        no_counters(&stats->counters);
+    }
+    qsort(samples, options->samples, sizeof(double), cmp_double);
+
+    size_t n = options->samples;
+    stats->samples = n;
+    stats->iterations = iterations;
+    stats->min_ns = samples[0];
+    stats->median_ns = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+    stats->p99_ns = samples[(99 * n + 99) / 100 - 1];
+    stats->mean_ns = sum / (double)n;
+    double var = 0;
+    for (size_t i = 0; i < n; i++)
+        var += (samples[i] - stats->mean_ns) * (samples[i] - stats->mean_ns);
+    stats->stddev_ns = n > 1 ? square_root(var / (double)(n - 1)) : 0;
+    stats->mb_per_s = stats->median_ns > 0 ? (double)tc->length * 1e3 / stats->median_ns : 0;
+    h_free(samples);
+
+    measure_memory(mm__, parser, tc, stats);
+}
+
 HBenchmarkResults *h_benchmark(HParser *parser, HParserTestcase *testcases) {
     return h_benchmark__m(&system_allocator, parser, testcases);
 }
 
 HBenchmarkResults *h_benchmark__m(HAllocator *mm__, HParser *parser, HParserTestcase *testcases) {
+    return h_benchmark_with_options__m(mm__, parser, testcases, NULL);
+}
+
+HBenchmarkResults *h_benchmark_with_options(HParser *parser, HParserTestcase *testcases,
+                                            const HBenchmarkOptions *options) {
+    return h_benchmark_with_options__m(&system_allocator, parser, testcases, options);
+}
+
+HBenchmarkResults *h_benchmark_with_options__m(HAllocator *mm__, HParser *parser,
+                                               HParserTestcase *testcases,
+                                               const HBenchmarkOptions *options) {
+    HBenchmarkOptions opts = {10000000, 3000000, 30, false};
+    if (options) {
+        opts.counters = options->counters;
+        if (options->warmup_ns > 0)
+            opts.warmup_ns = options->warmup_ns;
+        if (options->sample_ns > 0)
+            opts.sample_ns = options->sample_ns;
+        if (options->samples > 0)
+            opts.samples = options->samples;
+    }
+
     // For now, just output the results to stderr
     HParserTestcase *tc = testcases;
     HParserBackend backend = PB_MIN;
-    HBenchmarkResults *ret = h_new(HBenchmarkResults, 1);
+    HBenchmarkResultsPrivate *priv = h_new(HBenchmarkResultsPrivate, 1);
+    HBenchmarkResults *ret = &priv->results;
     ret->len = PB_MAX - PB_MIN + 1;
     ret->results = h_new(HBackendResults, ret->len);
+    priv->stats = h_new(HBenchmarkStats *, ret->len);
+    memset(priv->stats, 0, ret->len * sizeof(HBenchmarkStats *));
 
     for (backend = PB_MIN; backend <= PB_MAX; backend++) {
         ret->results[backend].backend = backend;
+        ret->results[backend].cases = NULL;
         // Step 1: Compile grammar for given parser...
         if (h_compile(parser, backend, NULL)) {
             // backend inappropriate for grammar...
-            fprintf(stderr, "Compiling for %s failed\n", HParserBackendNames[backend]);
+            fprintf(stderr, "Compiling for %s failed\n", backend_name(backend));
             ret->results[backend].compile_success = false;
             ret->results[backend].n_testcases = 0;
             ret->results[backend].failed_testcases = 0;
-            ret->results[backend].cases = NULL;
             continue;
         }
-        fprintf(stderr, "Compiled for %s\n", HParserBackendNames[backend]);
+        fprintf(stderr, "Compiled for %s\n", backend_name(backend));
         ret->results[backend].compile_success = true;
         int tc_failed = 0;
         // Step 1: verify all test cases.
@@ -67,7 +243,7 @@ HBenchmarkResults *h_benchmark__m(HAllocator *mm__, HParser *parser, HParserTest
             if ((res_unamb == NULL && tc->output_unambiguous != NULL) ||
                 (res_unamb != NULL && strcmp(res_unamb, tc->output_unambiguous) != 0)) {
                 // test case failed...
-                fprintf(stderr, "Parsing with %s failed\n", HParserBackendNames[backend]);
+                fprintf(stderr, "Parsing with %s failed\n", backend_name(backend));
                 // We want to run all testcases, for purposes of generating a
                 // report. (eg, if users are trying to fix a grammar for a
                 // faster backend)
@@ -81,50 +257,177 @@ HBenchmarkResults *h_benchmark__m(HAllocator *mm__, HParser *parser, HParserTest
         if (tc_failed > 0) {
             // Can't use this parser; skip to the next
             fprintf(stderr, "%s failed testcases; skipping benchmark\n",
-                    HParserBackendNames[backend]);
+                    backend_name(backend));
             continue;
         }
 
         ret->results[backend].cases = h_new(HCaseResult, ret->results[backend].n_testcases);
+        priv->stats[backend] = h_new(HBenchmarkStats, ret->results[backend].n_testcases);
         size_t cur_case = 0;
 
         for (tc = testcases; tc->input != NULL; tc++) {
-            // The goal is to run each testcase for at least 50ms each
-            int count = 1, cur;
-            int64_t time_diff;
-            do {
-                count *= 2; // Yes, this means that the first run will run the function twice. This
-                            // is fine, as we want multiple runs anyway.
-                struct HStopWatch stopwatch;
-                h_platform_stopwatch_reset(&stopwatch);
-                for (cur = 0; cur < count; cur++) {
-                    h_parse_result_free(h_parse(parser, tc->input, tc->length));
-                }
-                time_diff = h_platform_stopwatch_ns(&stopwatch);
-            } while (time_diff < 100000000);
-            ret->results[backend].cases[cur_case].parse_time = (time_diff / count);
-            ret->results[backend].cases[cur_case].length = tc->length;
-            cur_case++;
+            HBenchmarkStats *st = &priv->stats[backend][cur_case];
+            HCaseResult *cr = &ret->results[backend].cases[cur_case++];
+            measure_case(mm__, parser, tc, &opts, st);
+            cr->success = true;
+            cr->parse_time = (size_t)st->mean_ns;
+            cr->length = tc->length;
         }
     }
     return ret;
 }
 
+const HBenchmarkStats *h_benchmark_stats(const HBenchmarkResults *results, size_t backend,
+                                         size_t testcase) {
+    const HBenchmarkResultsPrivate *priv = (const HBenchmarkResultsPrivate *)results;
+    if (backend >= results->len || !priv->stats[backend] ||
+        testcase >= results->results[backend].n_testcases)
+        return NULL;
+    return &priv->stats[backend][testcase];
+}
+
+// A count per byte of input, or -1 if it was not counted.
+static double per_byte(double count, size_t length) {
+    return count >= 0 && length > 0 ? count / (double)length : -1;
+}
+
+static void report_memory(FILE *stream, const HBenchmarkStats *st) {
+    fprintf(stream, "  peak %zu bytes; allocations by size:", st->peak_bytes);
+    for (size_t c = 0; c < H_ALLOC_SIZE_CLASSES; c++) {
+        if (st->size_classes[c] == 0)
+            continue;
+        if (c < H_ALLOC_SIZE_CLASSES - 1)
+            fprintf(stream, " <=%zu: %zu", (size_t)16 << c, st->size_classes[c]);
+        else
+            fprintf(stream, " more: %zu", st->size_classes[c]);
+    }
+    fputc('\n', stream);
+    for (size_t i = 0; i < H_BENCHMARK_TOP_ALLOCATORS && st->top_allocators[i].parser; i++)
+        fprintf(stream, "  %s %s: %" PRIu64 " arena bytes\n", i ? "          " : "top parsers",
+                st->top_allocators[i].parser, st->top_allocators[i].arena_bytes);
+}
+
+static void report_counters(FILE *stream, const HBenchmarkCounters *c, size_t length) {
+    if (c->task_clock_ns < 0)
+        return; // not asked for
+    if (c->hardware)
+        fprintf(stream,
+                "  %.0f instructions, %.0f cycles per parse (IPC %.2f); %.1f instructions, "
+                "%.1f cycles per byte\n"
+                "  branch misses %.1f per parse (%.2f%%); L1d misses %.1f per parse, %.3f per "
+                "byte; LLC misses %.1f per parse, %.3f per byte\n",
+                c->instructions, c->cycles, c->ipc, per_byte(c->instructions, length),
+                per_byte(c->cycles, length), c->branch_misses, c->branch_miss_rate * 100,
+                c->l1d_misses, per_byte(c->l1d_misses, length), c->llc_misses,
+                per_byte(c->llc_misses, length));
+    fprintf(stream, "  %s%.0f ns CPU, %.3f page faults, %.3f context switches per parse\n",
+            c->hardware ? "" : "no hardware counters; ", c->task_clock_ns, c->page_faults,
+            c->context_switches);
+}
+
 void h_benchmark_report(FILE *stream, HBenchmarkResults *result) {
     for (size_t i = 0; i < result->len; ++i) {
         if (result->results[i].cases == NULL) {
             fprintf(stream, "Skipping %s because grammar did not compile for it\n",
-                    HParserBackendNames[i]);
+                    backend_name(result->results[i].backend));
         } else {
-            fprintf(stream, "Backend %zd (%s) ... \n", i, HParserBackendNames[i]);
+            fprintf(stream, "Backend %zd (%s) ... \n", i, backend_name(result->results[i].backend));
         }
         for (size_t j = 0; j < result->results[i].n_testcases; ++j) {
             if (result->results[i].cases == NULL) {
                 continue;
             }
-            fprintf(stream, "Case %zd: %zd ns/parse, %zd ns/byte\n", j,
-                    result->results[i].cases[j].parse_time,
-                    result->results[i].cases[j].parse_time / result->results[i].cases[j].length);
+            const HCaseResult *cr = &result->results[i].cases[j];
+            const HBenchmarkStats *st = h_benchmark_stats(result, i, j);
+            fprintf(stream, "Case %zd: %zd ns/parse, %zd ns/byte\n", j, cr->parse_time,
+                    cr->length ? cr->parse_time / cr->length : 0);
+            fprintf(stream,
+                    "  min %.0f, median %.0f, p99 %.0f, stddev %.0f ns over %zu x %zu parses; "
+                    "%.2f MB/s; %zu bytes in %zu allocations\n",
+                    st->min_ns, st->median_ns, st->p99_ns, st->stddev_ns, st->samples,
+                    st->iterations, st->mb_per_s, st->bytes_allocated, st->allocations);
+            report_memory(stream, st);
+            report_counters(stream, &st->counters, cr->length);
         }
     }
 }
+
+// The rest of a case's JSON object: the lists, which CSV leaves out.
+static void write_json_memory(FILE *stream, const HBenchmarkStats *st) {
+    fputs(", \"size_classes\": [", stream);
+    for (size_t c = 0; c < H_ALLOC_SIZE_CLASSES; c++)
+        fprintf(stream, "%s%zu", c ? ", " : "", st->size_classes[c]);
+    fputs("], \"top_allocators\": [", stream);
+    for (size_t i = 0; i < H_BENCHMARK_TOP_ALLOCATORS && st->top_allocators[i].parser; i++) {
+        fputs(i ? ", {\"parser\": " : "{\"parser\": ", stream);
+        h_write_json_string(stream, st->top_allocators[i].parser);
+        fprintf(stream, ", \"arena_bytes\": %" PRIu64 "}", st->top_allocators[i].arena_bytes);
+    }
+    fputs("]}", stream);
+}
+
+// One record per benchmarked case, in either format.
+static void write_cases(FILE *stream, const HBenchmarkResults *result, bool json) {
+    const char *sep = "";
+    for (size_t i = 0; i < result->len; ++i) {
+        const HBackendResults *br = &result->results[i];
+        if (br->cases == NULL)
+            continue;
+        for (size_t j = 0; j < br->n_testcases; ++j) {
+            const HCaseResult *cr = &br->cases[j];
+            const HBenchmarkStats *st = h_benchmark_stats(result, i, j);
+            const HBenchmarkCounters *c = &st->counters;
+            if (json) {
+                fprintf(stream,
+                        "%s  {\"backend\": \"%s\", \"case\": %zu, \"length\": %zu, "
+                        "\"samples\": %zu, \"iterations\": %zu, \"min_ns\": %.1f, "
+                        "\"median_ns\": %.1f, \"p99_ns\": %.1f, \"mean_ns\": %.1f, "
+                        "\"stddev_ns\": %.1f, \"mb_per_s\": %.3f, \"bytes_allocated\": %zu, "
+                        "\"allocations\": %zu, \"peak_bytes\": %zu, \"instructions\": %.1f, "
+                        "\"cycles\": %.1f, \"ipc\": %.3f, \"cycles_per_byte\": %.3f, "
+                        "\"branch_misses\": %.1f, \"branch_miss_rate\": %.4f, "
+                        "\"l1d_misses\": %.1f, \"l1d_misses_per_byte\": %.4f, "
+                        "\"llc_misses\": %.1f, \"llc_misses_per_byte\": %.4f, "
+                        "\"task_clock_ns\": %.1f, \"page_faults\": %.3f, "
+                        "\"context_switches\": %.3f",
+                        sep, backend_name(br->backend), j, cr->length, st->samples,
+                        st->iterations, st->min_ns, st->median_ns, st->p99_ns, st->mean_ns,
+                        st->stddev_ns, st->mb_per_s, st->bytes_allocated, st->allocations,
+                        st->peak_bytes, c->instructions, c->cycles, c->ipc,
+                        per_byte(c->cycles, cr->length), c->branch_misses, c->branch_miss_rate,
+                        c->l1d_misses, per_byte(c->l1d_misses, cr->length), c->llc_misses,
+                        per_byte(c->llc_misses, cr->length), c->task_clock_ns, c->page_faults,
+                        c->context_switches);
+                write_json_memory(stream, st);
+            } else {
+                fprintf(stream,
+                        "%s,%zu,%zu,%zu,%zu,%.1f,%.1f,%.1f,%.1f,%.1f,%.3f,%zu,%zu,%zu,%.1f,%.1f,"
+                        "%.3f,%.3f,%.1f,%.4f,%.1f,%.4f,%.1f,%.4f,%.1f,%.3f,%.3f\n",
+                        backend_name(br->backend), j, cr->length, st->samples, st->iterations,
+                        st->min_ns, st->median_ns, st->p99_ns, st->mean_ns, st->stddev_ns,
+                        st->mb_per_s, st->bytes_allocated, st->allocations, st->peak_bytes,
+                        c->instructions, c->cycles, c->ipc, per_byte(c->cycles, cr->length),
+                        c->branch_misses, c->branch_miss_rate, c->l1d_misses,
+                        per_byte(c->l1d_misses, cr->length), c->llc_misses,
+                        per_byte(c->llc_misses, cr->length), c->task_clock_ns, c->page_faults,
+                        c->context_switches);
+            }
+            sep = ",\n";
+        }
+    }
+}
+
+void h_benchmark_write_json(FILE *stream, const HBenchmarkResults *result) {
+    fputs("{\"cases\": [\n", stream);
+    write_cases(stream, result, true);
+    fputs("\n]}\n", stream);
+}
+
+void h_benchmark_write_csv(FILE *stream, const HBenchmarkResults *result) {
+    fputs("backend,case,length,samples,iterations,min_ns,median_ns,p99_ns,mean_ns,stddev_ns,"
+          "mb_per_s,bytes_allocated,allocations,peak_bytes,instructions,cycles,ipc,"
+          "cycles_per_byte,branch_misses,branch_miss_rate,l1d_misses,l1d_misses_per_byte,"
+          "llc_misses,llc_misses_per_byte,task_clock_ns,page_faults,context_switches\n",
+          stream);
+    write_cases(stream, result, false);
+}
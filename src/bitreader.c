@@ -26,6 +26,79 @@
 #define MSB(range) (1 : range)
 #define LDB(range, i) (((i) >> LSB(range)) & ((1 << (MSB(range) - LSB(range) + 1)) - 1))
 
+void h_input_stream_init_segments(HInputStream *state, const HInputSegments *segments) {
+    state->segments = segments;
+    state->segment = 0;
+    state->pos = 0;
+    state->index = 0;
+    if (segments->count == 0) {
+        state->input = NULL;
+        state->length = 0;
+        return;
+    }
+    state->input = segments->segs[0].data;
+    state->length = segments->segs[0].length;
+    h_input_stream_normalize(state);
+}
+
+// Move to the start of the next non-empty segment when the current one is
+// exhausted. The last segment is never left.
+void h_input_stream_normalize(HInputStream *state) {
+    const HInputSegments *segs = state->segments;
+
+    if (!segs)
+        return;
+    while (state->index == state->length && state->segment + 1 < segs->count) {
+        state->pos += state->length;
+        state->segment++;
+        state->input = segs->segs[state->segment].data;
+        state->length = segs->segs[state->segment].length;
+        state->index = 0;
+    }
+}
+
+// Advance a segmented stream by n whole bytes, which must be available.
+static void advance_segments(HInputStream *state, size_t n) {
+    while (n > state->length - state->index && state->segment + 1 < state->segments->count) {
+        n -= state->length - state->index;
+        state->index = state->length;
+        h_input_stream_normalize(state);
+    }
+    state->index += n;
+    h_input_stream_normalize(state);
+}
+
+// A read that crosses into the next segment: gather the (at most 9) bytes it
+// can touch into a small contiguous buffer and read from that.
+static int64_t read_bits_across(HInputStream *state, int count, char signed_p) {
+    const HInputSegments *segs = state->segments;
+    uint8_t buf[9];
+    size_t n = 0, seg = state->segment, idx = state->index;
+    HInputStream tmp = *state;
+    int64_t out;
+
+    while (n < sizeof(buf) && seg < segs->count) {
+        if (idx < segs->segs[seg].length) {
+            buf[n++] = segs->segs[seg].data[idx++];
+        } else {
+            seg++;
+            idx = 0;
+        }
+    }
+    tmp.input = buf;
+    tmp.pos = 0;
+    tmp.index = 0;
+    tmp.length = n;
+    tmp.segments = NULL;
+    out = h_read_bits(&tmp, count, signed_p);
+
+    advance_segments(state, tmp.index);
+    state->bit_offset = tmp.bit_offset;
+    state->margin = tmp.margin;
+    state->overrun = tmp.overrun;
+    return out;
+}
+
 int64_t h_read_bits(HInputStream *state, int count, char signed_p) {
     // BUG: Does not
     int64_t out = 0;
@@ -33,6 +106,10 @@ int64_t h_read_bits(HInputStream *state, int count, char signed_p) {
     int final_shift = 0;
     int64_t msb = ((signed_p ? 1LL : 0) << (count - 1)); // 0 if unsigned, else 1 << (nbits - 1)
 
+    if (state->segments && state->segment + 1 < state->segments->count &&
+        (size_t)count + state->bit_offset + state->margin > (state->length - state->index) * 8)
+        return read_bits_across(state, count, signed_p);
+
     // overflow check...
     int bits_left = (state->length - state->index); // well, bytes for now
     if (bits_left <= 64) { // Large enough to handle any valid count, but small enough that overflow
@@ -109,11 +186,13 @@ int64_t h_read_bits(HInputStream *state, int count, char signed_p) {
             count -= segment_len;
         }
     }
+    if (state->segments)
+        h_input_stream_normalize(state);
     out <<= final_shift;
     return (out ^ msb) - msb; // perform sign extension
 }
 
-void h_skip_bits(HInputStream *stream, size_t count) {
+static void skip_bits(HInputStream *stream, size_t count) {
     size_t left;
 
     if (count == 0)
@@ -161,7 +240,64 @@ void h_skip_bits(HInputStream *stream, size_t count) {
         stream->bit_offset = count;
 }
 
+void h_skip_bits(HInputStream *stream, size_t count) {
+    size_t left;
+
+    // skip to the end of the current segment first if the target lies beyond it
+    while (stream->segments && !stream->overrun && stream->segment + 1 < stream->segments->count) {
+        left = (stream->length - stream->index) * 8 - stream->bit_offset - stream->margin;
+        if (count <= left)
+            break;
+        count -= left;
+        stream->index = stream->length;
+        stream->bit_offset = 0;
+        stream->margin = 0;
+        h_input_stream_normalize(stream);
+    }
+    skip_bits(stream, count);
+    if (stream->segments)
+        h_input_stream_normalize(stream);
+}
+
+// Seek a segmented stream; pos is absolute.
+static void seek_segments(HInputStream *stream, size_t pos) {
+    const HInputSegments *segs = stream->segments;
+    size_t pos_index = pos / 8;
+    size_t pos_offset = pos % 8;
+
+    /* seek past the end? */
+    if ((pos_index > segs->length) || (pos_index == segs->length && pos_offset > 0)) {
+        pos_index = segs->length;
+        pos_offset = 0;
+        stream->overrun = true;
+    }
+
+    /* locate the segment containing the target byte */
+    while (pos_index < stream->pos) {
+        stream->segment--;
+        stream->input = segs->segs[stream->segment].data;
+        stream->length = segs->segs[stream->segment].length;
+        stream->pos -= stream->length;
+    }
+    while (pos_index >= stream->pos + stream->length && stream->segment + 1 < segs->count) {
+        stream->pos += stream->length;
+        stream->segment++;
+        stream->input = segs->segs[stream->segment].data;
+        stream->length = segs->segs[stream->segment].length;
+    }
+
+    stream->index = pos_index - stream->pos;
+    stream->bit_offset = pos_offset;
+    stream->margin = 0;
+    h_input_stream_normalize(stream);
+}
+
 void h_seek_bits(HInputStream *stream, size_t pos) {
+    if (stream->segments) {
+        seek_segments(stream, pos);
+        return;
+    }
+
     size_t pos_index = pos / 8;
     size_t pos_offset = pos % 8;
 
@@ -3,8 +3,10 @@
 
 #if defined(__clang__) || defined(__GNUC__)
 #define H_GCC_ATTRIBUTE(x) __attribute__(x)
+#define H_PREFETCH(p) __builtin_prefetch(p)
 #else
 #define H_GCC_ATTRIBUTE(x)
+#define H_PREFETCH(p) ((void)(p))
 #endif
 
 #endif
@@ -0,0 +1,364 @@
+/* Grammar complexity: left recursion, overlapping choices and backtracking */
+
+#include "cfgrammar.h"
+#include "hammer.h"
+#include "internal.h"
+#include "parsers/parser_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define TOP 10 // rows per table of the report
+
+struct HComplexityRule_ {
+    const HParser *parser;
+    const char *name;
+    size_t backtracks;   // calls it made that re-parsed, when it was not re-parsing itself
+    size_t max_behind;   // in bits, the furthest back one of those started
+    size_t lr_seeds;     // times setupLR found it calling itself
+    size_t grows;        // iterations of grow() on it
+    bool left_recursive; // in the grammar
+    // for choices: how many bytes (and end of input) two or more alternatives
+    // start with, the first two such alternatives, and one such byte
+    size_t overlaps;
+    size_t overlap_a, overlap_b;
+    size_t overlap_byte;
+};
+
+static HComplexityRule *rule_for(HComplexity *c, const HParser *parser) {
+    HComplexityRule *rule = h_hashtable_get(c->rules, parser);
+    if (!rule) {
+        // h_bind makes parsers during the parse
+        rule = h_arena_malloc(c->arena, sizeof(HComplexityRule));
+        memset(rule, 0, sizeof(HComplexityRule));
+        rule->parser = parser;
+        rule->name = h_parser_label(c->arena, parser);
+        h_hashtable_put(c->rules, parser, rule);
+        h_carray_append(c->order, rule);
+    }
+    return rule;
+}
+
+static HComplexityRule *rule_at(const HComplexity *c, size_t i) {
+    return (HComplexityRule *)c->order->elements[i];
+}
+
+static void add_rule(const HParser *p, void *ctx) { rule_for(ctx, p); }
+
+// Whether x reaches target through the leftmost symbols of its sequences:
+// the first one, and each one after a prefix that can match the empty string.
+static bool left_reaches(HCFGrammar *g, const HCFChoice *x, const HCFChoice *target,
+                         HHashSet *seen) {
+    if (x->type != HCF_CHOICE || h_hashset_present(seen, x))
+        return false;
+    h_hashset_put(seen, x);
+    for (HCFSequence **s = x->seq; *s; s++) {
+        for (HCFChoice **y = (*s)->items; *y; y++) {
+            if (*y == target || left_reaches(g, *y, target, seen))
+                return true;
+            if (!h_derives_epsilon(g, *y))
+                break;
+        }
+    }
+    return false;
+}
+
+// Mark the left-recursive nonterminals of g in lr, and all of them in covered.
+static void find_left_recursion(HCFGrammar *g, HArena *arena, HHashSet *lr, HHashSet *covered) {
+    for (size_t i = 0; i < g->nts->capacity; i++) {
+        for (HHashTableEntry *hte = &g->nts->contents[i]; hte; hte = hte->next) {
+            if (hte->key == NULL)
+                continue;
+            const HCFChoice *nt = hte->key;
+            h_hashset_put(covered, nt);
+            if (left_reaches(g, nt, nt, h_hashset_new(arena, h_eq_ptr, h_hash_ptr)))
+                h_hashset_put(lr, nt);
+        }
+    }
+}
+
+// Alternatives that can start with anything, because they match the empty
+// string or are not context-free, have to be tried everywhere; they are left
+// out, since no dispatch on the next byte could skip them.
+static void find_overlaps(HComplexity *c, HComplexityRule *rule) {
+    HAllocator *mm__ = c->mm__;
+    const HChoice *s = rule->parser->env;
+    size_t len = s->len, rows = H_FIRST_END + 1;
+    uint8_t *member = h_choice_first_sets(mm__, rule->parser, NULL);
+    bool *anywhere = h_new(bool, len);
+
+    for (size_t i = 0; i < len; i++) {
+        anywhere[i] = true;
+        for (size_t r = 0; r < rows && anywhere[i]; r++)
+            anywhere[i] = member[r * len + i];
+    }
+    for (size_t r = 0; r < rows; r++) {
+        size_t first = len, n = 0;
+        for (size_t i = 0; i < len; i++) {
+            if (!member[r * len + i] || anywhere[i])
+                continue;
+            if (n++ == 0) {
+                first = i;
+            } else if (n == 2 && rule->overlaps == 0) {
+                rule->overlap_a = first;
+                rule->overlap_b = i;
+                rule->overlap_byte = r;
+            }
+        }
+        rule->overlaps += n >= 2;
+    }
+    h_free(anywhere);
+    h_free(member);
+}
+
+HComplexity *h_complexity_new(const HParser *parser) {
+    return h_complexity_new__m(&system_allocator, parser);
+}
+HComplexity *h_complexity_new__m(HAllocator *mm__, const HParser *parser) {
+    HComplexity *c = h_new(HComplexity, 1);
+    memset(c, 0, sizeof(HComplexity));
+    c->mm__ = mm__;
+    c->arena = h_new_arena(mm__, 0);
+    c->rules = h_hashtable_new(c->arena, h_eq_ptr, h_hash_ptr);
+    c->order = h_carray_new(c->arena);
+    c->positions = h_hashtable_new(c->arena, h_eq_ptr, h_hash_ptr);
+    c->name = h_parser_label(c->arena, parser);
+    h_walk_parsers(mm__, parser, add_rule, c);
+
+    // Walked children first, so backwards the start parser comes first; if
+    // the whole grammar is context-free, one CFG covers every rule.
+    HArena *tmp = h_new_arena(mm__, 0);
+    HHashSet *lr = h_hashset_new(tmp, h_eq_ptr, h_hash_ptr);
+    HHashSet *covered = h_hashset_new(tmp, h_eq_ptr, h_hash_ptr);
+    for (size_t i = c->order->used; i-- > 0;) {
+        const HParser *p = rule_at(c, i)->parser;
+        if (p->desugared && h_hashset_present(covered, p->desugared))
+            continue;
+        HCFGrammar *g = h_cfgrammar(mm__, p);
+        if (g) {
+            find_left_recursion(g, tmp, lr, covered);
+            h_cfgrammar_free(g);
+        }
+    }
+    for (size_t i = 0; i < c->order->used; i++) {
+        HComplexityRule *rule = rule_at(c, i);
+        if (rule->parser->desugared && h_hashset_present(lr, rule->parser->desugared))
+            rule->left_recursive = true;
+        if (rule->parser->vtable == &choice_vt && ((HChoice *)rule->parser->env)->len >= 2)
+            find_overlaps(c, rule);
+    }
+    h_delete_arena(tmp);
+    return c;
+}
+
+void h_complexity_free(HComplexity *complexity) {
+    HAllocator *mm__ = complexity->mm__;
+    h_delete_arena(complexity->arena);
+    h_free(complexity);
+}
+
+void h_complexity_begin(HComplexity *complexity) {
+    complexity->current = NULL;
+    complexity->furthest = 0;
+    complexity->stats.parses++;
+}
+
+void h_complexity_enter(HComplexity *complexity, const HParser *parser, HParseState *state,
+                        HComplexityFrame *frame) {
+    frame->parser = parser;
+    frame->outer = complexity->current;
+    frame->start = h_input_stream_pos(&state->input_stream);
+    frame->behind = complexity->furthest > frame->start ? complexity->furthest - frame->start : 0;
+    frame->depth = frame->outer ? frame->outer->depth + 1 : 1;
+    frame->hit = false;
+    if (frame->start > complexity->furthest)
+        complexity->furthest = frame->start;
+    if (frame->depth > complexity->stats.max_depth)
+        complexity->stats.max_depth = frame->depth;
+    complexity->current = frame;
+}
+
+void h_complexity_exit(HComplexity *complexity, HParseState *state, HComplexityFrame *frame,
+                       bool success) {
+    HComplexityStats *stats = &complexity->stats;
+
+    complexity->current = frame->outer;
+    if (success) {
+        size_t end = h_input_stream_pos(&state->input_stream);
+        if (end > complexity->furthest)
+            complexity->furthest = end;
+    }
+    if (frame->hit)
+        return;
+    stats->evaluations++;
+    if (!frame->behind)
+        return;
+
+    stats->reparses++;
+    const void *key = (const void *)(uintptr_t)(frame->start / 8 + 1);
+    uintptr_t n = (uintptr_t)h_hashtable_get(complexity->positions, key);
+    h_hashtable_put(complexity->positions, key, (void *)(n + 1));
+    // Callers that started behind too only pass the backtrack on; the first
+    // one out that did not is the rule that backtracked.
+    const HComplexityFrame *f = frame;
+    while (f->outer && f->outer->behind >= frame->behind)
+        f = f->outer;
+    size_t bytes = (frame->behind + 7) / 8;
+    if (bytes > stats->max_backtrack) {
+        stats->max_backtrack = bytes;
+        stats->max_backtrack_pos = frame->start / 8;
+        const HParser *in = f->outer ? f->outer->parser : f->parser;
+        complexity->max_backtrack_in = rule_for(complexity, in)->name;
+    }
+    if (f == frame && frame->outer) {
+        HComplexityRule *rule = rule_for(complexity, frame->outer->parser);
+        rule->backtracks++;
+        if (frame->behind > rule->max_behind)
+            rule->max_behind = frame->behind;
+    }
+}
+
+void h_complexity_memo(HComplexity *complexity, bool hit) { complexity->current->hit = hit; }
+
+void h_complexity_left_recursion(HComplexity *complexity, const HParser *parser) {
+    rule_for(complexity, parser)->lr_seeds++;
+}
+
+void h_complexity_grow(HComplexity *complexity, const HParser *parser) {
+    rule_for(complexity, parser)->grows++;
+    complexity->stats.lr_grows++;
+}
+
+void h_complexity_stats(const HComplexity *complexity, HComplexityStats *stats) {
+    *stats = complexity->stats;
+    stats->left_recursive = 0;
+    stats->overlapping_choices = 0;
+    for (size_t i = 0; i < complexity->order->used; i++) {
+        const HComplexityRule *rule = rule_at(complexity, i);
+        stats->left_recursive += rule->left_recursive || rule->lr_seeds;
+        stats->overlapping_choices += rule->overlaps > 0;
+    }
+}
+
+typedef struct {
+    size_t pos, calls;
+} HReparsed;
+
+static int cmp_reparsed(const void *a, const void *b) {
+    const HReparsed *x = a, *y = b;
+    if (x->calls != y->calls)
+        return (x->calls < y->calls) - (x->calls > y->calls);
+    return (x->pos > y->pos) - (x->pos < y->pos);
+}
+
+static int cmp_backtracks(const void *a, const void *b) {
+    size_t x = (*(HComplexityRule *const *)a)->backtracks;
+    size_t y = (*(HComplexityRule *const *)b)->backtracks;
+    return (x < y) - (x > y);
+}
+
+static void print_first(FILE *stream, size_t c) {
+    if (c == H_FIRST_END) {
+        fputs("the end of input", stream);
+    } else {
+        fputc('\'', stream);
+        h_pprint_char(stream, (uint8_t)c);
+        fputc('\'', stream);
+    }
+}
+
+void h_complexity_report(FILE *stream, const HComplexity *complexity) {
+    HAllocator *mm__ = complexity->mm__;
+    HComplexityStats stats;
+    size_t nrules = complexity->order->used, npos = complexity->positions->used;
+
+    h_complexity_stats(complexity, &stats);
+    fprintf(stream, "complexity of %s over %zu parses\n", complexity->name, stats.parses);
+    fprintf(stream, "  %-24s %zu\n", "calls evaluated", stats.evaluations);
+    fprintf(stream, "  %-24s %zu (%.1f%%)\n", "calls that re-parsed", stats.reparses,
+            stats.evaluations ? 100.0 * (double)stats.reparses / (double)stats.evaluations : 0);
+    fprintf(stream, "  %-24s %zu calls\n", "deepest nesting", stats.max_depth);
+    fprintf(stream, "  %-24s %zu bytes", "furthest backtrack", stats.max_backtrack);
+    if (complexity->max_backtrack_in)
+        fprintf(stream, ", to byte %zu, in %s", stats.max_backtrack_pos,
+                complexity->max_backtrack_in);
+    fputc('\n', stream);
+
+    fprintf(stream, "left-recursive rules\n  %-32s %10s %10s\n", "rule", "seeds", "grows");
+    for (size_t i = 0; i < nrules; i++) {
+        const HComplexityRule *rule = rule_at(complexity, i);
+        if (rule->left_recursive || rule->lr_seeds)
+            fprintf(stream, "  %-32s %10zu %10zu\n", rule->name, rule->lr_seeds, rule->grows);
+    }
+    fputs("choices whose alternatives overlap on their first byte\n", stream);
+    for (size_t i = 0; i < nrules; i++) {
+        const HComplexityRule *rule = rule_at(complexity, i);
+        if (!rule->overlaps)
+            continue;
+        fprintf(stream, "  %-32s alternatives %zu and %zu on ", rule->name, rule->overlap_a + 1,
+                rule->overlap_b + 1);
+        print_first(stream, rule->overlap_byte);
+        if (rule->overlaps > 1)
+            fprintf(stream, ", and %zu more bytes", rule->overlaps - 1);
+        fputc('\n', stream);
+    }
+
+    HReparsed *reparsed = h_new(HReparsed, npos ? npos : 1);
+    size_t n = 0;
+    for (size_t i = 0; i < complexity->positions->capacity; i++) {
+        for (HHashTableEntry *hte = &complexity->positions->contents[i]; hte; hte = hte->next) {
+            if (hte->key == NULL)
+                continue;
+            reparsed[n].pos = (uintptr_t)hte->key - 1;
+            reparsed[n++].calls = (uintptr_t)hte->value;
+        }
+    }
+    qsort(reparsed, n, sizeof(HReparsed), cmp_reparsed);
+    fprintf(stream, "most re-parsed positions\n  %-32s %10s\n", "byte", "calls");
+    for (size_t i = 0; i < n && i < TOP; i++)
+        fprintf(stream, "  %-32zu %10zu\n", reparsed[i].pos, reparsed[i].calls);
+    h_free(reparsed);
+
+    HComplexityRule **rules = h_new(HComplexityRule *, nrules ? nrules : 1);
+    memcpy(rules, complexity->order->elements, nrules * sizeof(HComplexityRule *));
+    qsort(rules, nrules, sizeof(HComplexityRule *), cmp_backtracks);
+    fprintf(stream, "rules that backtracked most\n  %-32s %10s %10s\n", "rule", "backtracks",
+            "max bytes");
+    for (size_t i = 0; i < nrules && i < TOP && rules[i]->backtracks; i++)
+        fprintf(stream, "  %-32s %10zu %10zu\n", rules[i]->name, rules[i]->backtracks,
+                (rules[i]->max_behind + 7) / 8);
+
+    // What backtracking was seen to cost first; then what the grammar alone
+    // says.
+    fputs("suggestions\n", stream);
+    for (size_t i = 0; i < nrules && i < TOP && rules[i]->backtracks; i++) {
+        const HComplexityRule *rule = rules[i];
+        if (rule->overlaps) {
+            fprintf(stream,
+                    "  %s: make it a dispatch table; it backtracked, and alternatives %zu and %zu "
+                    "both start with ",
+                    rule->name, rule->overlap_a + 1, rule->overlap_b + 1);
+            print_first(stream, rule->overlap_byte);
+            fputs("; left-factor their common prefix, so that the next byte picks one\n",
+                  stream);
+        } else {
+            fprintf(stream,
+                    "  %s: add a cut point; it backtracked up to %zu bytes after part of it had "
+                    "matched; parse that part once, ahead of what can fail after it\n",
+                    rule->name, (rule->max_behind + 7) / 8);
+        }
+    }
+    for (size_t i = 0; i < nrules; i++) {
+        const HComplexityRule *rule = rules[i];
+        if (rule->overlaps && !rule->backtracks)
+            fprintf(stream,
+                    "  %s: make it a dispatch table, by left-factoring alternatives %zu and %zu\n",
+                    rule->name, rule->overlap_a + 1, rule->overlap_b + 1);
+        if (rule->left_recursive || rule->lr_seeds)
+            fprintf(stream,
+                    "  %s: left-recursive, grown %zu times; h_many or h_sepBy, folded by an "
+                    "action, parse the same without setupLR and grow()\n",
+                    rule->name, rule->grows);
+    }
+    h_free(rules);
+}
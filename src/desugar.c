@@ -10,7 +10,9 @@ HCFChoice *h_desugar(HAllocator *mm__, HCFStack *stk__, const HParser *parser) {
         if (nstk__->prealloc == NULL) {
             nstk__->prealloc = h_new(HCFChoice, 1);
         }
-        // we're going to do something naughty and cast away the const to memoize
+        // we're going to do something naughty and cast away the const to memoize.
+        // h_compile does this for the whole grammar up front, so compiled parsers
+        // that are shared between threads are not written to here.
         assert(parser->vtable->desugar != NULL);
         ((HParser *)parser)->desugared = nstk__->prealloc;
         parser->vtable->desugar(mm__, nstk__, parser->env);
@@ -32,7 +32,8 @@
  * Grammar specification
  *
  * H_RULE is simply a short-hand for the typical declaration and definition of
- * a parser variable. See its plain definition below. The goal is to save
+ * a parser variable, which it names after the rule with h_name() so that
+ * profiles can tell the rules apart. See its definition below. The goal is to save
  * horizontal space as well as to provide a clear and unified look together with
  * the other macro variants that stays close to an abstract PEG or BNF grammar.
  * The latter goal is more specifically enabled by H_ARULE, H_VRULE, and their
@@ -59,19 +60,24 @@
  * action are used, the same userdata pointer is given to both.
  */
 
-#define H_RULE(rule, def) HParser *rule = def
-#define H_ARULE(rule, def) HParser *rule = h_action(def, act_##rule, NULL)
-#define H_VRULE(rule, def) HParser *rule = h_attr_bool(def, validate_##rule, NULL)
+#define H_RULE(rule, def) HParser *rule = h_name(def, #rule)
+#define H_ARULE(rule, def) HParser *rule = h_name(h_action(def, act_##rule, NULL), #rule)
+#define H_VRULE(rule, def) HParser *rule = h_name(h_attr_bool(def, validate_##rule, NULL), #rule)
 #define H_VARULE(rule, def)                                                                        \
-    HParser *rule = h_attr_bool(h_action(def, act_##rule, NULL), validate_##rule, NULL)
+    HParser *rule =                                                                                \
+        h_name(h_attr_bool(h_action(def, act_##rule, NULL), validate_##rule, NULL), #rule)
 #define H_AVRULE(rule, def)                                                                        \
-    HParser *rule = h_action(h_attr_bool(def, validate_##rule, NULL), act_##rule, NULL)
-#define H_ADRULE(rule, def, data) HParser *rule = h_action(def, act_##rule, data)
-#define H_VDRULE(rule, def, data) HParser *rule = h_attr_bool(def, validate_##rule, data)
+    HParser *rule =                                                                                \
+        h_name(h_action(h_attr_bool(def, validate_##rule, NULL), act_##rule, NULL), #rule)
+#define H_ADRULE(rule, def, data) HParser *rule = h_name(h_action(def, act_##rule, data), #rule)
+#define H_VDRULE(rule, def, data)                                                                  \
+    HParser *rule = h_name(h_attr_bool(def, validate_##rule, data), #rule)
 #define H_VADRULE(rule, def, data)                                                                 \
-    HParser *rule = h_attr_bool(h_action(def, act_##rule, data), validate_##rule, data)
+    HParser *rule =                                                                                \
+        h_name(h_attr_bool(h_action(def, act_##rule, data), validate_##rule, data), #rule)
 #define H_AVDRULE(rule, def, data)                                                                 \
-    HParser *rule = h_action(h_attr_bool(def, validate_##rule, data), act_##rule, data)
+    HParser *rule =                                                                                \
+        h_name(h_action(h_attr_bool(def, validate_##rule, data), act_##rule, data), #rule)
 
 /**
  * Pre-fab semantic actions
@@ -25,6 +25,7 @@
 #include <assert.h>
 #include <ctype.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <string.h>
 
@@ -58,6 +59,13 @@ HParserBackendVTable *h_get_default_backend_vtable(void) {
     return h_get_default_backend_vtable__int();
 }
 
+HParserBackendVTable *h_get_backend_vtable(HParserBackend backend) {
+    if (backend >= PB_MIN && backend <= PB_MAX)
+        return backends[backend];
+    else
+        return NULL;
+}
+
 /*
  * Copy an HParserBackendWithParams, using the backend-supplied copy
  * method.
@@ -477,6 +485,13 @@ static HParser *build_hparser(void) {
     }
 }
 
+// The grammar never changes, so it is built and compiled once, on first use,
+// and then shared: a compiled parser is only read.
+static HParser *backend_spec_parser;
+static pthread_once_t backend_spec_once = PTHREAD_ONCE_INIT;
+
+static void build_backend_spec_parser(void) { backend_spec_parser = build_hparser(); }
+
 HParserBackendWithParams *h_get_backend_with_params_by_name(const char *name_with_params) {
     HAllocator *mm__ = &system_allocator;
     HParserBackendWithParams *result = NULL;
@@ -485,16 +500,17 @@ HParserBackendWithParams *h_get_backend_with_params_by_name(const char *name_wit
     HParseResult *r = NULL;
 
     if (name_with_params != NULL) {
+        pthread_once(&backend_spec_once, build_backend_spec_parser);
+        parser = backend_spec_parser;
+        if (!parser) {
+            return NULL;
+        }
+
         result = h_new(HParserBackendWithParams, 1);
         if (result) {
             result->mm__ = mm__;
             result->requested_name = NULL;
 
-            parser = build_hparser();
-            if (!parser) {
-                return NULL;
-            }
-
             r = h_parse(parser, (const uint8_t *)name_with_params, strlen(name_with_params));
 
             if (r) {
@@ -526,10 +542,6 @@ HParserBackendWithParams *h_get_backend_with_params_by_name(const char *name_wit
                 // free the parse result
                 h_parse_result_free(r);
                 r = NULL;
-
-                // free the memory used by the backend for parser data
-                //(TODO: code to completely free the memory used for this parser)
-                parser->backend_vtable->free(parser);
             }
         }
     }
@@ -555,6 +567,178 @@ HParseResult *h_parse__m(HAllocator *mm__, const HParser *parser, const uint8_t
     return parser->backend_vtable->parse(mm__, parser, &input_stream);
 }
 
+HParseResult *h_parse_with_options(const HParser *parser, const uint8_t *input, size_t length,
+                                   const HParseOptions *options) {
+    return h_parse_with_options__m(&system_allocator, parser, input, length, options);
+}
+HParseResult *h_parse_with_options__m(HAllocator *mm__, const HParser *parser,
+                                      const uint8_t *input, size_t length,
+                                      const HParseOptions *options) {
+    HInputStream input_stream = {.pos = 0,
+                                 .index = 0,
+                                 .bit_offset = 0,
+                                 .overrun = 0,
+                                 .endianness = DEFAULT_ENDIANNESS,
+                                 .length = length,
+                                 .input = input,
+                                 .last_chunk = true};
+
+    if (!parser->backend_vtable->parse_with_options)
+        return parser->backend_vtable->parse(mm__, parser, &input_stream);
+    return parser->backend_vtable->parse_with_options(mm__, parser, &input_stream, options);
+}
+
+const char *h_budget_reason_name(HBudgetReason reason) {
+    switch (reason) {
+    case H_BUDGET_OK:
+        return "none";
+    case H_BUDGET_STEPS:
+        return "steps";
+    case H_BUDGET_MEMO_ENTRIES:
+        return "memo entries";
+    case H_BUDGET_ARENA_BYTES:
+        return "arena bytes";
+    case H_BUDGET_DEADLINE:
+        return "deadline";
+    default:
+        return "unknown";
+    }
+}
+
+HParseResult *h_parse_segments(const HParser *parser, const HInputSegment *segments,
+                               size_t count) {
+    return h_parse_segments__m(&system_allocator, parser, segments, count);
+}
+HParseResult *h_parse_segments__m(HAllocator *mm__, const HParser *parser,
+                                  const HInputSegment *segments, size_t count) {
+    HInputSegments segs = {.segs = segments, .count = count, .length = 0};
+    for (size_t i = 0; i < count; i++)
+        segs.length += segments[i].length;
+
+    HInputStream input_stream = {.pos = 0,
+                                 .index = 0,
+                                 .bit_offset = 0,
+                                 .overrun = 0,
+                                 .endianness = DEFAULT_ENDIANNESS,
+                                 .last_chunk = true};
+    h_input_stream_init_segments(&input_stream, &segs);
+
+    return parser->backend_vtable->parse(mm__, parser, &input_stream);
+}
+
+size_t h_parse_batch(const HParser *parser, const uint8_t *const inputs[], const size_t lengths[],
+                     size_t n, HParseResult *results[]) {
+    return h_parse_batch__m(&system_allocator, parser, inputs, lengths, n, results);
+}
+size_t h_parse_batch__m(HAllocator *mm__, const HParser *parser, const uint8_t *const inputs[],
+                        const size_t lengths[], size_t n, HParseResult *results[]) {
+    HArena *arena = NULL;
+    size_t nok = 0;
+
+    if (parser->backend_vtable->parse_batch)
+        return parser->backend_vtable->parse_batch(mm__, parser, inputs, lengths, n, results);
+
+    // no batch support in the backend: parse one by one, then gather the
+    // results' arenas under a single one so the batch is freed the same way.
+    for (size_t i = 0; i < n; i++) {
+        results[i] = h_parse__m(mm__, parser, inputs[i], lengths[i]);
+        if (!results[i])
+            continue;
+        if (!arena)
+            arena = h_new_arena(mm__, 0);
+        h_arena_adopt(arena, results[i]->arena);
+        results[i]->arena = arena;
+        nok++;
+    }
+    return nok;
+}
+
+// Parallel batches are split into blocks that are parsed with
+// h_parse_batch__m; blocks are the unit of work stealing, and each one gets
+// its own arenas and parse state.
+typedef struct {
+    HAllocator *mm__;
+    const HParser *parser;
+    const uint8_t *const *inputs;
+    const size_t *lengths;
+    HParseResult **results;
+    size_t n;
+    size_t block;
+    size_t *nok; // successes per block
+} HParallelBatch;
+
+static void parse_batch_block(void *ctx, size_t worker, size_t blk) {
+    HParallelBatch *job = ctx;
+    size_t first = blk * job->block;
+    size_t count = job->n - first < job->block ? job->n - first : job->block;
+
+    job->nok[blk] = h_parse_batch__m(job->mm__, job->parser, job->inputs + first,
+                                     job->lengths + first, count, job->results + first);
+}
+
+size_t h_parse_batch_parallel(HThreadPool *pool, const HParser *parser,
+                              const uint8_t *const inputs[], const size_t lengths[], size_t n,
+                              HParseResult *results[]) {
+    return h_parse_batch_parallel__m(&system_allocator, pool, parser, inputs, lengths, n, results);
+}
+size_t h_parse_batch_parallel__m(HAllocator *mm__, HThreadPool *pool, const HParser *parser,
+                                 const uint8_t *const inputs[], const size_t lengths[], size_t n,
+                                 HParseResult *results[]) {
+    HParallelBatch job = {mm__, parser, inputs, lengths, results, n, 0, NULL};
+    HArena *arena = NULL;
+    size_t nblocks, nok = 0;
+
+    if (n == 0)
+        return 0;
+
+    // several blocks per thread, so there is something left to steal
+    job.block = n / (h_thread_pool_size(pool) * 8);
+    if (job.block < 1)
+        job.block = 1;
+    if (job.block > 1024)
+        job.block = 1024;
+    nblocks = (n + job.block - 1) / job.block;
+    job.nok = h_new(size_t, nblocks);
+
+    if (!h_thread_pool_run(pool, nblocks, parse_batch_block, &job)) {
+        h_free(job.nok);
+        return h_parse_batch__m(mm__, parser, inputs, lengths, n, results);
+    }
+
+    // gather the blocks' arenas under one, as for a sequential batch
+    for (size_t blk = 0; blk < nblocks; blk++) {
+        size_t first = blk * job.block;
+        size_t end = first + job.block < n ? first + job.block : n;
+        HArena *block_arena = NULL;
+
+        if (job.nok[blk] == 0)
+            continue;
+        nok += job.nok[blk];
+        if (!arena)
+            arena = h_new_arena(mm__, 0);
+        for (size_t i = first; i < end; i++) {
+            if (!results[i])
+                continue;
+            if (!block_arena) {
+                block_arena = results[i]->arena;
+                h_arena_adopt(arena, block_arena);
+            }
+            results[i]->arena = arena;
+        }
+    }
+    h_free(job.nok);
+    return nok;
+}
+
+void h_parse_batch_free(HParseResult *results[], size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (results[i]) {
+            h_delete_arena(results[i]->arena);
+            break;
+        }
+    }
+}
+
 void h_parse_result_free__m(HAllocator *alloc, HParseResult *result) {
     h_parse_result_free(result);
 }
@@ -565,6 +749,11 @@ void h_parse_result_free(HParseResult *result) {
     h_delete_arena(result->arena);
 }
 
+HParser *h_name(HParser *parser, const char *name) {
+    h_parser_private(parser)->name = name;
+    return parser;
+}
+
 bool h_false(void *env) {
     (void)env;
     return false;
@@ -615,6 +804,10 @@ int h_compile__m(HAllocator *mm__, HParser *parser, HParserBackend backend, cons
     if (!ret) {
         parser->backend = backend;
         parser->backend_vtable = backends[backend];
+        // memoize the CFG forms now rather than lazily, so that the compiled
+        // parser is only read afterwards and can be shared between threads.
+        if (parser->vtable->isValidCF(parser->env))
+            h_desugar(mm__, NULL, parser);
     }
     return ret;
 }
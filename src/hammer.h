@@ -27,6 +27,7 @@
 #include "allocator.h"
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 
@@ -167,6 +168,39 @@ typedef struct HParseResult_ {
     HArena *arena; /**< Memory arena for the parse result */
 } HParseResult;
 
+/**
+ * @struct HInputSegment
+ * @brief One contiguous piece of a segmented (scatter-gather) input, as passed to
+ * h_parse_segments(). The segments are parsed as if they were concatenated.
+ */
+typedef struct HInputSegment_ {
+    const uint8_t *data;
+    size_t length;
+} HInputSegment;
+
+/**
+ * @struct HStructField
+ * @brief One field of a fixed layout decoded by h_struct(): an integer of 'bits' bits found
+ * 'offset' bits into the layout, stored into the 'size'-byte integer member 'dest' bytes into the
+ * struct.
+ *
+ * The endianness is that of h_with_endianness(), and does not depend on the stream's.
+ */
+typedef struct HStructField_ {
+    size_t offset;   /**< Bit offset of the field from the start of the layout */
+    size_t bits;     /**< Width of the field, 1 to 64 */
+    bool sign;       /**< Sign-extend the field */
+    char endianness; /**< BYTE_*_ENDIAN | BIT_*_ENDIAN */
+    size_t dest;     /**< offsetof() the member */
+    size_t size;     /**< sizeof() the member: 1, 2, 4 or 8 */
+} HStructField;
+
+/**
+ * @brief An unsigned, big-endian HStructField for member m of struct type T.
+ */
+#define H_STRUCT_FIELD(T, m, offset, bits)                                                         \
+    {(offset), (bits), false, BYTE_BIG_ENDIAN | BIT_BIG_ENDIAN, offsetof(T, m), sizeof(((T *)0)->m)}
+
 /**
  * TODO: document me.
  * Relevant functions: h_bit_writer_new, h_bit_writer_put, h_bit_writer_get_buffer,
@@ -190,6 +224,130 @@ typedef struct HParser_ {
 
 typedef struct HSuspendedParser_ HSuspendedParser;
 
+typedef struct HProfile_ HProfile;
+typedef struct HTrace_ HTrace;
+typedef struct HComplexity_ HComplexity;
+
+/**
+ * @brief Why a parse ran over its HParseBudget.
+ */
+typedef enum HBudgetReason_ {
+    H_BUDGET_OK, /**< it did not */
+    H_BUDGET_STEPS,
+    H_BUDGET_MEMO_ENTRIES,
+    H_BUDGET_ARENA_BYTES,
+    H_BUDGET_DEADLINE,
+} HBudgetReason;
+
+/**
+ * @struct HParseBudget
+ * @brief Limits on one parse, for h_parse_with_options(). A parse that goes over any of them is
+ * abandoned, as if it had run out of memory, and fails; 'exceeded' says why. A limit of 0 is no
+ * limit.
+ *
+ * Steps are parser calls, the cache's answers included, so a left-recursive rule's grow() loop
+ * counts too. The literals that h_compile() fuses, in a choice or a sequence, are otherwise matched
+ * all at once; under a budget or any other option they are called one by one, so each is a step.
+ * Steps and memo entries are checked on every call; arena bytes and the deadline only every
+ * H_BUDGET_INTERVAL steps, so a parse can go over those by what that many calls take.
+ */
+typedef struct HParseBudget_ {
+    uint64_t max_steps;
+    size_t max_memo_entries; /**< entries in the packrat cache */
+    size_t max_arena_bytes;  /**< bytes allocated in the parse's arena, the result included */
+    uint64_t deadline_ns;    /**< wall-clock time from the start of the parse */
+    HBudgetReason exceeded;  /**< set by the parse */
+    uint64_t steps;          /**< set by the parse: the steps it took, up to where it stopped */
+} HParseBudget;
+
+#define H_BUDGET_INTERVAL 64
+
+/**
+ * @struct HParseStats
+ * @brief The shape of one parse's memo table and arena, for sizing them. Filled in by
+ * h_parse_with_options() when the parse finishes, whether it succeeds or fails.
+ *
+ * Chains are the entries that share a bucket of the memo table; a lookup walks one chain.
+ */
+typedef struct HParseStats_ {
+    size_t memo_lookups;       /**< cache lookups, each hashing one key */
+    size_t memo_hits;          /**< lookups answered from the cache */
+    size_t memo_hash_bytes;    /**< bytes of keys hashed by the lookups */
+    size_t memo_entries;       /**< entries in the table at the end of the parse */
+    size_t memo_capacity;      /**< buckets in the table */
+    double memo_load;          /**< entries per bucket */
+    size_t memo_chain_max;     /**< the longest chain */
+    double memo_chain_mean;    /**< entries per bucket that has any */
+    HArenaDetailedStats arena; /**< the parse's arena, holding the result and the memo table */
+} HParseStats;
+
+/**
+ * @struct HParseOptions
+ * @brief Instrumentation for h_parse_with_options(). Leave a field NULL to turn it off.
+ */
+typedef struct HParseOptions_ {
+    HProfile *profile;       /**< collect per-parser counters, see h_profile_new() */
+    HTrace *trace;           /**< record every parser call, see h_trace_new() */
+    HParseStats *stats;      /**< filled in with the memo table's and arena's statistics */
+    HComplexity *complexity; /**< find backtracking and left recursion, see h_complexity_new() */
+    HParseBudget *budget;    /**< abandon the parse once it takes more than this */
+} HParseOptions;
+
+/**
+ * @struct HProfileEntry
+ * @brief What an HProfile collected for one parser, over all the parses it was used with.
+ *
+ * Inclusive time counts the outermost call of a recursive parser only, so it is never more than
+ * the time of the whole parse. Exclusive time leaves out the time spent in the children.
+ */
+typedef struct HProfileEntry_ {
+    const HParser *parser;
+    const char *name; /**< the parser's name, or its kind and address if it has none */
+    uint64_t calls;
+    uint64_t successes;
+    uint64_t failures;
+    uint64_t memo_hits;             /**< calls answered from the packrat cache */
+    uint64_t memo_misses;           /**< calls that had to parse and filled the cache */
+    uint64_t inclusive_ns;          /**< wall-clock time, with the children */
+    uint64_t exclusive_ns;          /**< wall-clock time, without the children */
+    uint64_t bytes_consumed;        /**< input consumed by the successful calls */
+    uint64_t arena_bytes;           /**< bytes the parse arenas grew by during the calls */
+    uint64_t arena_exclusive_bytes; /**< arena_bytes, without what the children took */
+} HProfileEntry;
+
+/**
+ * @brief Orders for h_profile_sort() and h_profile_report(), most expensive first.
+ */
+typedef enum HProfileSort_ {
+    H_PROFILE_BY_EXCLUSIVE,
+    H_PROFILE_BY_INCLUSIVE,
+    H_PROFILE_BY_CALLS,
+    H_PROFILE_BY_ARENA,
+    H_PROFILE_BY_ARENA_EXCLUSIVE,
+} HProfileSort;
+
+/**
+ * @struct HComplexityStats
+ * @brief What an HComplexity found in its grammar, and over all the parses it was used with.
+ *
+ * A call re-parses if it starts behind the furthest point its parse had reached: something
+ * matched up to there and then failed, and a caller backtracked. Calls answered from the packrat
+ * cache cost next to nothing and are not counted. Distances and positions are in bytes.
+ */
+typedef struct HComplexityStats_ {
+    size_t parses;
+    size_t evaluations;         /**< parser calls not answered from the packrat cache */
+    size_t reparses;            /**< of those, the calls that re-parsed */
+    size_t max_depth;           /**< the deepest nesting of parser calls */
+    size_t max_backtrack;       /**< the furthest a call started behind the furthest point */
+    size_t max_backtrack_pos;   /**< where that call started */
+    size_t left_recursive;      /**< rules found left-recursive, in the grammar or by setupLR */
+    size_t lr_grows;            /**< iterations of grow(), which extends a left-recursive match */
+    size_t overlapping_choices; /**< choices with two alternatives that start with the same byte */
+} HComplexityStats;
+
+typedef struct HThreadPool_ HThreadPool;
+
 /**
  * @typedef HAction
  * @brief Type of an action to apply to an AST, used in the action() parser. It can be any
@@ -283,6 +441,60 @@ typedef union {
 } HResultTiming;
 #endif
 
+/**
+ * @brief What one parse cost the CPU, when HBenchmarkOptions.counters is set. A count is
+ * negative where it could not be read: the hardware events need Linux perf_event and a kernel
+ * that lets the user count them. The software events are always available.
+ */
+typedef struct HBenchmarkCounters_ {
+    bool hardware;           /**< whether any hardware event could be counted */
+    double instructions;     /**< instructions retired, per parse */
+    double cycles;           /**< CPU cycles, per parse */
+    double branches;         /**< branch instructions, per parse */
+    double branch_misses;    /**< mispredicted branches, per parse */
+    double l1d_misses;       /**< L1 data cache read misses, per parse */
+    double llc_misses;       /**< last level cache misses, per parse */
+    double task_clock_ns;    /**< CPU time, in nsec per parse */
+    double page_faults;      /**< page faults, per parse */
+    double context_switches; /**< context switches, per parse */
+    double ipc;              /**< instructions per cycle */
+    double branch_miss_rate; /**< mispredicted branches per branch */
+} HBenchmarkCounters;
+
+/** @brief How many of the parsers that allocate the most h_benchmark() reports. */
+#define H_BENCHMARK_TOP_ALLOCATORS 3
+
+/**
+ * @brief A parser and the arena bytes it took itself, leaving out its children, in one parse.
+ */
+typedef struct HBenchmarkAllocSite_ {
+    const char *parser; /**< as named in an HProfileEntry; NULL for an unused slot */
+    uint64_t arena_bytes;
+} HBenchmarkAllocSite;
+
+/**
+ * @brief The distribution of parse times for one test case. Each sample times a batch of parses
+ * and records the mean time per parse in that batch.
+ */
+typedef struct HBenchmarkStats_ {
+    size_t samples;              /**< number of samples taken */
+    size_t iterations;           /**< parses per sample */
+    double min_ns;               /**< fastest sample, in nsec per parse */
+    double median_ns;            /**< median sample, in nsec per parse */
+    double p99_ns;               /**< 99th percentile sample (nearest rank), in nsec per parse */
+    double mean_ns;              /**< mean of the samples, in nsec per parse */
+    double stddev_ns;            /**< sample standard deviation, in nsec */
+    double mb_per_s;             /**< input throughput at the median, in 10^6 bytes per second */
+    size_t bytes_allocated;      /**< bytes requested from the allocator by one parse */
+    size_t allocations;          /**< calls to the allocator by one parse */
+    size_t peak_bytes;           /**< most bytes held from the allocator at once by one parse */
+    /** one parse's allocations, counted by size class as an HAllocTracker counts them */
+    size_t size_classes[H_ALLOC_SIZE_CLASSES];
+    /** the parsers that took the most arena bytes in one parse, the most first */
+    HBenchmarkAllocSite top_allocators[H_BENCHMARK_TOP_ALLOCATORS];
+    HBenchmarkCounters counters; /**< performance counters over the samples, if asked for */
+} HBenchmarkStats;
+
 typedef struct HCaseResult_ {
     bool success;
 #ifndef SWIG
@@ -310,6 +522,16 @@ typedef struct HBenchmarkResults_ {
     HBackendResults *results;
 } HBenchmarkResults;
 
+/**
+ * @brief How h_benchmark_with_options() measures each test case. A zero field takes its default.
+ */
+typedef struct HBenchmarkOptions_ {
+    int64_t warmup_ns; /**< parse for at least this long before sampling (default 10 ms) */
+    int64_t sample_ns; /**< minimum duration of one sample (default 3 ms) */
+    size_t samples;    /**< samples per test case (default 30) */
+    bool counters;     /**< read the CPU's performance counters while sampling (default off) */
+} HBenchmarkOptions;
+
 /** @} */
 
 /**
@@ -419,6 +641,113 @@ HParseResult *h_parse(const HParser *parser, const uint8_t *input, size_t length
 HParseResult *h_parse__m(HAllocator *mm__, const HParser *parser, const uint8_t *input,
                          size_t length);
 
+/**
+ * @brief Like h_parse(), with the instrumentation that options asks for. With options NULL or all
+ * its fields NULL, the parse runs exactly as with h_parse(). Backends that do not support the
+ * instrumentation parse without it.
+ *
+ * @param parser Parser to use
+ * @param input Input data
+ * @param length Length of input data
+ * @param options Instrumentation to enable, or NULL
+ * @return Parse result, or NULL on failure
+ */
+HParseResult *h_parse_with_options(const HParser *parser, const uint8_t *input, size_t length,
+                                   const HParseOptions *options);
+HParseResult *h_parse_with_options__m(HAllocator *mm__, const HParser *parser,
+                                      const uint8_t *input, size_t length,
+                                      const HParseOptions *options);
+
+/**
+ * @brief Name of the limit a parse ran over, as "steps" or "deadline", for logs.
+ */
+const char *h_budget_reason_name(HBudgetReason reason);
+
+/**
+ * @brief Parse input that is split over several non-contiguous buffers (e.g. a received iovec
+ * list) without first concatenating them. The result is the same as calling h_parse() on the
+ * concatenation of all segments. Empty segments are allowed.
+ *
+ * @param parser Parser to use
+ * @param segments Array of input segments, in order
+ * @param count Number of segments
+ * @return Parse result, or NULL on failure
+ */
+HParseResult *h_parse_segments(const HParser *parser, const HInputSegment *segments, size_t count);
+HParseResult *h_parse_segments__m(HAllocator *mm__, const HParser *parser,
+                                  const HInputSegment *segments, size_t count);
+
+/**
+ * @brief Parse many small, independent inputs with one parser. Setup is amortized over the batch:
+ * the parse state is reused between items and all results are allocated from a single arena.
+ *
+ * @param parser Parser to use
+ * @param inputs Array of n input buffers
+ * @param lengths Array of the n input lengths
+ * @param n Number of inputs
+ * @param results Array of n parse results, filled in input order; NULL where a parse failed
+ * @return Number of successful parses
+ *
+ * All results of a batch share one arena. Release them together with h_parse_batch_free(); do
+ * not call h_parse_result_free() on them individually.
+ */
+size_t h_parse_batch(const HParser *parser, const uint8_t *const inputs[], const size_t lengths[],
+                     size_t n, HParseResult *results[]);
+size_t h_parse_batch__m(HAllocator *mm__, const HParser *parser, const uint8_t *const inputs[],
+                        const size_t lengths[], size_t n, HParseResult *results[]);
+
+/**
+ * @brief Free the results of h_parse_batch().
+ *
+ * @param results Array of results as filled in by h_parse_batch()
+ * @param n Number of results
+ */
+void h_parse_batch_free(HParseResult *results[], size_t n);
+
+/**
+ * @brief Create a pool of worker threads for h_parse_batch_parallel(). Idle workers steal work
+ * from busy ones, so uneven input sizes still keep all threads busy.
+ *
+ * @param nthreads Number of threads, including the one calling into the pool; 0 for one per
+ * online CPU
+ * @return The thread pool
+ */
+HThreadPool *h_thread_pool_new(size_t nthreads);
+HThreadPool *h_thread_pool_new__m(HAllocator *mm__, size_t nthreads);
+
+/**
+ * @brief Number of threads in a pool, including the calling thread.
+ */
+size_t h_thread_pool_size(const HThreadPool *pool);
+
+/**
+ * @brief Stop the pool's threads and free it.
+ */
+void h_thread_pool_free(HThreadPool *pool);
+
+/**
+ * @brief Like h_parse_batch(), but parse the inputs in parallel on the threads of a pool. Each
+ * worker uses arenas and parse state of its own; the results come back in input order and are
+ * freed with h_parse_batch_free().
+ *
+ * The parser must have been compiled with h_compile() and is only read during the parse. Actions,
+ * predicates and the allocator are called from several threads at once and must be thread-safe.
+ *
+ * @param pool Thread pool to run on
+ * @param parser Parser to use
+ * @param inputs Array of n input buffers
+ * @param lengths Array of the n input lengths
+ * @param n Number of inputs
+ * @param results Array of n parse results, filled in input order; NULL where a parse failed
+ * @return Number of successful parses
+ */
+size_t h_parse_batch_parallel(HThreadPool *pool, const HParser *parser,
+                              const uint8_t *const inputs[], const size_t lengths[], size_t n,
+                              HParseResult *results[]);
+size_t h_parse_batch_parallel__m(HAllocator *mm__, HThreadPool *pool, const HParser *parser,
+                                 const uint8_t *const inputs[], const size_t lengths[], size_t n,
+                                 HParseResult *results[]);
+
 /**
  * @brief Initialize a parser for iteratively consuming an input stream in chunks. This is only
  * supported by some backends.
@@ -527,6 +856,27 @@ HParser *h_bits__m(HAllocator *mm__, size_t len, _Bool sign);
 HParser *h_bytes(size_t len);
 HParser *h_bytes__m(HAllocator *mm__, size_t len);
 
+/**
+ * @brief Returns a parser that decodes a fixed layout of 'bits' bits straight into a struct of
+ * 'size' bytes, without building a token for every field.
+ *
+ * Members not named in fields are zero. Fields may be given in any order and may overlap; the
+ * input does not have to be aligned to a byte boundary. Returns NULL if a field does not fit the
+ * layout, or its member the struct.
+ *
+ * @param type Token type of the result, TT_USER or one registered with h_allocate_token_type()
+ * @param size Size of the struct
+ * @param bits Width of the layout
+ * @param fields Fields to decode; copied
+ * @param nfields Number of fields
+ * @return Result token type: type, whose user field points to the struct
+ * @note Consumes 'bits' bits from the input stream
+ */
+HParser *h_struct(HTokenType type, size_t size, size_t bits, const HStructField *fields,
+                  size_t nfields);
+HParser *h_struct__m(HAllocator *mm__, HTokenType type, size_t size, size_t bits,
+                     const HStructField *fields, size_t nfields);
+
 /** @} */
 
 /**
@@ -888,6 +1238,26 @@ HParser *h_epsilon_p__m(HAllocator *mm__);
 HParser *h_length_value(const HParser *length, const HParser *value);
 HParser *h_length_value__m(HAllocator *mm__, const HParser *length, const HParser *value);
 
+/**
+ * @brief Like h_many(p), but parses the repetitions of p on the threads of pool when p is an
+ * h_length_value() whose value parser has a fixed width (e.g. h_uint8()).
+ *
+ * The record boundaries are found with a sequential pass over the length fields only; the records
+ * are then parsed concurrently and their results joined in input order. If p is some other
+ * parser, during chunked (h_parse_chunk) parsing, or if the pool is already busy (e.g. because
+ * this parser runs inside h_parse_batch_parallel() on the same pool), this behaves exactly like
+ * h_many(p).
+ *
+ * Actions and predicates under p must be safe to call from several threads at once, and cannot
+ * see values stored with h_put_value().
+ *
+ * @param pool Thread pool to parse on
+ * @param p Record parser to repeat
+ * @return Result token type: TT_SEQUENCE
+ */
+HParser *h_many_parallel(HThreadPool *pool, const HParser *p);
+HParser *h_many_parallel__m(HAllocator *mm__, HThreadPool *pool, const HParser *p);
+
 /**
  * @brief This parser attaches a predicate function, which returns true or false, to a parser. The
  * function is evaluated over the parser's result.
@@ -1099,6 +1469,102 @@ void h_pprint(FILE *stream, const HParsedToken *tok, int indent, int delta);
  */
 void h_pprintln(FILE *stream, const HParsedToken *tok);
 
+/**
+ * @brief Give a parser a name, for profiles. The H_RULE macros name their parsers after the rule.
+ * A parser has one name; naming it again replaces the old one.
+ *
+ * @param parser Parser to name
+ * @param name Name, which must live as long as the parser does
+ * @return parser
+ */
+HParser *h_name(HParser *parser, const char *name);
+
+/**
+ * @brief Create an empty profile, to be passed to h_parse_with_options() in HParseOptions. A
+ * profile adds up the counters of every parse it is used with. It must not be used by two parses
+ * at once.
+ */
+HProfile *h_profile_new(void);
+HProfile *h_profile_new__m(HAllocator *mm__);
+
+void h_profile_free(HProfile *profile);
+
+/**
+ * @brief Number of parsers in the profile: those that were called at least once.
+ */
+size_t h_profile_count(const HProfile *profile);
+
+/**
+ * @brief The i'th entry of the profile, in the order of the last h_profile_sort(), or of first
+ * call if it was never sorted.
+ */
+const HProfileEntry *h_profile_entry(const HProfile *profile, size_t i);
+
+/**
+ * @brief Sort the entries of a profile, most expensive first.
+ */
+void h_profile_sort(HProfile *profile, HProfileSort by);
+
+/**
+ * @brief Sort the profile and print it as a table, one row per parser.
+ */
+void h_profile_report(FILE *stream, HProfile *profile, HProfileSort by);
+
+/**
+ * @brief Create a trace, to be passed to h_parse_with_options() in HParseOptions. It records
+ * when every parser call starts, and where, and how it ends. It keeps the last 'capacity' events
+ * (rounded up to a power of two) in a ring, so a trace never grows during a parse. A trace
+ * belongs to one thread; give each thread its own.
+ */
+HTrace *h_trace_new(size_t capacity);
+HTrace *h_trace_new__m(HAllocator *mm__, size_t capacity);
+
+void h_trace_free(HTrace *trace);
+
+/**
+ * @brief Forget all events recorded so far.
+ */
+void h_trace_clear(HTrace *trace);
+
+/**
+ * @brief Number of events that did not fit into the ring and were overwritten.
+ */
+size_t h_trace_dropped(const HTrace *trace);
+
+/**
+ * @brief Write traces in the Chrome trace event format, for chrome://tracing or Perfetto. Each
+ * parser call becomes a complete event with its input range; failed calls, after which the caller
+ * backtracks, are in the category "backtrack". Each trace gets a thread of its own.
+ */
+void h_trace_write_chrome(FILE *stream, HTrace *const traces[], size_t n);
+
+/**
+ * @brief Write traces as folded stacks for flamegraph.pl: one line per call stack, with the time
+ * spent in its innermost parser in nsec.
+ */
+void h_trace_write_folded(FILE *stream, HTrace *const traces[], size_t n);
+
+/**
+ * @brief Analyze a grammar for patterns that make packrat parsing slow, to be passed to
+ * h_parse_with_options() in HParseOptions to watch it backtrack. Creating it finds the
+ * left-recursive rules and the choices whose alternatives have overlapping first sets; the parses
+ * it is used with add up how far and where they backtracked. Like a profile, it must not be used by
+ * two parses at once.
+ */
+HComplexity *h_complexity_new(const HParser *parser);
+HComplexity *h_complexity_new__m(HAllocator *mm__, const HParser *parser);
+
+void h_complexity_free(HComplexity *complexity);
+
+void h_complexity_stats(const HComplexity *complexity, HComplexityStats *stats);
+
+/**
+ * @brief Print what the analysis found: left recursion, overlapping choices, the positions that
+ * were re-parsed most and the rules that backtracked most, and which rules should become choices
+ * that dispatch on the next byte, or get a cut point after which they no longer backtrack.
+ */
+void h_complexity_report(FILE *stream, const HComplexity *complexity);
+
 /** @} */
 
 /** @defgroup compilation Parser Compilation
@@ -1143,6 +1609,126 @@ int h_compile_for_backend_with_params__m(HAllocator *mm__, HParser *parser,
 int h_compile(HParser *parser, HParserBackend backend, const void *params);
 int h_compile__m(HAllocator *mm__, HParser *parser, HParserBackend backend, const void *params);
 
+/** Rewrite passes for h_optimize(). */
+typedef enum HOptimizePass_ {
+    H_OPT_INLINE_INDIRECT = 1 << 0, /**< replace indirects that are not part of a cycle by their
+                                         target */
+    H_OPT_FLATTEN = 1 << 1,         /**< splice nested choices and ignored subsequences, drop
+                                         single-alternative choices and doubled ignores */
+    H_OPT_MERGE_CHARSETS = 1 << 2,  /**< merge adjacent single-byte alternatives of a choice into
+                                         one charset */
+    H_OPT_FUSE_LITERALS = 1 << 3,   /**< join adjacent ignored characters and tokens into one
+                                         token */
+    H_OPT_ALL = 0xF,
+} HOptimizePass;
+
+/** What h_optimize() did. */
+typedef struct HOptimizeStats_ {
+    size_t parsers_before; /**< parsers reachable from the root beforehand */
+    size_t parsers_after;  /**< ...and afterwards */
+    size_t indirects_inlined;
+    size_t choices_flattened;
+    size_t sequences_flattened;
+    size_t ignores_collapsed;
+    size_t charsets_merged;
+    size_t literals_fused;
+} HOptimizeStats;
+
+/**
+ * @brief Simplify a parser graph in place, without changing what it accepts or the ASTs it
+ * produces.
+ *
+ * Parsers are rewritten where they are, so pointers into the graph stay valid and every backend
+ * sees the smaller graph. Call this after binding all indirects and before h_compile(); an
+ * inlined indirect can no longer be bound.
+ *
+ * @param parser Root of the parser graph
+ * @param passes Bitwise OR of HOptimizePass values, e.g. H_OPT_ALL
+ * @param stats If not NULL, receives counts of the rewrites
+ */
+void h_optimize(HParser *parser, unsigned int passes, HOptimizeStats *stats);
+void h_optimize__m(HAllocator *mm__, HParser *parser, unsigned int passes, HOptimizeStats *stats);
+
+/**
+ * @brief Copy a parser graph into one contiguous block of memory.
+ *
+ * The copies of all parsers reachable from parser come first, parents before children, followed
+ * by their environments in the same order, so that parsing touches few cache lines. Equal
+ * charsets share one copy. The original graph is left as it was. The tables h_compile() built
+ * for it are copied too, so a copy of a compiled parser is ready to use; the copy is released with
+ * h_relocated_free(). Action and predicate contexts (user_data) are shared, not copied.
+ *
+ * @param parser Root of the parser graph
+ * @return The copy of parser, or NULL if the graph holds a parser that cannot be relocated
+ */
+HParser *h_relocate(const HParser *parser);
+HParser *h_relocate__m(HAllocator *mm__, const HParser *parser);
+
+/**
+ * @brief Free a parser graph returned by h_relocate() or h_image_read(). Tables that h_compile()
+ * built for it afterwards are not freed.
+ */
+void h_relocated_free(HParser *parser);
+
+/**
+ * @brief A name for a function or a piece of data that a parser graph refers to, so that an image
+ * of the graph can refer to it across processes.
+ *
+ * Actions, predicates and the continuations of h_bind() go in function; their user_data, the
+ * thread pools of h_many_parallel() and allocators in data. The system allocator and the
+ * h_act_* actions of glue.h are known without being listed.
+ */
+typedef struct HImageSymbol_ {
+    const char *name;
+    void (*function)(void);
+    void *data;
+} HImageSymbol;
+
+#define H_IMAGE_FUNCTION(f) {#f, (void (*)(void))(f), NULL}
+#define H_IMAGE_DATA(d) {#d, NULL, (void *)(d)}
+
+/**
+ * @brief Serialize a parser graph, relocated as by h_relocate() and with the tables h_compile()
+ * built for it, into a position-independent image.
+ *
+ * Pointers within the graph are stored as offsets, and those that leave it by the names that
+ * symbols gives them. Images are only meant for the same build of the library on the same
+ * platform.
+ *
+ * @param parser Root of the parser graph
+ * @param symbols Names of the functions and data the graph refers to
+ * @param nsymbols Length of symbols
+ * @param len Receives the length of the image
+ * @return The image, allocated with the allocator, or NULL if the graph cannot be relocated or
+ * refers to something that symbols do not name
+ */
+uint8_t *h_image_write(const HParser *parser, const HImageSymbol *symbols, size_t nsymbols,
+                       size_t *len);
+uint8_t *h_image_write__m(HAllocator *mm__, const HParser *parser, const HImageSymbol *symbols,
+                          size_t nsymbols, size_t *len);
+
+/**
+ * @brief Load an image written by h_image_write(), binding the names in it to the functions and
+ * data that symbols give.
+ *
+ * The image is checked for consistency but, like code, has to come from a trusted source.
+ *
+ * @return The root of the parser graph, ready to parse if it was compiled when written and to be
+ * released with h_relocated_free(); or NULL if the image is malformed, was written by another
+ * build, or uses a name that symbols lack
+ */
+HParser *h_image_read(const uint8_t *image, size_t len, const HImageSymbol *symbols,
+                      size_t nsymbols);
+HParser *h_image_read__m(HAllocator *mm__, const uint8_t *image, size_t len,
+                         const HImageSymbol *symbols, size_t nsymbols);
+
+/**
+ * @brief h_image_read() an image from a file, which is mapped into memory rather than read.
+ */
+HParser *h_image_load(const char *path, const HImageSymbol *symbols, size_t nsymbols);
+HParser *h_image_load__m(HAllocator *mm__, const char *path, const HImageSymbol *symbols,
+                         size_t nsymbols);
+
 /** @} */
 
 /**
@@ -1226,7 +1812,36 @@ HParsedToken *h_act_ignore(const HParseResult *p, void *userdata);
 HBenchmarkResults *h_benchmark(HParser *parser, HParserTestcase *testcases);
 HBenchmarkResults *h_benchmark__m(HAllocator *mm__, HParser *parser, HParserTestcase *testcases);
 
+/**
+ * @brief Like h_benchmark(), but warm up and take repeated samples as given by options, which may
+ * be NULL for the defaults.
+ */
+HBenchmarkResults *h_benchmark_with_options(HParser *parser, HParserTestcase *testcases,
+                                            const HBenchmarkOptions *options);
+HBenchmarkResults *h_benchmark_with_options__m(HAllocator *mm__, HParser *parser,
+                                               HParserTestcase *testcases,
+                                               const HBenchmarkOptions *options);
+
 void h_benchmark_report(FILE *stream, HBenchmarkResults *results);
+
+/**
+ * @brief The timing distribution of one test case on one backend, or NULL if the backend did not
+ * benchmark it. The results must come from h_benchmark() or h_benchmark_with_options(), which
+ * keep the distributions beside the HCaseResult array rather than in it.
+ */
+const HBenchmarkStats *h_benchmark_stats(const HBenchmarkResults *results, size_t backend,
+                                         size_t testcase);
+
+/**
+ * @brief Write the statistics of every benchmarked test case as a JSON object with a "cases" array.
+ */
+void h_benchmark_write_json(FILE *stream, const HBenchmarkResults *results);
+
+/**
+ * @brief Write the statistics of every benchmarked test case as CSV, one row per case, after a
+ * header row.
+ */
+void h_benchmark_write_csv(FILE *stream, const HBenchmarkResults *results);
 // void h_benchmark_dump_optimized_code(FILE* stream, HBenchmarkResults* results);
 
 /** @} */
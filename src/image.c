@@ -0,0 +1,282 @@
+/* Position-independent images of compiled parser graphs */
+
+#include "glue.h"
+#include "hammer.h"
+#include "internal.h"
+#include "parsers/parser_internal.h"
+#include "platform.h"
+
+#include <string.h>
+
+// An image is this header, then the relocated graph with its pointers
+// rewritten, then the offsets of the internal pointers in it (uint64_t
+// each), the external references, and their names.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order; // IMAGE_BYTE_ORDER, as the writer stored it
+    uint32_t pointer_size;
+    uint32_t parser_size;
+    uint64_t size;      // of the graph
+    uint64_t count;     // parsers
+    uint64_t ninternal; // pointers into the graph, stored as offsets from the root
+    uint64_t nexternal; // pointers out of it, stored as NULL
+    uint64_t names;     // bytes of names
+} HImageHeader;
+
+typedef struct {
+    uint64_t slot;
+    uint32_t function; // else data
+    uint32_t name;     // offset into the names
+} HImageRef;
+
+#define IMAGE_MAGIC "HAMMRIMG"
+#define IMAGE_VERSION 2
+#define IMAGE_BYTE_ORDER 0x01020304u
+
+// Parsers store their vtable's index in this table.
+static const HParserVtable *const vtables[] = {
+    &action_vt, &and_vt, &attr_bool_vt, &bind_vt, &bits_vt, &butnot_vt, &bytes_vt, &ch_vt,
+    &charset_vt, &choice_vt, &difference_vt, &end_vt, &endianness_vt, &epsilon_vt, &ignore_vt,
+    &ignoreseq_vt, &indirect_vt, &int_range_vt, &many_vt, &length_value_vt, &many_parallel_vt,
+    &not_vt, &nothing_vt, &optional_vt, &permutation_vt, &skip_vt, &seek_vt, &tell_vt, &sequence_vt,
+    &struct_vt, &token_vt, &unimplemented_vt, &put_value_vt, &get_value_vt, &free_value_vt,
+    &whitespace_vt, &xor_vt,
+};
+#define NVTABLES (sizeof(vtables) / sizeof(vtables[0]))
+
+// known to every image
+static const HImageSymbol builtins[] = {
+    {"system_allocator", NULL, &system_allocator},
+    H_IMAGE_FUNCTION(h_act_first),
+    H_IMAGE_FUNCTION(h_act_second),
+    H_IMAGE_FUNCTION(h_act_last),
+    H_IMAGE_FUNCTION(h_act_flatten),
+    H_IMAGE_FUNCTION(h_act_ignore),
+};
+#define NBUILTINS (sizeof(builtins) / sizeof(builtins[0]))
+
+// The name of the function or data at slot, or NULL.
+static const char *name_of(const void *slot, bool function, const HImageSymbol *symbols,
+                           size_t nsymbols) {
+    void (*fn)(void) = NULL;
+    void *data = NULL;
+    if (function)
+        memcpy(&fn, slot, sizeof(fn));
+    else
+        memcpy(&data, slot, sizeof(data));
+
+    for (size_t i = 0; i < nsymbols + NBUILTINS; i++) {
+        const HImageSymbol *s = i < nsymbols ? &symbols[i] : &builtins[i - nsymbols];
+        if (s->name && (function ? s->function == fn : s->data == data))
+            return s->name;
+    }
+    return NULL;
+}
+
+// The symbol called name, or NULL.
+static const HImageSymbol *lookup(const char *name, const HImageSymbol *symbols, size_t nsymbols) {
+    for (size_t i = 0; i < nsymbols + NBUILTINS; i++) {
+        const HImageSymbol *s = i < nsymbols ? &symbols[i] : &builtins[i - nsymbols];
+        if (s->name && strcmp(s->name, name) == 0)
+            return s;
+    }
+    return NULL;
+}
+
+static bool add_refs(HArena *arena, HCountedArray *refs, HCountedArray *names, uint8_t *root,
+                     const HCountedArray *slots, bool function, const HImageSymbol *symbols,
+                     size_t nsymbols) {
+    for (size_t i = 0; i < slots->used; i++) {
+        uintptr_t off = (uintptr_t)slots->elements[i];
+        const char *name = name_of(root + off, function, symbols, nsymbols);
+        if (!name)
+            return false;
+        HImageRef *ref = h_arena_malloc(arena, sizeof(HImageRef));
+        ref->slot = off;
+        ref->function = function;
+        ref->name = (uint32_t)names->used;
+        for (const char *c = name;; c++) {
+            h_carray_append(names, (void *)(uintptr_t)(uint8_t)*c);
+            if (!*c)
+                break;
+        }
+        h_carray_append(refs, ref);
+        memset(root + off, 0, function ? sizeof(void (*)(void)) : sizeof(void *));
+    }
+    return true;
+}
+
+uint8_t *h_image_write(const HParser *parser, const HImageSymbol *symbols, size_t nsymbols,
+                       size_t *len) {
+    return h_image_write__m(&system_allocator, parser, symbols, nsymbols, len);
+}
+uint8_t *h_image_write__m(HAllocator *mm__, const HParser *parser, const HImageSymbol *symbols,
+                          size_t nsymbols, size_t *len) {
+    HArena *arena = h_new_arena(mm__, 0);
+    HRelocationLog log = {h_carray_new(arena), h_carray_new(arena), h_carray_new(arena)};
+    HCountedArray *refs = h_carray_new(arena), *names = h_carray_new(arena);
+    uint8_t *image = NULL;
+
+    HParser *copy = h_relocate_logged(mm__, parser, &log);
+    if (!copy)
+        goto out;
+    size_t count, size = h_relocated_size(copy, &count);
+    uint8_t *root = (uint8_t *)copy;
+
+    // the parsers' own pointers, which the log leaves out
+    HParserPrivate *nodes = h_parser_private(copy);
+    for (size_t k = 0; k < count; k++) {
+        HParser *p = &nodes[k].parser;
+        size_t v = 0;
+        while (v < NVTABLES && vtables[v] != p->vtable)
+            v++;
+        if (v == NVTABLES || p->backend_data)
+            goto out;
+        p->vtable = (const HParserVtable *)(uintptr_t)v;
+        p->backend_vtable = NULL;
+    }
+    if (!add_refs(arena, refs, names, root, log.data, false, symbols, nsymbols) ||
+        !add_refs(arena, refs, names, root, log.functions, true, symbols, nsymbols))
+        goto out;
+    for (size_t i = 0; i < log.internal->used; i++) {
+        uint8_t *slot = root + (uintptr_t)log.internal->elements[i];
+        uint8_t *target;
+        memcpy(&target, slot, sizeof(target));
+        uintptr_t off = (uintptr_t)(target - root);
+        memcpy(slot, &off, sizeof(off));
+    }
+
+    HImageHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, IMAGE_MAGIC, sizeof(hdr.magic));
+    hdr.version = IMAGE_VERSION;
+    hdr.byte_order = IMAGE_BYTE_ORDER;
+    hdr.pointer_size = sizeof(void *);
+    hdr.parser_size = sizeof(HParserPrivate);
+    hdr.size = size;
+    hdr.count = count;
+    hdr.ninternal = log.internal->used;
+    hdr.nexternal = refs->used;
+    hdr.names = names->used;
+
+    *len = sizeof(hdr) + size + hdr.ninternal * sizeof(uint64_t) +
+           hdr.nexternal * sizeof(HImageRef) + hdr.names;
+    image = h_alloc(mm__, *len);
+    uint8_t *out = image;
+    memcpy(out, &hdr, sizeof(hdr));
+    out += sizeof(hdr);
+    memcpy(out, root, size);
+    out += size;
+    for (size_t i = 0; i < hdr.ninternal; i++, out += sizeof(uint64_t)) {
+        uint64_t off = (uintptr_t)log.internal->elements[i];
+        memcpy(out, &off, sizeof(off));
+    }
+    for (size_t i = 0; i < hdr.nexternal; i++, out += sizeof(HImageRef))
+        memcpy(out, refs->elements[i], sizeof(HImageRef));
+    for (size_t i = 0; i < hdr.names; i++)
+        *out++ = (uint8_t)(uintptr_t)names->elements[i];
+
+out:
+    if (copy)
+        h_relocated_free(copy);
+    h_delete_arena(arena);
+    return image;
+}
+
+// Fill in the graph at root from the image after hdr. False if the image
+// does not hold together.
+static bool bind_image(HParser *root, const HImageHeader *hdr, const uint8_t *in,
+                       const HImageSymbol *symbols, size_t nsymbols) {
+    uint8_t *base = (uint8_t *)root;
+    const uint8_t *names = in + hdr->size + hdr->ninternal * sizeof(uint64_t) +
+                           hdr->nexternal * sizeof(HImageRef);
+
+    memcpy(base, in, hdr->size);
+    in += hdr->size;
+    for (uint64_t i = 0; i < hdr->ninternal; i++, in += sizeof(uint64_t)) {
+        uint64_t slot;
+        uintptr_t off;
+        memcpy(&slot, in, sizeof(slot));
+        if (slot > hdr->size - sizeof(void *))
+            return false;
+        memcpy(&off, base + slot, sizeof(off));
+        if (off > hdr->size)
+            return false;
+        uint8_t *target = base + off;
+        memcpy(base + slot, &target, sizeof(target));
+    }
+    for (uint64_t i = 0; i < hdr->nexternal; i++, in += sizeof(HImageRef)) {
+        HImageRef ref;
+        memcpy(&ref, in, sizeof(ref));
+        if (ref.slot > hdr->size - sizeof(void *) || ref.name >= hdr->names ||
+            !memchr(names + ref.name, 0, hdr->names - ref.name))
+            return false;
+        const HImageSymbol *s = lookup((const char *)names + ref.name, symbols, nsymbols);
+        if (!s || (ref.function ? !s->function : !s->data))
+            return false;
+        if (ref.function)
+            memcpy(base + ref.slot, &s->function, sizeof(s->function));
+        else
+            memcpy(base + ref.slot, &s->data, sizeof(s->data));
+    }
+    HParserPrivate *nodes = h_parser_private(root);
+    for (uint64_t k = 0; k < hdr->count; k++) {
+        HParser *p = &nodes[k].parser;
+        uintptr_t v = (uintptr_t)p->vtable;
+        if (v >= NVTABLES || !h_get_backend_vtable(p->backend))
+            return false;
+        p->vtable = vtables[v];
+        p->backend_vtable = h_get_backend_vtable(p->backend);
+        p->backend_data = NULL;
+        p->desugared = NULL;
+    }
+    return true;
+}
+
+HParser *h_image_read(const uint8_t *image, size_t len, const HImageSymbol *symbols,
+                      size_t nsymbols) {
+    return h_image_read__m(&system_allocator, image, len, symbols, nsymbols);
+}
+HParser *h_image_read__m(HAllocator *mm__, const uint8_t *image, size_t len,
+                         const HImageSymbol *symbols, size_t nsymbols) {
+    HImageHeader hdr;
+
+    if (len < sizeof(hdr))
+        return NULL;
+    memcpy(&hdr, image, sizeof(hdr));
+    if (memcmp(hdr.magic, IMAGE_MAGIC, sizeof(hdr.magic)) != 0 || hdr.version != IMAGE_VERSION ||
+        hdr.byte_order != IMAGE_BYTE_ORDER || hdr.pointer_size != sizeof(void *) ||
+        hdr.parser_size != sizeof(HParserPrivate))
+        return NULL;
+    // every count is bounded by len, so the sums below do not overflow
+    size_t rest = len - sizeof(hdr);
+    if (hdr.count == 0 || hdr.size > rest || hdr.count > hdr.size / sizeof(HParserPrivate) ||
+        hdr.ninternal > rest / sizeof(uint64_t) || hdr.nexternal > rest / sizeof(HImageRef) ||
+        hdr.names > rest || hdr.names > UINT32_MAX ||
+        hdr.size + hdr.ninternal * sizeof(uint64_t) + hdr.nexternal * sizeof(HImageRef) +
+                hdr.names !=
+            rest)
+        return NULL;
+
+    HParser *root = h_relocated_new(mm__, hdr.size, hdr.count);
+    if (!bind_image(root, &hdr, image + sizeof(hdr), symbols, nsymbols)) {
+        h_relocated_free(root);
+        return NULL;
+    }
+    return root;
+}
+
+HParser *h_image_load(const char *path, const HImageSymbol *symbols, size_t nsymbols) {
+    return h_image_load__m(&system_allocator, path, symbols, nsymbols);
+}
+HParser *h_image_load__m(HAllocator *mm__, const char *path, const HImageSymbol *symbols,
+                         size_t nsymbols) {
+    size_t len;
+    const uint8_t *image = h_platform_map_file(path, &len);
+    if (!image)
+        return NULL;
+    HParser *root = h_image_read__m(mm__, image, len, symbols, nsymbols);
+    h_platform_unmap_file(image, len);
+    return root;
+}
@@ -74,6 +74,14 @@ typedef struct HCFStack_ HCFStack;
 
 #define DEFAULT_ENDIANNESS (BIT_BIG_ENDIAN | BYTE_BIG_ENDIAN)
 
+// Descriptor of a segmented (scatter-gather) input. The segments are parsed
+// as if they were concatenated, without copying them.
+typedef struct HInputSegments_ {
+    const HInputSegment *segs;
+    size_t count;
+    size_t length; // total number of bytes in all segments
+} HInputSegments;
+
 typedef struct HInputStream_ {
     // This should be considered to be a really big value type.
     const uint8_t *input;
@@ -86,6 +94,11 @@ typedef struct HInputStream_ {
     char endianness;
     bool overrun;
     bool last_chunk;
+    // For segmented input, input/pos/length describe the current segment.
+    // Streams are kept normalized: index only equals length on the last
+    // segment, so equal positions always compare equal as cache keys.
+    const HInputSegments *segments; // NULL for a single contiguous buffer
+    size_t segment;                 // index of the current segment
 } HInputStream;
 
 typedef struct HSlistNode_ {
@@ -201,9 +214,10 @@ typedef struct HHashTable_ {
  * Members:
  *   cache - a hash table describing the state of the parse, including partial HParseResult's. It's
  * a hash table from HParserCacheKey to HParserCacheValue. input_stream - the input stream at this
- * state. arena - the arena that has been allocated for the parse this state is in. lr_stack - a
- * stack of HLeftRec's, used in Warth's recursion recursion_heads - table of recursion heads. Keys
- * are HParserCacheKey's with only an HInputStream (parser can be NULL), values are
+ * state. arena - the arena that has been allocated for the parse this state is in. memo_arena - the
+ * arena holding the cache and recursion bookkeeping, which may be released before arena.
+ * lr_stack - a stack of HLeftRec's, used in Warth's recursion recursion_heads - table of recursion
+ * heads. Keys are HParserCacheKey's with only an HInputStream (parser can be NULL), values are
  * HRecursionHead's. symbol_table - stack of tables of values that have been stashed in the context
  * of this parse.
  *
@@ -213,9 +227,12 @@ struct HParseState_ {
     HHashTable *cache;
     HInputStream input_stream;
     HArena *arena;
+    HArena *memo_arena; // backend bookkeeping that dies with the parse; may equal arena
     HSlist *lr_stack;
     HHashTable *recursion_heads;
     HSlist *symbol_table; // its contents are HHashTables
+    const HParseOptions *options; // NULL unless the parse is instrumented
+    int64_t deadline;             // in h_platform_time_ns(), if options has a budget with one
 };
 
 struct HSuspendedParser_ {
@@ -245,6 +262,14 @@ typedef struct HParserBackendVTable_ {
     // parse_finish must free s->backend_state.
     // parse_finish will not be called before parse_chunk reports done.
 
+    size_t (*parse_batch)(HAllocator *mm__, const HParser *parser, const uint8_t *const inputs[],
+                          const size_t lengths[], size_t n, HParseResult *results[]);
+    // optional. all successful results must share a single arena.
+
+    HParseResult *(*parse_with_options)(HAllocator *mm__, const HParser *parser,
+                                        HInputStream *stream, const HParseOptions *options);
+    // optional. without it, h_parse_with_options parses without instrumentation.
+
     /* The backend knows how to free its params */
     void (*free_params)(HAllocator *mm__, void *p);
     /*
@@ -358,20 +383,133 @@ char *h_get_short_name_with_no_params(HAllocator *mm__, HParserBackend be, void
 int64_t h_read_bits(HInputStream *state, int count, char signed_p);
 void h_skip_bits(HInputStream *state, size_t count);
 void h_seek_bits(HInputStream *state, size_t pos);
+void h_input_stream_init_segments(HInputStream *state, const HInputSegments *segments);
+void h_input_stream_normalize(HInputStream *state);
 static inline size_t h_input_stream_pos(HInputStream *state) {
     assert(state->pos <= SIZE_MAX - state->index);
     assert(state->pos + state->index < SIZE_MAX / 8);
     return (state->pos + state->index) * 8 + state->bit_offset + state->margin;
 }
 static inline size_t h_input_stream_length(HInputStream *state) {
+    if (state->segments) {
+        assert(state->segments->length <= SIZE_MAX / 8);
+        return state->segments->length * 8;
+    }
     assert(state->pos <= SIZE_MAX - state->length);
     assert(state->pos + state->length <= SIZE_MAX / 8);
     return (state->pos + state->length) * 8;
 }
+// Call work(ctx, worker, item) for every item in [0, n) on the pool's
+// threads and return true when all are done. worker is in
+// [0, h_thread_pool_size). Returns false without doing anything if the pool
+// is already running a job, e.g. when called from one of its workers.
+typedef void (*HWorkFn)(void *ctx, size_t worker, size_t item);
+bool h_thread_pool_run(HThreadPool *pool, size_t n, HWorkFn work, void *ctx);
+
 // need to decide if we want to make this public.
 HParseResult *h_do_parse(const HParser *parser, HParseState *state);
+HParseResult *h_packrat_parse_isolated(HArena *arena, HArena *memo_arena, const HParser *parser,
+                                       HInputStream *input);
 void put_cached(HParseState *ps, const HParser *p, HParseResult *cached);
 
+// Profiling, for h_do_parse. A frame lives on the stack of the call it
+// measures; entering it makes the parser the profile's current one.
+typedef struct HProfileRecord_ HProfileRecord;
+
+struct HProfile_ {
+    HAllocator *mm__;
+    HArena *arena;
+    HHashTable *records;     // parser -> HProfileRecord
+    HCountedArray *order;    // of HProfileRecord
+    HProfileRecord *current; // the innermost call
+    uint64_t child_ns;       // spent so far in the children of the innermost call
+    size_t child_arena;      // arena bytes taken so far by the children of the innermost call
+};
+
+typedef struct {
+    HProfileRecord *record;
+    HProfileRecord *outer;
+    uint64_t outer_child_ns;
+    size_t outer_child_arena;
+    int64_t start_ns;
+    size_t start_pos;
+    size_t start_arena;
+} HProfileFrame;
+
+void h_profile_begin(HProfile *profile);
+void h_profile_enter(HProfile *profile, const HParser *parser, HParseState *state,
+                     HProfileFrame *frame);
+void h_profile_exit(HProfile *profile, HParseState *state, HProfileFrame *frame, bool success);
+void h_profile_memo(HProfile *profile, bool hit);
+// Complexity analysis, for h_do_parse and the packrat backend's left
+// recursion. Frames live on the stack, like profile frames.
+typedef struct HComplexityRule_ HComplexityRule;
+typedef struct HComplexityFrame_ HComplexityFrame;
+
+struct HComplexity_ {
+    HAllocator *mm__;
+    HArena *arena;
+    const char *name;          // of the grammar's start parser
+    HHashTable *rules;         // parser -> HComplexityRule
+    HCountedArray *order;      // of HComplexityRule
+    HHashTable *positions;     // byte offset + 1 -> re-parsed calls there, as uintptr_t
+    HComplexityFrame *current; // the innermost call
+    size_t furthest;           // in bits, the furthest any call of this parse started or ended
+    const char *max_backtrack_in; // the rule that backtracked furthest
+    HComplexityStats stats;
+};
+
+struct HComplexityFrame_ {
+    const HParser *parser;
+    HComplexityFrame *outer;
+    size_t start;  // in bits
+    size_t behind; // in bits, how far start is behind the furthest point before the call
+    size_t depth;
+    bool hit; // answered from the packrat cache
+};
+
+void h_complexity_begin(HComplexity *complexity);
+void h_complexity_enter(HComplexity *complexity, const HParser *parser, HParseState *state,
+                        HComplexityFrame *frame);
+void h_complexity_exit(HComplexity *complexity, HParseState *state, HComplexityFrame *frame,
+                       bool success);
+void h_complexity_memo(HComplexity *complexity, bool hit);
+// setupLR found parser calling itself at the same position.
+void h_complexity_left_recursion(HComplexity *complexity, const HParser *parser);
+void h_complexity_grow(HComplexity *complexity, const HParser *parser);
+// The parser's name, or its kind and address, allocated in arena if need be.
+const char *h_parser_label(HArena *arena, const HParser *parser);
+// s as a quoted JSON string.
+void h_write_json_string(FILE *stream, const char *s);
+
+// Tracing, for h_do_parse.
+enum { H_TRACE_ENTER, H_TRACE_EXIT, H_TRACE_FAIL };
+
+typedef struct {
+    int64_t ns;
+    const HParser *parser;
+    size_t pos; // in bytes
+    uint8_t kind;
+} HTraceEvent;
+
+// A ring of the most recent events. Only the thread that owns the trace
+// writes to it, so recording takes no locks and never allocates.
+struct HTrace_ {
+    HAllocator *mm__;
+    HTraceEvent *events;
+    size_t mask;   // capacity - 1
+    uint64_t head; // events recorded so far
+};
+
+static inline void h_trace_record(HTrace *trace, uint8_t kind, const HParser *parser,
+                                  HInputStream *input) {
+    HTraceEvent *ev = &trace->events[trace->head++ & trace->mask];
+    ev->ns = h_platform_time_ns();
+    ev->parser = parser;
+    ev->pos = h_input_stream_pos(input) / 8;
+    ev->kind = kind;
+}
+
 /*
  * Inline this for benefit of h_new_parser() below, then make
  * the API h_get_default_backend() call it.
@@ -390,9 +528,28 @@ static inline HParserBackendVTable *h_get_missing_backend_vtable__int(void) {
 
 int h_copy_numeric_param(HAllocator *mm__, void **out, void *in);
 
+// HParserPrivate.memo. h_compile turns memoization off for parsers that
+// cannot be run twice at the same position; one that any compiled grammar
+// shares, or reaches through a cycle, stays memoized.
+enum { H_MEMO_DEFAULT = 0, H_MEMO_ON, H_MEMO_OFF };
+
+// What the library keeps about a parser besides the public HParser, whose
+// layout applications are compiled against. Every parser the library makes
+// is the first member of one of these.
+typedef struct HParserPrivate_ {
+    HParser parser;
+    const char *name; // the rule's name, given by h_name()
+    uint8_t memo;     // H_MEMO_*, set by h_compile()
+} HParserPrivate;
+
+static inline HParserPrivate *h_parser_private(const HParser *parser) {
+    return (HParserPrivate *)parser;
+}
+
 static inline HParser *h_new_parser(HAllocator *mm__, const HParserVtable *vt, void *env) {
-    HParser *p = h_new(HParser, 1);
-    memset(p, 0, sizeof(HParser));
+    HParserPrivate *priv = h_new(HParserPrivate, 1);
+    memset(priv, 0, sizeof(HParserPrivate));
+    HParser *p = &priv->parser;
     p->vtable = vt;
     p->env = env;
     /*
@@ -633,14 +790,79 @@ static inline void h_cfstack_end_choice(HAllocator *mm__, HCFStack *stk__) {
 #define HCFS_END_SEQ() h_cfstack_end_seq(mm__, stk__)
 #define HCFS_THIS_CHOICE (stk__->stack[stk__->count - 1])
 
+typedef void (*HParserVisitFn)(const HParser *child, void *ctx);
+typedef struct HRelocation_ HRelocation;
+
 struct HParserVtable_ {
     HParseResult *(*parse)(void *env, HParseState *state);
     bool (*isValidRegular)(void *env);
     bool (*isValidCF)(void *env);
     void (*desugar)(HAllocator *mm__, HCFStack *stk__, void *env);
     bool higher; // false if primitive
+    bool (*width)(void *env, size_t *bits);
+    // optional. true if every successful parse consumes exactly *bits bits.
+    bool (*total)(void *env);
+    // optional. true if parse succeeds on every input of its fixed width,
+    // without other effects, so that it can be skipped rather than run.
+    void (*walk)(void *env, HParserVisitFn visit, void *ctx);
+    // calls visit on each child parser. may be NULL for parsers without children.
+    void (*relocate)(void **env, HRelocation *r);
+    // copies *env into r with h_relocate_block, and the child parsers in it
+    // with h_relocate_parser; names other pointers with h_relocate_extern or
+    // h_relocate_function. h_relocate fails on parsers without it.
 };
 
+// Call fn once on every parser reachable from p, children before parents.
+void h_walk_parsers(HAllocator *mm__, const HParser *p, HParserVisitFn fn, void *ctx);
+
+// For relocate(): slot points to a pointer field. h_relocate_block copies
+// the size bytes it points to into the block, h_relocate_parser moves it to
+// the parser's copy; both update the field.
+void h_relocate_block(HRelocation *r, void *slot, size_t size);
+void h_relocate_parser(HRelocation *r, void *slot);
+// Like h_relocate_block, for read-only data: equal blocks share one copy.
+void h_relocate_shared(HRelocation *r, void *slot, size_t size);
+// For a field that points where the one at other did, which has been moved.
+void h_relocate_alias(HRelocation *r, void *slot, const void *other);
+// The field is left alone: it points to data, or a function, outside the
+// parser graph, which an image has to look up by name (see h_image_write).
+void h_relocate_extern(HRelocation *r, void *slot);
+void h_relocate_function(HRelocation *r, void *slot);
+// relocate() for parsers whose env is a plain value, or NULL.
+void h_relocate_value(void **env, HRelocation *r);
+
+// Offsets from the root of the copy, stored as pointers, of the fields that
+// point into the block, to data outside it, and to functions. The vtable
+// fields of the parsers are not included.
+typedef struct {
+    HCountedArray *internal, *data, *functions;
+} HRelocationLog;
+
+HParser *h_relocate_logged(HAllocator *mm__, const HParser *parser, HRelocationLog *log);
+// A block for count parsers, and size bytes in all from the first, that
+// h_relocated_free releases.
+HParser *h_relocated_new(HAllocator *mm__, size_t size, size_t count);
+size_t h_relocated_size(const HParser *parser, size_t *count);
+HParserBackendVTable *h_get_backend_vtable(HParserBackend backend);
+
+struct HCFGrammar_;
+void h_choice_compile(HAllocator *mm__, const HParser *p, struct HCFGrammar_ *g);
+// Which alternatives of the choice p can start with each byte: row c, for c
+// a byte or H_FIRST_END for the end of input, holds a flag per alternative.
+// Free with h_free.
+#define H_FIRST_END 256
+uint8_t *h_choice_first_sets(HAllocator *mm__, const HParser *p, struct HCFGrammar_ *g);
+void h_sequence_compile(HAllocator *mm__, const HParser *p);
+
+static inline bool h_fixed_width(const HParser *p, size_t *bits) {
+    return p->vtable->width && p->vtable->width(p->env, bits);
+}
+
+// Whether p, if its result is not needed, can be replaced by skipping *bits.
+static inline bool h_skippable(const HParser *p, size_t *bits) {
+    return p->vtable->total && p->vtable->total(p->env) && h_fixed_width(p, bits);
+}
+
 // {{{ Token type registry internal
 
 typedef struct HTTEntry_ {
@@ -0,0 +1,286 @@
+/* Semantics-preserving rewrites of parser graphs (h_optimize) */
+
+#include "parsers/parser_internal.h"
+
+#include <string.h>
+
+// Longest token that literal fusion builds; HToken keeps an 8-bit length.
+#define MAX_FUSED 255
+
+typedef struct {
+    HAllocator *mm__;
+    unsigned int passes;
+    HOptimizeStats *stats;
+} HOptimizer;
+
+// Make p behave like with by taking over its vtable and environment.
+static void become(HParser *p, const HParser *with) {
+    p->vtable = with->vtable;
+    p->env = with->env;
+    p->desugared = with->desugared;
+}
+
+// Follow bound indirects. Only used to look at leaves: rewiring a parent to
+// skip an indirect that closes a cycle would leave a cycle without one.
+static const HParser *deref(const HParser *p) {
+    for (int n = 0; n < 64 && p->vtable == &indirect_vt; n++) {
+        const HParser *inner = ((HIndirectEnv *)p->env)->parser;
+        if (!inner)
+            break;
+        p = inner;
+    }
+    return p;
+}
+
+// If p only ever matches one byte string, append it to buf[0..*total) and
+// return true, unless it does not fit.
+static bool append_literal(const HParser *p, uint8_t *buf, size_t *total) {
+    p = deref(p);
+    if (p->vtable == &ch_vt && *total < MAX_FUSED) {
+        buf[(*total)++] = (uint8_t)(uintptr_t)p->env;
+        return true;
+    }
+    if (p->vtable == &token_vt && *total + ((HToken *)p->env)->len <= MAX_FUSED) {
+        memcpy(buf + *total, ((HToken *)p->env)->str, ((HToken *)p->env)->len);
+        *total += ((HToken *)p->env)->len;
+        return true;
+    }
+    return false;
+}
+
+static bool append_ignored_literal(const HParser *p, uint8_t *buf, size_t *total) {
+    p = deref(p);
+    return p->vtable == &ignore_vt && append_literal(p->env, buf, total);
+}
+
+// Add the bytes p matches to cs, if p matches exactly one byte.
+static bool single_byte(const HParser *p, HCharset cs) {
+    p = deref(p);
+    if (p->vtable == &ch_vt) {
+        if (cs)
+            charset_set(cs, (uint8_t)(uintptr_t)p->env, 1);
+        return true;
+    }
+    if (p->vtable == &charset_vt) {
+        if (cs)
+            for (int c = 0; c < 256; c++)
+                if (charset_isset((HCharset)p->env, c))
+                    charset_set(cs, c, 1);
+        return true;
+    }
+    return false;
+}
+
+static void optimize_choice(HOptimizer *o, HParser *p) {
+    HAllocator *mm__ = o->mm__;
+    HChoice *c = (HChoice *)p->env;
+    bool flatten = o->passes & H_OPT_FLATTEN;
+    bool changed = false;
+
+    size_t n = 0;
+    for (size_t i = 0; i < c->len; i++) {
+        const HParser *a = c->p_array[i];
+        n += flatten && a->vtable == &choice_vt && a != p ? ((HChoice *)a->env)->len : 1;
+    }
+    HParser **alts = h_new(HParser *, n);
+    size_t len = 0;
+    for (size_t i = 0; i < c->len; i++) {
+        HParser *a = c->p_array[i];
+        if (flatten && a->vtable == &choice_vt && a != p) {
+            // ordered choice is associative
+            HChoice *inner = (HChoice *)a->env;
+            memcpy(alts + len, inner->p_array, inner->len * sizeof(HParser *));
+            len += inner->len;
+            o->stats->choices_flattened++;
+            changed = true;
+        } else {
+            alts[len++] = a;
+        }
+    }
+
+    if (o->passes & H_OPT_MERGE_CHARSETS) {
+        // only neighbours: moving an alternative past another changes priority
+        size_t out = 0;
+        for (size_t i = 0; i < len;) {
+            size_t j = i;
+            while (j < len && single_byte(alts[j], NULL))
+                j++;
+            if (j - i >= 2) {
+                HCharset cs = new_charset(mm__);
+                for (size_t k = i; k < j; k++)
+                    single_byte(alts[k], cs);
+                alts[out++] = h_new_parser(mm__, &charset_vt, cs);
+                o->stats->charsets_merged += j - i - 1;
+                changed = true;
+                i = j;
+            } else {
+                alts[out++] = alts[i++];
+            }
+        }
+        len = out;
+    }
+
+    if (changed) {
+        HChoice *env = h_new(HChoice, 1);
+        env->len = len;
+        env->p_array = alts;
+        env->dispatch = NULL;
+        env->trie = NULL;
+        p->env = env;
+        p->desugared = NULL;
+    } else {
+        h_free(alts);
+    }
+    if (flatten && len == 1 && ((HChoice *)p->env)->p_array[0] != p) {
+        become(p, ((HChoice *)p->env)->p_array[0]);
+        o->stats->choices_flattened++;
+    }
+}
+
+static void optimize_sequence(HOptimizer *o, HParser *p) {
+    HAllocator *mm__ = o->mm__;
+    HSequence *s = (HSequence *)p->env;
+    bool flatten = o->passes & H_OPT_FLATTEN;
+    bool changed = false;
+
+    // An ignored subsequence contributes nothing to the AST, so its
+    // elements can be ignored one by one instead.
+    size_t n = 0;
+    for (size_t i = 0; i < s->len; i++) {
+        const HParser *a = s->p_array[i];
+        const HParser *inner = a->vtable == &ignore_vt ? a->env : NULL;
+        n += flatten && inner && inner->vtable == &sequence_vt && inner != p
+                 ? ((HSequence *)inner->env)->len
+                 : 1;
+    }
+    HParser **elems = h_new(HParser *, n);
+    size_t len = 0;
+    for (size_t i = 0; i < s->len; i++) {
+        HParser *a = s->p_array[i];
+        HParser *inner = a->vtable == &ignore_vt ? a->env : NULL;
+        if (flatten && inner && inner->vtable == &sequence_vt && inner != p) {
+            HSequence *sub = (HSequence *)inner->env;
+            for (size_t j = 0; j < sub->len; j++) {
+                HParser *e = sub->p_array[j];
+                elems[len++] = e->vtable == &ignore_vt ? e : h_ignore__m(mm__, e);
+            }
+            o->stats->sequences_flattened++;
+            changed = true;
+        } else {
+            elems[len++] = a;
+        }
+    }
+
+    if (o->passes & H_OPT_FUSE_LITERALS) {
+        size_t out = 0;
+        for (size_t i = 0; i < len;) {
+            uint8_t buf[MAX_FUSED];
+            size_t total = 0, j = i;
+            while (j < len && append_ignored_literal(elems[j], buf, &total))
+                j++;
+            if (j - i >= 2) {
+                elems[out++] = h_ignore__m(mm__, h_token__m(mm__, buf, total));
+                o->stats->literals_fused += j - i - 1;
+                changed = true;
+                i = j;
+            } else {
+                elems[out++] = elems[i++];
+            }
+        }
+        len = out;
+    }
+
+    if (changed) {
+        HSequence *env = h_new(HSequence, 1);
+        env->len = len;
+        env->p_array = elems;
+        env->runs = NULL;
+        env->min_bits = 0;
+        p->env = env;
+        p->desugared = NULL;
+    } else {
+        h_free(elems);
+    }
+}
+
+static void optimize_ignore(HOptimizer *o, HParser *p) {
+    HParser *inner = p->env;
+
+    while ((o->passes & H_OPT_FLATTEN) && inner->vtable == &ignore_vt && inner != p) {
+        inner = inner->env;
+        p->env = inner;
+        p->desugared = NULL;
+        o->stats->ignores_collapsed++;
+    }
+
+    // an ignored run of literals only has to match, which one token does
+    if ((o->passes & H_OPT_FUSE_LITERALS) && inner->vtable == &sequence_vt) {
+        HSequence *s = (HSequence *)inner->env;
+        uint8_t buf[MAX_FUSED];
+        size_t total = 0;
+        if (s->len < 2)
+            return;
+        for (size_t i = 0; i < s->len; i++)
+            if (!append_literal(s->p_array[i], buf, &total))
+                return;
+        p->env = h_token__m(o->mm__, buf, total);
+        p->desugared = NULL;
+        o->stats->literals_fused += s->len - 1;
+    }
+}
+
+static void optimize_node(const HParser *p_, void *ctx) {
+    HOptimizer *o = ctx;
+    HParser *p = (HParser *)p_;
+
+    if (p->vtable == &choice_vt)
+        optimize_choice(o, p);
+    else if (p->vtable == &sequence_vt)
+        optimize_sequence(o, p);
+    else if (p->vtable == &ignore_vt)
+        optimize_ignore(o, p);
+}
+
+static void find_parser(const HParser *p, void *ctx) {
+    const HParser **target = ctx;
+    if (p == *target)
+        *target = NULL;
+}
+
+// Indirects that close a cycle stay: isValidCF and friends rely on them to
+// stop recursing.
+static void inline_indirect(const HParser *p_, void *ctx) {
+    HOptimizer *o = ctx;
+    HParser *p = (HParser *)p_;
+
+    if (p->vtable != &indirect_vt)
+        return;
+    const HParser *target = deref(p);
+    if (target->vtable == &indirect_vt)
+        return; // unbound, or only indirects all the way round
+    const HParser *self = p;
+    h_walk_parsers(o->mm__, target, find_parser, &self);
+    if (!self)
+        return;
+    become(p, target);
+    o->stats->indirects_inlined++;
+}
+
+static void count_parser(const HParser *p, void *ctx) { (*(size_t *)ctx)++; }
+
+void h_optimize(HParser *parser, unsigned int passes, HOptimizeStats *stats) {
+    h_optimize__m(&system_allocator, parser, passes, stats);
+}
+void h_optimize__m(HAllocator *mm__, HParser *parser, unsigned int passes, HOptimizeStats *stats) {
+    HOptimizeStats dummy;
+    HOptimizer o = {mm__, passes, stats ? stats : &dummy};
+
+    memset(o.stats, 0, sizeof(HOptimizeStats));
+    h_walk_parsers(mm__, parser, count_parser, &o.stats->parsers_before);
+    if (passes & (H_OPT_FLATTEN | H_OPT_MERGE_CHARSETS | H_OPT_FUSE_LITERALS))
+        h_walk_parsers(mm__, parser, optimize_node, &o);
+    // last, so that the other passes cannot change a target after it was copied
+    if (passes & H_OPT_INLINE_INDIRECT)
+        h_walk_parsers(mm__, parser, inline_indirect, &o);
+    h_walk_parsers(mm__, parser, count_parser, &o.stats->parsers_after);
+}
@@ -42,15 +42,39 @@ static bool action_isValidRegular(void *env) {
 
 static bool action_isValidCF(void *env) {
     HParseAction *a = (HParseAction *)env;
+    if (!a->p)
+        return false;
     return a->p->vtable->isValidCF(a->p->env);
 }
 
-static const HParserVtable action_vt = {
+static bool action_width(void *env, size_t *bits) {
+    const HParser *p = ((HParseAction *)env)->p;
+    return p && h_fixed_width(p, bits);
+}
+
+static void action_walk(void *env, HParserVisitFn visit, void *ctx) {
+    HParseAction *a = (HParseAction *)env;
+    if (a->p)
+        visit(a->p, ctx);
+}
+
+static void action_relocate(void **env, HRelocation *r) {
+    h_relocate_block(r, env, sizeof(HParseAction));
+    HParseAction *a = (HParseAction *)*env;
+    h_relocate_parser(r, &a->p);
+    h_relocate_function(r, &a->action);
+    h_relocate_extern(r, &a->user_data);
+}
+
+const HParserVtable action_vt = {
     .parse = parse_action,
     .isValidRegular = action_isValidRegular,
     .isValidCF = action_isValidCF,
     .desugar = desugar_action,
     .higher = true,
+    .width = action_width,
+    .walk = action_walk,
+    .relocate = action_relocate,
 };
 
 HParser *h_action(const HParser *p, const HAction a, void *user_data) {
@@ -9,7 +9,7 @@ static HParseResult *parse_and(void *env, HParseState *state) {
     return make_result(state->arena, NULL);
 }
 
-static const HParserVtable and_vt = {
+const HParserVtable and_vt = {
     .parse = parse_and,
     .isValidRegular = h_false, /* TODO: strictly speaking this should be regular,
                                   but it will be a huge amount of work and
@@ -17,6 +17,8 @@ static const HParserVtable and_vt = {
                                   a future revision. --mlp, 18/12/12 */
     .isValidCF = h_false,      /* despite TODO above, this remains false. */
     .higher = true,
+    .walk = walk_env_parser,
+    .relocate = relocate_env_parser,
 };
 
 HParser *h_and(const HParser *p) { return h_and__m(&system_allocator, p); }
@@ -48,12 +48,32 @@ static void desugar_ab(HAllocator *mm__, HCFStack *stk__, void *env) {
     HCFS_END_CHOICE();
 }
 
-static const HParserVtable attr_bool_vt = {
+static bool ab_width(void *env, size_t *bits) {
+    const HParser *p = ((HAttrBool *)env)->p;
+    return p && h_fixed_width(p, bits);
+}
+
+static void ab_walk(void *env, HParserVisitFn visit, void *ctx) {
+    visit(((HAttrBool *)env)->p, ctx);
+}
+
+static void ab_relocate(void **env, HRelocation *r) {
+    h_relocate_block(r, env, sizeof(HAttrBool));
+    HAttrBool *a = (HAttrBool *)*env;
+    h_relocate_parser(r, &a->p);
+    h_relocate_function(r, &a->pred);
+    h_relocate_extern(r, &a->user_data);
+}
+
+const HParserVtable attr_bool_vt = {
     .parse = parse_attr_bool,
     .isValidRegular = ab_isValidRegular,
     .isValidCF = ab_isValidCF,
     .desugar = desugar_ab,
     .higher = true,
+    .width = ab_width,
+    .walk = ab_walk,
+    .relocate = ab_relocate,
 };
 
 HParser *h_attr_bool(const HParser *p, HPredicate pred, void *user_data) {
@@ -49,11 +49,25 @@ static HParseResult *parse_bind(void *be_, HParseState *state) {
     return res2;
 }
 
-static const HParserVtable bind_vt = {
+static void bind_walk(void *env, HParserVisitFn visit, void *ctx) {
+    visit(((BindEnv *)env)->p, ctx); // parsers made by the continuation are not known yet
+}
+
+static void bind_relocate(void **env, HRelocation *r) {
+    h_relocate_block(r, env, sizeof(BindEnv));
+    BindEnv *be = (BindEnv *)*env;
+    h_relocate_parser(r, &be->p);
+    h_relocate_function(r, &be->k);
+    h_relocate_extern(r, &be->env);
+}
+
+const HParserVtable bind_vt = {
     .parse = parse_bind,
     .isValidRegular = h_false,
     .isValidCF = h_false,
     .higher = true,
+    .walk = bind_walk,
+    .relocate = bind_relocate,
 };
 
 HParser *h_bind(const HParser *p, HContinuation k, void *env) {
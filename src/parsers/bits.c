@@ -52,6 +52,11 @@ static HParsedToken *reshape_bits(const HParseResult *p, void *signedp_p) {
     return ret;
 }
 
+static bool bits_isValidCF(void *env) {
+    // the CFG form works on whole bytes only
+    return ((struct bits_env *)env)->length % 8 == 0;
+}
+
 static void desugar_bits(HAllocator *mm__, HCFStack *stk__, void *env) {
     struct bits_env *bits = (struct bits_env *)env;
     assert(0 == bits->length % 8);
@@ -76,12 +81,24 @@ static void desugar_bits(HAllocator *mm__, HCFStack *stk__, void *env) {
     HCFS_END_CHOICE();
 }
 
-static const HParserVtable bits_vt = {
+static bool bits_width(void *env, size_t *bits) {
+    *bits = ((struct bits_env *)env)->length;
+    return true;
+}
+
+static void bits_relocate(void **env, HRelocation *r) {
+    h_relocate_block(r, env, sizeof(struct bits_env));
+}
+
+const HParserVtable bits_vt = {
     .parse = parse_bits,
     .isValidRegular = h_true,
-    .isValidCF = h_true,
+    .isValidCF = bits_isValidCF,
     .desugar = desugar_bits,
     .higher = false,
+    .width = bits_width,
+    .total = h_true,
+    .relocate = bits_relocate,
 };
 
 HParser *h_bits(size_t len, bool sign) { return h_bits__m(&system_allocator, len, sign); }
@@ -37,11 +37,26 @@ static HParseResult *parse_butnot(void *env, HParseState *state) {
     }
 }
 
-static const HParserVtable butnot_vt = {
+static void butnot_walk(void *env, HParserVisitFn visit, void *ctx) {
+    HTwoParsers *parsers = (HTwoParsers *)env;
+    visit(parsers->p1, ctx);
+    visit(parsers->p2, ctx);
+}
+
+static void butnot_relocate(void **env, HRelocation *r) {
+    h_relocate_block(r, env, sizeof(HTwoParsers));
+    HTwoParsers *parsers = (HTwoParsers *)*env;
+    h_relocate_parser(r, &parsers->p1);
+    h_relocate_parser(r, &parsers->p2);
+}
+
+const HParserVtable butnot_vt = {
     .parse = parse_butnot,
     .isValidRegular = h_false,
     .isValidCF = h_false, // XXX should this be true if both p1 and p2 are CF?
     .higher = true,
+    .walk = butnot_walk,
+    .relocate = butnot_relocate,
 };
 
 HParser *h_butnot(const HParser *p1, const HParser *p2) {
@@ -23,10 +23,25 @@ static HParseResult *parse_bytes(void *env_, HParseState *state) {
     return make_result(state->arena, result);
 }
 
-static const HParserVtable bytes_vt = {
+static bool bytes_width(void *env, size_t *bits) {
+    size_t length = ((struct bytes_env *)env)->length;
+    if (length > SIZE_MAX / 8)
+        return false;
+    *bits = length * 8;
+    return true;
+}
+
+static void bytes_relocate(void **env, HRelocation *r) {
+    h_relocate_block(r, env, sizeof(struct bytes_env));
+}
+
+const HParserVtable bytes_vt = {
     .parse = parse_bytes,
     .isValidRegular = h_false, // XXX need desugar_bytes, reshape_bytes
     .isValidCF = h_false,      // XXX need bytes_ctrvm
+    .width = bytes_width,
+    .total = h_true,
+    .relocate = bytes_relocate,
 };
 
 HParser *h_bytes(size_t len) { return h_bytes__m(&system_allocator, len); }
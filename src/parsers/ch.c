@@ -23,12 +23,19 @@ static void desugar_ch(HAllocator *mm__, HCFStack *stk__, void *env) {
     HCFS_ADD_CHAR((uint8_t)(uintptr_t)(env));
 }
 
-static const HParserVtable ch_vt = {
+static bool ch_width(void *env, size_t *bits) {
+    *bits = 8;
+    return true;
+}
+
+const HParserVtable ch_vt = {
     .parse = parse_ch,
     .isValidRegular = h_true,
     .isValidCF = h_true,
     .desugar = desugar_ch,
     .higher = false,
+    .width = ch_width,
+    .relocate = h_relocate_value,
 };
 
 HParser *h_ch(const uint8_t c) { return h_ch__m(&system_allocator, c); }
@@ -26,12 +26,23 @@ static void desugar_charset(HAllocator *mm__, HCFStack *stk__, void *env) {
 
 // FUTURE: this is horribly inefficient
 
-static const HParserVtable charset_vt = {
+static bool charset_width(void *env, size_t *bits) {
+    *bits = 8;
+    return true;
+}
+
+static void charset_relocate(void **env, HRelocation *r) {
+    h_relocate_shared(r, env, 256 / 8);
+}
+
+const HParserVtable charset_vt = {
     .parse = parse_charset,
     .isValidRegular = h_true,
     .isValidCF = h_true,
     .desugar = desugar_charset,
     .higher = false,
+    .width = charset_width,
+    .relocate = charset_relocate,
 };
 
 HParser *h_ch_range(const uint8_t lower, const uint8_t upper) {
@@ -1,6 +1,8 @@
+#include "../cfgrammar.h"
 #include "parser_internal.h"
 
 #include <stdarg.h>
+#include <string.h>
 
 #if defined(__STDC_VERSION__) &&                                                                   \
     ((__STDC_VERSION__ >= 201112L && !defined(__STDC_NO_VLA__)) || (__STDC_VERSION__ >= 199901L))
@@ -14,18 +16,111 @@
 #endif
 #endif
 
+#define DISPATCH_END H_FIRST_END // index of the alternatives to try at the end of input
+#define TRIE_NONE UINT32_MAX
+
 typedef struct {
-    size_t len;
-    HParser **p_array;
-} HSequence;
+    uint32_t edges;  // index of the first outgoing edge
+    uint32_t nedges;
+    uint32_t alt;    // first alternative whose literal ends here, or TRIE_NONE
+    uint32_t least;  // least alt in this subtree
+} HTrieNode;
+
+// A byte trie of the literal alternatives of a choice (see h_as_literal), so
+// that one pass over the input finds the first of them that matches.
+typedef struct HLiteralTrie_ {
+    HTrieNode *nodes; // the root is nodes[0]
+    size_t nnodes;
+    uint8_t *labels; // edge labels, by edge
+    uint32_t *targets;
+    HLiteral *lits; // by alternative; only those in the trie are filled in
+    size_t nlits;
+} HLiteralTrie;
+
+// Walk the trie along the input after *in. Returns false if more input could
+// change the answer; else sets *alt to the first matching alternative, or
+// TRIE_NONE, and *in to the position after it.
+static bool trie_match(const HLiteralTrie *t, HInputStream *in, uint32_t *alt) {
+    HInputStream pos = *in;
+    const HTrieNode *n = t->nodes;
+    uint32_t best = TRIE_NONE;
+
+    for (;;) {
+        if (n->alt < best) {
+            best = n->alt;
+            *in = pos;
+        }
+        if (n->least >= best) // nothing below can come first
+            break;
+        uint8_t c = h_read_bits(&pos, 8, false);
+        if (pos.overrun) {
+            if (!pos.last_chunk)
+                return false;
+            break;
+        }
+        const uint8_t *e = memchr(t->labels + n->edges, c, n->nedges);
+        if (!e)
+            break;
+        n = &t->nodes[t->targets[e - t->labels]];
+    }
+    *alt = best;
+    return true;
+}
+
+static HParseResult *literal_result(const HLiteral *lit, HParseState *state) {
+    HParseResult *res = a_new(HParseResult, 1);
+    res->ast = NULL;
+    res->bit_length = 0;
+    res->arena = state->arena;
+    if (!lit->ignored) {
+        HParsedToken *tok = a_new(HParsedToken, 1);
+        *tok = lit->tok;
+        res->ast = tok;
+    }
+    return res;
+}
 
 static HParseResult *parse_choice(void *env, HParseState *state) {
-    HSequence *s = (HSequence *)env;
+    HChoice *s = (HChoice *)env;
     HInputStream backup = state->input_stream;
-    for (size_t i = 0; i < s->len; ++i) {
-        if (i != 0)
-            state->input_stream = backup;
-        HParseResult *tmp = h_do_parse(s->p_array[i], state);
+    HParser **alts = s->p_array;
+    size_t len = s->len;
+    uint32_t lit = TRIE_NONE;
+    HInputStream after = backup;
+    bool use_trie = false;
+
+    // The first sets behind the dispatch table, like the literals in the
+    // trie, are in terms of whole bytes in the default byte order.
+    if (backup.bit_offset == 0 && backup.margin == 0 && backup.endianness == DEFAULT_ENDIANNESS) {
+        if (s->dispatch) {
+            HInputStream peek = backup;
+            uint8_t c = h_read_bits(&peek, 8, false);
+            const HSequence *branch = NULL;
+            if (!peek.overrun)
+                branch = &s->dispatch[c];
+            else if (peek.last_chunk)
+                branch = &s->dispatch[DISPATCH_END];
+            if (branch) { // else more input may arrive; try everything
+                alts = branch->p_array;
+                len = branch->len;
+            }
+        }
+        // an instrumented parse tries each literal in turn, so that its
+        // calls are counted and traced like any other
+        if (s->trie && !state->options)
+            use_trie = trie_match(s->trie, &after, &lit);
+    }
+
+    for (size_t i = 0; i < len; ++i) {
+        // literals other than the one the trie found cannot match here
+        if (use_trie && h_as_literal(alts[i], NULL)) {
+            if (lit == TRIE_NONE || alts[i] != s->p_array[lit])
+                continue;
+            state->input_stream = after;
+            return literal_result(&s->trie->lits[lit], state);
+        }
+        state->input_stream = backup;
+        HParseResult *tmp = h_do_parse(alts[i], state);
         if (NULL != tmp)
             return tmp;
         if (want_suspend(state))
@@ -36,7 +131,7 @@ static HParseResult *parse_choice(void *env, HParseState *state) {
 }
 
 static bool choice_isValidRegular(void *env) {
-    HSequence *s = (HSequence *)env;
+    HChoice *s = (HChoice *)env;
     for (size_t i = 0; i < s->len; ++i) {
         if (!s->p_array[i]->vtable->isValidRegular(s->p_array[i]->env))
             return false;
@@ -45,7 +140,7 @@ static bool choice_isValidRegular(void *env) {
 }
 
 static bool choice_isValidCF(void *env) {
-    HSequence *s = (HSequence *)env;
+    HChoice *s = (HChoice *)env;
     for (size_t i = 0; i < s->len; ++i) {
         if (!s->p_array[i]->vtable->isValidCF(s->p_array[i]->env))
             return false;
@@ -54,7 +149,7 @@ static bool choice_isValidCF(void *env) {
 }
 
 static void desugar_choice(HAllocator *mm__, HCFStack *stk__, void *env) {
-    HSequence *s = (HSequence *)env;
+    HChoice *s = (HChoice *)env;
     HCFS_BEGIN_CHOICE() {
         for (size_t i = 0; i < s->len; i++) {
             HCFS_BEGIN_SEQ() { HCFS_DESUGAR(s->p_array[i]); }
@@ -65,12 +160,57 @@ static void desugar_choice(HAllocator *mm__, HCFStack *stk__, void *env) {
     HCFS_END_CHOICE();
 }
 
-static const HParserVtable choice_vt = {
+static void choice_walk(void *env, HParserVisitFn visit, void *ctx) {
+    HChoice *s = (HChoice *)env;
+    for (size_t i = 0; i < s->len; ++i)
+        visit(s->p_array[i], ctx);
+}
+
+static void choice_relocate(void **env, HRelocation *r) {
+    h_relocate_block(r, env, sizeof(HChoice));
+    HChoice *s = (HChoice *)*env;
+    h_relocate_block(r, &s->p_array, s->len * sizeof(HParser *));
+    for (size_t i = 0; i < s->len; ++i)
+        h_relocate_parser(r, &s->p_array[i]);
+    // what h_compile found goes along
+    if (s->dispatch) {
+        const HSequence *orig = s->dispatch;
+        h_relocate_block(r, &s->dispatch, (DISPATCH_END + 1) * sizeof(HSequence));
+        for (size_t c = 0; c <= DISPATCH_END; c++) {
+            HSequence *d = &s->dispatch[c];
+            if (c > 0 && orig[c].p_array == orig[c - 1].p_array) {
+                h_relocate_alias(r, &d->p_array, &d[-1].p_array);
+                continue;
+            }
+            h_relocate_block(r, &d->p_array, d->len * sizeof(HParser *));
+            for (size_t i = 0; i < d->len; ++i)
+                h_relocate_parser(r, &d->p_array[i]);
+        }
+    }
+    if (s->trie) {
+        h_relocate_block(r, &s->trie, sizeof(HLiteralTrie));
+        HLiteralTrie *t = s->trie;
+        h_relocate_block(r, &t->nodes, t->nnodes * sizeof(HTrieNode));
+        h_relocate_block(r, &t->labels, t->nnodes);
+        h_relocate_block(r, &t->targets, t->nnodes * sizeof(uint32_t));
+        h_relocate_block(r, &t->lits, s->len * sizeof(HLiteral));
+        for (size_t i = 0; i < s->len; ++i) {
+            HLiteral *lit = &t->lits[i];
+            h_relocate_block(r, &lit->str, lit->len);
+            if (lit->tok.token_type == TT_BYTES)
+                h_relocate_block(r, &lit->tok.bytes.token, lit->tok.bytes.len);
+        }
+    }
+}
+
+const HParserVtable choice_vt = {
     .parse = parse_choice,
     .isValidRegular = choice_isValidRegular,
     .isValidCF = choice_isValidCF,
     .desugar = desugar_choice,
     .higher = true,
+    .walk = choice_walk,
+    .relocate = choice_relocate,
 };
 
 HParser *h_choice(HParser *p, ...) {
@@ -94,7 +234,7 @@ HParser *h_choice__v(HParser *p, va_list ap) { return h_choice__mv(&system_alloc
 HParser *h_choice__mv(HAllocator *mm__, HParser *p, va_list ap_) {
     va_list ap;
     size_t len = 0;
-    HSequence *s = h_new(HSequence, 1);
+    HChoice *s = h_new(HChoice, 1);
 
     HParser *arg;
     va_copy(ap, ap_);
@@ -115,6 +255,8 @@ HParser *h_choice__mv(HAllocator *mm__, HParser *p, va_list ap_) {
     va_end(ap);
 
     s->len = len;
+    s->dispatch = NULL;
+    s->trie = NULL;
     return h_new_parser(mm__, &choice_vt, s);
 }
 
@@ -128,7 +270,7 @@ HParser *h_choice__ma(HAllocator *mm__, void *args[]) {
         arg = ((HParser **)args)[++len];
     } while (arg);
 
-    HSequence *s = h_new(HSequence, 1);
+    HChoice *s = h_new(HChoice, 1);
     s->p_array = h_new(HParser *, len);
 
     for (size_t i = 0; i < len; i++) {
@@ -136,11 +278,169 @@ HParser *h_choice__ma(HAllocator *mm__, void *args[]) {
     }
 
     s->len = len;
-    HParser *ret = h_new(HParser, 1);
-    ret->vtable = &choice_vt;
-    ret->env = (void *)s;
-    ret->backend = h_get_default_backend();
-    ret->backend_vtable = h_get_default_backend_vtable();
-    ret->desugared = NULL;
-    return ret;
+    s->dispatch = NULL;
+    s->trie = NULL;
+    return h_new_parser(mm__, &choice_vt, s);
+}
+
+// Build the trie of the literal alternatives of s, or NULL if there are
+// fewer than two.
+static HLiteralTrie *new_literal_trie(HAllocator *mm__, const HChoice *s) {
+    size_t nlits = 0, maxn = 1;
+    HLiteral *lits = h_new(HLiteral, s->len);
+    memset(lits, 0, s->len * sizeof(HLiteral));
+    for (size_t i = 0; i < s->len; i++) {
+        if (h_as_literal(s->p_array[i], &lits[i])) {
+            nlits++;
+            maxn += lits[i].len;
+        }
+    }
+    if (nlits < 2) {
+        h_free(lits);
+        return NULL;
+    }
+
+    // insert the literals as linked lists of children, in order, so that
+    // the first alternative to reach a node keeps it
+    uint32_t *child = h_new(uint32_t, maxn), *sibling = h_new(uint32_t, maxn);
+    uint32_t *parent = h_new(uint32_t, maxn);
+    uint8_t *label = h_new(uint8_t, maxn);
+    HTrieNode *nodes = h_new(HTrieNode, maxn);
+    size_t nn = 1;
+    child[0] = sibling[0] = parent[0] = TRIE_NONE;
+    nodes[0].alt = TRIE_NONE;
+    for (size_t i = 0; i < s->len; i++) {
+        if (!h_as_literal(s->p_array[i], NULL))
+            continue;
+        const uint8_t *str = h_literal_bytes(&lits[i]);
+        uint32_t n = 0;
+        for (size_t k = 0; k < lits[i].len; k++) {
+            uint32_t c = child[n];
+            while (c != TRIE_NONE && label[c] != str[k])
+                c = sibling[c];
+            if (c == TRIE_NONE) {
+                c = nn++;
+                label[c] = str[k];
+                parent[c] = n;
+                child[c] = TRIE_NONE;
+                sibling[c] = child[n];
+                child[n] = c;
+                nodes[c].alt = TRIE_NONE;
+            }
+            n = c;
+        }
+        if (nodes[n].alt == TRIE_NONE)
+            nodes[n].alt = i;
+    }
+
+    // children come after their parents
+    for (size_t n = 0; n < nn; n++)
+        nodes[n].least = nodes[n].alt;
+    for (size_t n = nn - 1; n > 0; n--)
+        if (nodes[n].least < nodes[parent[n]].least)
+            nodes[parent[n]].least = nodes[n].least;
+
+    HLiteralTrie *t = h_new(HLiteralTrie, 1);
+    t->nodes = nodes;
+    t->nnodes = nn;
+    t->labels = h_new(uint8_t, nn);
+    t->targets = h_new(uint32_t, nn);
+    t->lits = lits;
+    t->nlits = nlits;
+    uint32_t e = 0;
+    for (size_t n = 0; n < nn; n++) {
+        nodes[n].edges = e;
+        for (uint32_t c = child[n]; c != TRIE_NONE; c = sibling[c]) {
+            t->labels[e] = label[c];
+            t->targets[e++] = c;
+        }
+        nodes[n].nedges = e - nodes[n].edges;
+    }
+    h_free(child);
+    h_free(sibling);
+    h_free(parent);
+    h_free(label);
+    return t;
+}
+
+// Mark in row c of member (one row of len flags per input byte, plus
+// DISPATCH_END) that alternative i can start with c. A NULL first set means
+// the alternative has to be tried regardless.
+static void mark_first(uint8_t *member, size_t len, size_t i, const HStringMap *first) {
+    bool always = !first || first->epsilon_branch;
+    for (size_t c = 0; c < 256; c++)
+        if (always || h_stringmap_get_char(first, c))
+            member[c * len + i] = 1;
+    if (always || first->end_branch)
+        member[DISPATCH_END * len + i] = 1;
+}
+
+// From 1-byte first sets of the alternatives' CFG forms. g, if not NULL, is a
+// grammar that may already cover p.
+uint8_t *h_choice_first_sets(HAllocator *mm__, const HParser *p, HCFGrammar *g) {
+    const HChoice *s = (const HChoice *)p->env;
+    uint8_t *member = h_new(uint8_t, (DISPATCH_END + 1) * s->len);
+    memset(member, 0, (DISPATCH_END + 1) * s->len);
+    HCFGrammar *own = NULL;
+    if (p->vtable->isValidCF(p->env)) {
+        if (!g || !p->desugared || !h_hashset_present(g->nts, p->desugared))
+            g = own = h_cfgrammar(mm__, p);
+        HCFSequence **seq = p->desugared->seq;
+        for (size_t i = 0; i < s->len; i++) {
+            assert(seq[i] != NULL); // desugar_choice makes one sequence per alternative
+            mark_first(member, s->len, i, h_first_seq(1, g, seq[i]->items));
+        }
+    } else {
+        for (size_t i = 0; i < s->len; i++) {
+            own = h_cfgrammar(mm__, s->p_array[i]);
+            mark_first(member, s->len, i, own ? h_first(1, own, own->start) : NULL);
+            if (own)
+                h_cfgrammar_free(own);
+        }
+        own = NULL;
+    }
+    if (own)
+        h_cfgrammar_free(own);
+    return member;
+}
+
+// Build the trie of literal alternatives, and the table that parse_choice
+// uses to skip alternatives which cannot start with the next input byte.
+// Survivors keep their order, so PEG priority is unchanged.
+void h_choice_compile(HAllocator *mm__, const HParser *p, HCFGrammar *g) {
+    if (p->vtable != &choice_vt)
+        return;
+    HChoice *s = (HChoice *)p->env;
+    if (!s->trie)
+        s->trie = new_literal_trie(mm__, s);
+    if (s->trie && s->trie->nlits == s->len)
+        return; // the trie alone decides
+    if (s->dispatch || s->len < 2)
+        return;
+
+    uint8_t *member = h_choice_first_sets(mm__, p, g);
+    bool useful = false;
+    for (size_t i = 0; i < (DISPATCH_END + 1) * s->len; i++)
+        useful |= !member[i];
+    if (useful) {
+        HSequence *dispatch = h_new(HSequence, DISPATCH_END + 1);
+        for (size_t c = 0; c <= DISPATCH_END; c++) {
+            const uint8_t *row = member + c * s->len;
+            if (c > 0 && memcmp(row, row - s->len, s->len) == 0) {
+                dispatch[c] = dispatch[c - 1]; // runs of bytes usually agree
+                continue;
+            }
+            dispatch[c].len = 0;
+            dispatch[c].runs = NULL;
+            dispatch[c].min_bits = 0;
+            for (size_t i = 0; i < s->len; i++)
+                dispatch[c].len += row[i];
+            dispatch[c].p_array = h_new(HParser *, dispatch[c].len > 0 ? dispatch[c].len : 1);
+            for (size_t i = 0, j = 0; i < s->len; i++)
+                if (row[i])
+                    dispatch[c].p_array[j++] = s->p_array[i];
+        }
+        s->dispatch = dispatch;
+    }
+    h_free(member);
 }
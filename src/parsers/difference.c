@@ -37,11 +37,26 @@ static HParseResult *parse_difference(void *env, HParseState *state) {
     }
 }
 
-static const HParserVtable difference_vt = {
+static void difference_walk(void *env, HParserVisitFn visit, void *ctx) {
+    HTwoParsers *parsers = (HTwoParsers *)env;
+    visit(parsers->p1, ctx);
+    visit(parsers->p2, ctx);
+}
+
+static void difference_relocate(void **env, HRelocation *r) {
+    h_relocate_block(r, env, sizeof(HTwoParsers));
+    HTwoParsers *parsers = (HTwoParsers *)*env;
+    h_relocate_parser(r, &parsers->p1);
+    h_relocate_parser(r, &parsers->p2);
+}
+
+const HParserVtable difference_vt = {
     .parse = parse_difference,
     .isValidRegular = h_false,
     .isValidCF = h_false, // XXX should this be true if both p1 and p2 are CF?
     .higher = true,
+    .walk = difference_walk,
+    .relocate = difference_relocate,
 };
 
 HParser *h_difference(const HParser *p1, const HParser *p2) {
@@ -19,12 +19,13 @@ static HParseResult *parse_end(void *env, HParseState *state) {
 
 static void desugar_end(HAllocator *mm__, HCFStack *stk__, void *env) { HCFS_ADD_END(); }
 
-static const HParserVtable end_vt = {
+const HParserVtable end_vt = {
     .parse = parse_end,
     .isValidRegular = h_true,
     .isValidCF = h_true,
     .desugar = desugar_end,
     .higher = false,
+    .relocate = h_relocate_value,
 };
 
 HParser *h_end_p() { return h_end_p__m(&system_allocator); }
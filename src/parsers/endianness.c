@@ -37,12 +37,23 @@ static HParseResult *parse_endianness(void *env, HParseState *state) {
     return res;
 }
 
-static const HParserVtable endianness_vt = {
+static void endianness_walk(void *env, HParserVisitFn visit, void *ctx) {
+    visit(((HParseEndianness *)env)->p, ctx);
+}
+
+static void endianness_relocate(void **env, HRelocation *r) {
+    h_relocate_block(r, env, sizeof(HParseEndianness));
+    h_relocate_parser(r, &((HParseEndianness *)*env)->p);
+}
+
+const HParserVtable endianness_vt = {
     .parse = parse_endianness,
     .isValidRegular = h_false,
     .isValidCF = h_false,
     .desugar = NULL,
     .higher = true,
+    .walk = endianness_walk,
+    .relocate = endianness_relocate,
 };
 
 HParser *h_with_endianness(char endianness, const HParser *p) {
@@ -9,21 +9,14 @@ static HParseResult *parse_epsilon(void *env, HParseState *state) {
     return res;
 }
 
-static const HParserVtable epsilon_vt = {
+const HParserVtable epsilon_vt = {
     .parse = parse_epsilon,
     .isValidRegular = h_true,
     .isValidCF = h_true,
     .desugar = desugar_epsilon,
     .higher = false,
+    .relocate = h_relocate_value,
 };
 
 HParser *h_epsilon_p() { return h_epsilon_p__m(&system_allocator); }
-HParser *h_epsilon_p__m(HAllocator *mm__) {
-    HParser *epsilon_p = h_new(HParser, 1);
-    epsilon_p->desugared = NULL;
-    epsilon_p->backend_data = NULL;
-    epsilon_p->backend = h_get_default_backend();
-    epsilon_p->backend_vtable = h_get_default_backend_vtable();
-    epsilon_p->vtable = &epsilon_vt;
-    return epsilon_p;
-}
+HParser *h_epsilon_p__m(HAllocator *mm__) { return h_new_parser(mm__, &epsilon_vt, NULL); }
@@ -3,8 +3,12 @@
 #include <assert.h>
 
 static HParseResult *parse_ignore(void *env, HParseState *state) {
-    HParseResult *res0 = h_do_parse((HParser *)env, state);
-    if (!res0)
+    size_t bits;
+    // fixed fields that cannot fail need not be parsed only to be dropped;
+    // running out of input still fails through the overrun flag
+    if (h_skippable((HParser *)env, &bits))
+        h_skip_bits(&state->input_stream, bits);
+    else if (!h_do_parse((HParser *)env, state))
         return NULL;
     HParseResult *res = a_new(HParseResult, 1);
     res->ast = NULL;
@@ -32,12 +36,23 @@ static void desugar_ignore(HAllocator *mm__, HCFStack *stk__, void *env) {
     HCFS_END_CHOICE();
 }
 
-static const HParserVtable ignore_vt = {
+static bool ignore_width(void *env, size_t *bits) { return h_fixed_width((HParser *)env, bits); }
+
+static bool ignore_total(void *env) {
+    HParser *p = (HParser *)env;
+    return p->vtable->total && p->vtable->total(p->env);
+}
+
+const HParserVtable ignore_vt = {
     .parse = parse_ignore,
     .isValidRegular = ignore_isValidRegular,
     .isValidCF = ignore_isValidCF,
     .desugar = desugar_ignore,
     .higher = true,
+    .width = ignore_width,
+    .total = ignore_total,
+    .walk = walk_env_parser,
+    .relocate = relocate_env_parser,
 };
 
 HParser *h_ignore(const HParser *p) { return h_ignore__m(&system_allocator, p); }
@@ -65,6 +65,8 @@ static bool is_isValidRegular(void *env) {
 
 static bool is_isValidCF(void *env) {
     HIgnoreSeq *seq = (HIgnoreSeq *)env;
+    if (seq->which > 1 && seq->which != seq->len - 1)
+        return false; // no reshape for this in desugar_ignoreseq
     for (size_t i = 0; i < seq->len; ++i) {
         if (!seq->parsers[i]->vtable->isValidCF(seq->parsers[i]->env))
             return false;
@@ -72,12 +74,28 @@ static bool is_isValidCF(void *env) {
     return true;
 }
 
-static const HParserVtable ignoreseq_vt = {
+static void is_walk(void *env, HParserVisitFn visit, void *ctx) {
+    const HIgnoreSeq *seq = (HIgnoreSeq *)env;
+    for (size_t i = 0; i < seq->len; i++)
+        visit(seq->parsers[i], ctx);
+}
+
+static void is_relocate(void **env, HRelocation *r) {
+    h_relocate_block(r, env, sizeof(HIgnoreSeq));
+    HIgnoreSeq *seq = (HIgnoreSeq *)*env;
+    h_relocate_block(r, &seq->parsers, seq->len * sizeof(HParser *));
+    for (size_t i = 0; i < seq->len; i++)
+        h_relocate_parser(r, &seq->parsers[i]);
+}
+
+const HParserVtable ignoreseq_vt = {
     .parse = parse_ignoreseq,
     .isValidRegular = is_isValidRegular,
     .isValidCF = is_isValidCF,
     .desugar = desugar_ignoreseq,
     .higher = true,
+    .walk = is_walk,
+    .relocate = is_relocate,
 };
 
 //
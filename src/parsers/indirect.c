@@ -1,20 +1,34 @@
 #include "parser_internal.h"
 
-typedef struct HIndirectEnv_ {
-    const HParser *parser;
-    bool touched;
-} HIndirectEnv;
-
 static HParseResult *parse_indirect(void *env, HParseState *state) {
     return h_do_parse(((HIndirectEnv *)env)->parser, state);
 }
 
+// Whether the indirects bound to indirects from ie end in a parser: not if
+// one is unbound, or if they go round in a loop, which has nothing to desugar
+// to and never consumes any input.
+static bool resolves(const HIndirectEnv *ie) {
+    const HParser *slow = ie->parser, *fast = ie->parser;
+    while (fast && fast->vtable == &indirect_vt) {
+        fast = ((const HIndirectEnv *)fast->env)->parser;
+        if (!fast || fast->vtable != &indirect_vt)
+            break;
+        fast = ((const HIndirectEnv *)fast->env)->parser;
+        slow = ((const HIndirectEnv *)slow->env)->parser;
+        if (fast == slow)
+            return false;
+    }
+    return fast != NULL;
+}
+
 static bool indirect_isValidCF(void *env) {
     HIndirectEnv *ie = (HIndirectEnv *)env;
     if (ie->touched)
         return true;
-    ie->touched = true;
+    if (!resolves(ie))
+        return false;
     const HParser *p = ie->parser;
+    ie->touched = true;
     // self->vtable->isValidCF = h_true;
     bool ret = p->vtable->isValidCF(p->env);
     ie->touched = false;
@@ -25,12 +39,25 @@ static void desugar_indirect(HAllocator *mm__, HCFStack *stk__, void *env) {
     HCFS_DESUGAR(((HIndirectEnv *)env)->parser);
 }
 
-static const HParserVtable indirect_vt = {
+static void indirect_walk(void *env, HParserVisitFn visit, void *ctx) {
+    const HParser *p = ((HIndirectEnv *)env)->parser;
+    if (p)
+        visit(p, ctx);
+}
+
+static void indirect_relocate(void **env, HRelocation *r) {
+    h_relocate_block(r, env, sizeof(HIndirectEnv));
+    h_relocate_parser(r, &((HIndirectEnv *)*env)->parser);
+}
+
+const HParserVtable indirect_vt = {
     .parse = parse_indirect,
     .isValidRegular = h_false,
     .isValidCF = indirect_isValidCF,
     .desugar = desugar_indirect,
     .higher = true,
+    .walk = indirect_walk,
+    .relocate = indirect_relocate,
 };
 
 void h_bind_indirect__m(HAllocator *mm__, HParser *indirect, const HParser *inner) {
@@ -93,12 +93,45 @@ static void desugar_int_range(HAllocator *mm__, HCFStack *stk__, void *env) {
     gen_int_range(mm__, stk__, r->lower, r->upper, bytes);
 }
 
-static const HParserVtable int_range_vt = {
+static bool int_range_width(void *env, size_t *bits) {
+    const HParser *p = ((HRange *)env)->p;
+    return p && h_fixed_width(p, bits);
+}
+
+static bool int_range_isValidCF(void *env) {
+    HRange *r = (HRange *)env;
+    // desugar_int_range reads the width from a bits parser's env, and spells
+    // out big-endian values of up to 4 bytes; a signed one only where its
+    // sign bit is clear
+    if (r->p->vtable != &bits_vt)
+        return false;
+    const struct bits_env *be = (const struct bits_env *)r->p->env;
+    size_t bits = be->length;
+    if (bits == 0 || bits % 8 != 0 || bits > 32)
+        return false;
+    if (be->signedp)
+        bits--;
+    return r->lower >= 0 && r->lower <= r->upper && (uint64_t)r->upper < ((uint64_t)1 << bits);
+}
+
+static void int_range_walk(void *env, HParserVisitFn visit, void *ctx) {
+    visit(((HRange *)env)->p, ctx);
+}
+
+static void int_range_relocate(void **env, HRelocation *r) {
+    h_relocate_block(r, env, sizeof(HRange));
+    h_relocate_parser(r, &((HRange *)*env)->p);
+}
+
+const HParserVtable int_range_vt = {
     .parse = parse_int_range,
     .isValidRegular = h_true,
-    .isValidCF = h_true,
+    .isValidCF = int_range_isValidCF,
     .desugar = desugar_int_range,
     .higher = false,
+    .width = int_range_width,
+    .walk = int_range_walk,
+    .relocate = int_range_relocate,
 };
 
 HParser *h_int_range(const HParser *p, const int64_t lower, const int64_t upper) {
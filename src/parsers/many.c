@@ -1,6 +1,7 @@
 #include "parser_internal.h"
 
 #include <assert.h>
+#include <setjmp.h>
 
 // TODO: split this up.
 typedef struct {
@@ -64,6 +65,24 @@ static bool many_isValidCF(void *env) {
             (repeat->sep == NULL || repeat->sep->vtable->isValidCF(repeat->sep->env)));
 }
 
+static bool many_width(void *env, size_t *bits) {
+    HRepeat *repeat = (HRepeat *)env;
+    size_t w;
+    // only h_repeat_n has a fixed number of elements
+    if (repeat->min_p || !h_fixed_width(repeat->p, &w))
+        return false;
+    if (w > 0 && repeat->count > SIZE_MAX / w)
+        return false;
+    *bits = repeat->count * w;
+    return true;
+}
+
+static bool many_total(void *env) {
+    HRepeat *repeat = (HRepeat *)env;
+    const HParser *p = repeat->p;
+    return !repeat->min_p && p->vtable->total && p->vtable->total(p->env);
+}
+
 // turn (_ x (_ y (_ z ()))) into (x y z) where '_' are optional
 static HParsedToken *reshape_many(const HParseResult *p, void *user) {
     HCountedArray *seq = h_carray_new(p->arena);
@@ -145,12 +164,30 @@ static void desugar_many(HAllocator *mm__, HCFStack *stk__, void *env) {
     HCFS_END_CHOICE();
 }
 
-static const HParserVtable many_vt = {
+static void many_walk(void *env, HParserVisitFn visit, void *ctx) {
+    HRepeat *repeat = (HRepeat *)env;
+    visit(repeat->p, ctx);
+    if (repeat->sep)
+        visit(repeat->sep, ctx);
+}
+
+static void many_relocate(void **env, HRelocation *r) {
+    h_relocate_block(r, env, sizeof(HRepeat));
+    HRepeat *repeat = (HRepeat *)*env;
+    h_relocate_parser(r, &repeat->p);
+    h_relocate_parser(r, &repeat->sep);
+}
+
+const HParserVtable many_vt = {
     .parse = parse_many,
     .isValidRegular = many_isValidRegular,
     .isValidCF = many_isValidCF,
     .desugar = desugar_many,
     .higher = true,
+    .width = many_width,
+    .total = many_total,
+    .walk = many_walk,
+    .relocate = many_relocate,
 };
 
 HParser *h_many(const HParser *p) { return h_many__m(&system_allocator, p); }
@@ -226,10 +263,25 @@ static HParseResult *parse_length_value(void *env, HParseState *state) {
     return parse_many(&repeat, state);
 }
 
-static const HParserVtable length_value_vt = {
+static void length_value_walk(void *env, HParserVisitFn visit, void *ctx) {
+    HLenVal *lv = (HLenVal *)env;
+    visit(lv->length, ctx);
+    visit(lv->value, ctx);
+}
+
+static void length_value_relocate(void **env, HRelocation *r) {
+    h_relocate_block(r, env, sizeof(HLenVal));
+    HLenVal *lv = (HLenVal *)*env;
+    h_relocate_parser(r, &lv->length);
+    h_relocate_parser(r, &lv->value);
+}
+
+const HParserVtable length_value_vt = {
     .parse = parse_length_value,
     .isValidRegular = h_false,
     .isValidCF = h_false,
+    .walk = length_value_walk,
+    .relocate = length_value_relocate,
 };
 
 HParser *h_length_value(const HParser *length, const HParser *value) {
@@ -241,3 +293,200 @@ HParser *h_length_value__m(HAllocator *mm__, const HParser *length, const HParse
     env->value = value;
     return h_new_parser(mm__, &length_value_vt, env);
 }
+
+typedef struct {
+    HThreadPool *pool;
+    const HParser *p;
+} HManyParallel;
+
+// A block of consecutive records, parsed on one thread.
+typedef struct {
+    HInputStream start;
+    size_t count;       // records in the block
+    size_t nok;         // leading records that parsed
+    HInputStream end;   // position after the last record that parsed
+    HCountedArray *seq; // their tokens
+    HArena *arena;
+} HRecordBlock;
+
+typedef struct {
+    HAllocator *mm__; // the running parse's
+    const HParser *record;
+    HRecordBlock *blocks;
+} HRecordJob;
+
+static void parse_record_block(void *ctx, size_t worker, size_t blk) {
+    HRecordJob *job = ctx;
+    HRecordBlock *b = &job->blocks[blk];
+    HArena *arena = h_new_arena(job->mm__, 0);
+    HArena *memo = h_new_arena(job->mm__, 0);
+    HInputStream input = b->start;
+
+    // out-of-memory handling: keep whatever parsed before
+    jmp_buf except;
+    h_arena_set_except(arena, &except);
+    h_arena_set_except(memo, &except);
+    b->arena = arena;
+    b->nok = 0;
+    b->end = input;
+    if (setjmp(except)) {
+        h_arena_set_except(arena, NULL);
+        h_delete_arena(memo);
+        return;
+    }
+
+    b->seq = h_carray_new_sized(arena, b->count);
+    for (size_t i = 0; i < b->count; i++) {
+        HParseResult *elem = h_packrat_parse_isolated(arena, memo, job->record, &input);
+        h_arena_reset(memo);
+        if (!elem)
+            break;
+        if (elem->ast)
+            h_carray_append(b->seq, (void *)elem->ast);
+        b->nok = i + 1;
+        b->end = input;
+    }
+    h_arena_set_except(arena, NULL);
+    h_delete_arena(memo);
+}
+
+static HParseResult *parse_many_parallel(void *env, HParseState *state) {
+    HManyParallel *mp = (HManyParallel *)env;
+    HRepeat many = {.p = mp->p, .sep = NULL, .count = 0, .min_p = true};
+    size_t width;
+
+    // Only length-prefixed records of fixed-width elements can be delimited
+    // without parsing them. Suspendable (chunked) parses stay sequential.
+    if (mp->p->vtable != &length_value_vt || !state->input_stream.last_chunk)
+        return parse_many(&many, state);
+    HLenVal *lv = (HLenVal *)mp->p->env;
+    if (!h_fixed_width(lv->value, &width))
+        return parse_many(&many, state);
+
+    // Find the record boundaries with a pass over the length fields. Only
+    // every stride'th boundary is kept; when the table fills up, every other
+    // entry is dropped and the stride doubles. The length fields are parsed
+    // into a scratch arena, so that the pass takes no more memory than the
+    // table, however many records there are.
+    HAllocator *mm__ = h_arena_allocator(state->arena);
+    size_t cap = h_thread_pool_size(mp->pool) * 16;
+    if (cap < 64)
+        cap = 64;
+    HInputStream *starts = a_new_(state->memo_arena, HInputStream, cap);
+    size_t nstarts = 0, stride = 1, n = 0;
+    HInputStream begin = state->input_stream;
+    HArena *scratch = h_new_arena(mm__, 0);
+    jmp_buf except;
+    h_arena_set_except(scratch, &except);
+    if (setjmp(except)) {
+        h_delete_arena(scratch);
+        h_arena_abort(state->arena); // out of memory, as in the parse's own arena
+    }
+    for (;;) {
+        HInputStream bak = state->input_stream;
+        HParseResult *len = h_packrat_parse_isolated(scratch, scratch, lv->length,
+                                                     &state->input_stream);
+        if (!len)
+            break;
+        if (len->ast->token_type != TT_UINT)
+            h_platform_errx(1, "Length parser must return an unsigned integer");
+        uint64_t length = len->ast->uint;
+        h_arena_reset(scratch);
+        size_t avail = h_input_stream_length(&state->input_stream) -
+                       h_input_stream_pos(&state->input_stream);
+        if (width > 0 && length > avail / width)
+            break; // truncated record
+        h_skip_bits(&state->input_stream, length * width);
+        if (h_input_stream_pos(&state->input_stream) == h_input_stream_pos(&bak))
+            break; // empty records would repeat forever
+        if (n % stride == 0) {
+            if (nstarts == cap) {
+                for (size_t i = 0; i < cap / 2; i++)
+                    starts[i] = starts[2 * i];
+                nstarts = cap / 2;
+                stride *= 2;
+            }
+            if (n % stride == 0)
+                starts[nstarts++] = bak;
+        }
+        n++;
+    }
+    h_delete_arena(scratch);
+    if (n == 0) {
+        state->input_stream = begin;
+        return parse_many(&many, state);
+    }
+    state->input_stream = starts[0];
+
+    HRecordJob job = {mm__, mp->p, a_new_(state->memo_arena, HRecordBlock, nstarts)};
+    for (size_t blk = 0; blk < nstarts; blk++) {
+        job.blocks[blk].start = starts[blk];
+        job.blocks[blk].count = blk + 1 < nstarts ? stride : n - blk * stride;
+    }
+    if (!h_thread_pool_run(mp->pool, nstarts, parse_record_block, &job)) {
+        // the pool is busy, probably running us; parse in this thread
+        for (size_t blk = 0; blk < nstarts; blk++)
+            parse_record_block(&job, 0, blk);
+    }
+
+    // Stitch the blocks together up to the first record that failed.
+    size_t used = 0, nblocks = 0;
+    while (nblocks < nstarts) {
+        HRecordBlock *b = &job.blocks[nblocks++];
+        used += b->nok > 0 ? b->seq->used : 0;
+        if (b->nok < b->count)
+            break;
+    }
+    HCountedArray *seq = h_carray_new_sized(state->arena, used > 0 ? used : 4);
+    for (size_t blk = 0; blk < nstarts; blk++) {
+        HRecordBlock *b = &job.blocks[blk];
+        if (blk >= nblocks) {
+            h_delete_arena(b->arena);
+            continue;
+        }
+        h_arena_adopt(state->arena, b->arena);
+        if (b->nok == 0)
+            continue;
+        for (size_t i = 0; i < b->seq->used; i++)
+            h_carray_append(seq, b->seq->elements[i]);
+        state->input_stream = b->end;
+    }
+
+    HParsedToken *res = a_new(HParsedToken, 1);
+    res->token_type = TT_SEQUENCE;
+    res->seq = seq;
+    res->index = 0;
+    res->bit_length = 0;
+    res->bit_offset = 0;
+    return make_result(state->arena, res);
+}
+
+static void many_parallel_walk(void *env, HParserVisitFn visit, void *ctx) {
+    visit(((HManyParallel *)env)->p, ctx);
+}
+
+static void many_parallel_relocate(void **env, HRelocation *r) {
+    h_relocate_block(r, env, sizeof(HManyParallel));
+    HManyParallel *mp = (HManyParallel *)*env;
+    h_relocate_parser(r, &mp->p);
+    h_relocate_extern(r, &mp->pool);
+}
+
+const HParserVtable many_parallel_vt = {
+    .parse = parse_many_parallel,
+    .isValidRegular = h_false,
+    .isValidCF = h_false,
+    .higher = true,
+    .walk = many_parallel_walk,
+    .relocate = many_parallel_relocate,
+};
+
+HParser *h_many_parallel(HThreadPool *pool, const HParser *p) {
+    return h_many_parallel__m(&system_allocator, pool, p);
+}
+HParser *h_many_parallel__m(HAllocator *mm__, HThreadPool *pool, const HParser *p) {
+    HManyParallel *env = h_new(HManyParallel, 1);
+    env->pool = pool;
+    env->p = p;
+    return h_new_parser(mm__, &many_parallel_vt, env);
+}
@@ -11,11 +11,13 @@ static HParseResult *parse_not(void *env, HParseState *state) {
     return make_result(state->arena, NULL);
 }
 
-static const HParserVtable not_vt = {
+const HParserVtable not_vt = {
     .parse = parse_not,
     .isValidRegular = h_false, /* see and.c for why */
     .isValidCF = h_false,
     .higher = true,
+    .walk = walk_env_parser,
+    .relocate = relocate_env_parser,
 };
 
 HParser *h_not(const HParser *p) { return h_not__m(&system_allocator, p); }
@@ -12,12 +12,13 @@ static void desugar_nothing(HAllocator *mm__, HCFStack *stk__, void *env) {
     HCFS_END_CHOICE();
 }
 
-static const HParserVtable nothing_vt = {
+const HParserVtable nothing_vt = {
     .parse = parse_nothing,
     .isValidRegular = h_true,
     .isValidCF = h_true,
     .desugar = desugar_nothing,
     .higher = false,
+    .relocate = h_relocate_value,
 };
 
 HParser *h_nothing_p() { return h_nothing_p__m(&system_allocator); }
@@ -62,12 +62,14 @@ static void desugar_optional(HAllocator *mm__, HCFStack *stk__, void *env) {
     HCFS_END_CHOICE();
 }
 
-static const HParserVtable optional_vt = {
+const HParserVtable optional_vt = {
     .parse = parse_optional,
     .isValidRegular = opt_isValidRegular,
     .isValidCF = opt_isValidCF,
     .desugar = desugar_optional,
     .higher = true,
+    .walk = walk_env_parser,
+    .relocate = relocate_env_parser,
 };
 
 HParser *h_optional(const HParser *p) { return h_optional__m(&system_allocator, p); }
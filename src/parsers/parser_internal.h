@@ -35,6 +35,70 @@ static inline bool want_suspend(HParseState *state) {
     return state->input_stream.overrun && !state->input_stream.last_chunk;
 }
 
+/* Environments and vtables of the parsers that h_optimize rewrites. */
+
+struct HLiteralRun_;
+struct HLiteralTrie_;
+
+typedef struct {
+    size_t len;
+    HParser **p_array;
+    struct HLiteralRun_ **runs; // literal run starting at each element; see h_sequence_compile
+    size_t min_bits;            // input needed by the leading fixed-width elements
+} HSequence;
+
+typedef struct {
+    size_t len;
+    HParser **p_array;
+    HSequence *dispatch;        // alternatives worth trying by next byte; see h_choice_compile
+    struct HLiteralTrie_ *trie; // the literal alternatives, matched together
+} HChoice;
+
+typedef struct {
+    uint8_t *str;
+    uint8_t len;
+} HToken;
+
+// What an h_ch or h_token, possibly under h_ignore, matches and yields.
+typedef struct {
+    const uint8_t *str; // NULL for h_ch, whose byte is in byte
+    size_t len;
+    uint8_t byte;
+    bool ignored;     // under h_ignore, so no token
+    HParsedToken tok; // as parse_ch or parse_token would build it
+} HLiteral;
+
+static inline const uint8_t *h_literal_bytes(const HLiteral *lit) {
+    return lit->str ? lit->str : &lit->byte;
+}
+
+// Whether p only ever matches one fixed string; if so, describe it in *lit
+// unless that is NULL.
+bool h_as_literal(const HParser *p, HLiteral *lit);
+
+typedef struct HIndirectEnv_ {
+    const HParser *parser;
+    bool touched;
+} HIndirectEnv;
+
+// ch's env is the character itself, charset's the HCharset, ignore's the parser
+extern const HParserVtable ch_vt, charset_vt, token_vt, sequence_vt, choice_vt, ignore_vt,
+    indirect_vt;
+// the others, for images to refer to by number
+extern const HParserVtable action_vt, and_vt, attr_bool_vt, bind_vt, bits_vt, butnot_vt, bytes_vt,
+    difference_vt, end_vt, endianness_vt, epsilon_vt, ignoreseq_vt, int_range_vt, many_vt,
+    length_value_vt, many_parallel_vt, not_vt, nothing_vt, optional_vt, permutation_vt, skip_vt,
+    seek_vt, tell_vt, struct_vt, unimplemented_vt, put_value_vt, get_value_vt, free_value_vt,
+    whitespace_vt, xor_vt;
+
+/* walk() for combinators whose env is their only child parser. */
+static inline void walk_env_parser(void *env, HParserVisitFn visit, void *ctx) {
+    visit((const HParser *)env, ctx);
+}
+
+/* relocate() for combinators whose env is their only child parser. */
+static inline void relocate_env_parser(void **env, HRelocation *r) { h_relocate_parser(r, env); }
+
 /* Epsilon rules happen during desugaring. This handles them. */
 static inline void desugar_epsilon(HAllocator *mm__, HCFStack *stk__, void *env) {
     HCFS_BEGIN_CHOICE() {
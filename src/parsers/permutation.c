@@ -2,11 +2,6 @@
 
 #include <stdarg.h>
 
-typedef struct {
-    size_t len;
-    HParser **p_array;
-} HSequence;
-
 // main recursion, used by parse_permutation below
 static int parse_permutation_tail(const HSequence *s, HCountedArray *seq, const size_t k, char *set,
                                   HParseState *state) {
@@ -100,12 +95,28 @@ static HParseResult *parse_permutation(void *env, HParseState *state) {
     }
 }
 
-static const HParserVtable permutation_vt = {
+static void permutation_walk(void *env, HParserVisitFn visit, void *ctx) {
+    HSequence *s = (HSequence *)env;
+    for (size_t i = 0; i < s->len; ++i)
+        visit(s->p_array[i], ctx);
+}
+
+static void permutation_relocate(void **env, HRelocation *r) {
+    h_relocate_block(r, env, sizeof(HSequence));
+    HSequence *s = (HSequence *)*env;
+    h_relocate_block(r, &s->p_array, s->len * sizeof(HParser *));
+    for (size_t i = 0; i < s->len; ++i)
+        h_relocate_parser(r, &s->p_array[i]);
+}
+
+const HParserVtable permutation_vt = {
     .parse = parse_permutation,
     .isValidRegular = h_false,
     .isValidCF = h_false,
     .desugar = NULL,
     .higher = true,
+    .walk = permutation_walk,
+    .relocate = permutation_relocate,
 };
 
 HParser *h_permutation(HParser *p, ...) {
@@ -152,6 +163,8 @@ HParser *h_permutation__mv(HAllocator *mm__, HParser *p, va_list ap_) {
     va_end(ap);
 
     s->len = len;
+    s->runs = NULL;
+    s->min_bits = 0;
     return h_new_parser(mm__, &permutation_vt, s);
 }
 
@@ -173,11 +186,7 @@ HParser *h_permutation__ma(HAllocator *mm__, void *args[]) {
     }
 
     s->len = len;
-    HParser *ret = h_new(HParser, 1);
-    ret->vtable = &permutation_vt;
-    ret->env = (void *)s;
-    ret->backend = h_get_default_backend();
-    ret->backend_vtable = h_get_default_backend_vtable();
-    ret->desugared = NULL;
-    return ret;
+    s->runs = NULL;
+    s->min_bits = 0;
+    return h_new_parser(mm__, &permutation_vt, s);
 }
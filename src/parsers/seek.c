@@ -67,25 +67,32 @@ static HParseResult *parse_tell(void *env, HParseState *state) {
     return make_result(state->arena, tok);
 }
 
-static const HParserVtable skip_vt = {
+const HParserVtable skip_vt = {
     .parse = parse_skip,
     .isValidRegular = h_false,
     .isValidCF = h_false,
     .higher = false,
+    .relocate = h_relocate_value,
 };
 
-static const HParserVtable seek_vt = {
+static void seek_relocate(void **env, HRelocation *r) {
+    h_relocate_block(r, env, sizeof(HSeek));
+}
+
+const HParserVtable seek_vt = {
     .parse = parse_seek,
     .isValidRegular = h_false,
     .isValidCF = h_false,
     .higher = false,
+    .relocate = seek_relocate,
 };
 
-static const HParserVtable tell_vt = {
+const HParserVtable tell_vt = {
     .parse = parse_tell,
     .isValidRegular = h_false,
     .isValidCF = h_false,
     .higher = false,
+    .relocate = h_relocate_value,
 };
 
 HParser *h_skip(size_t n) { return h_skip__m(&system_allocator, n); }
@@ -2,16 +2,50 @@
 
 #include <assert.h>
 #include <stdarg.h>
+#include <string.h>
 
-typedef struct {
+// Two or more adjacent elements that each match one fixed string: h_ch and
+// h_token, possibly under h_ignore. On byte-aligned input the run is matched
+// with a single comparison and the elements' tokens are copied from tokens.
+typedef struct HLiteralRun_ {
+    size_t count; // elements covered
     size_t len;
-    HParser **p_array;
-} HSequence;
+    uint8_t *bytes;
+    size_t ntokens; // ignored elements contribute no token
+    HParsedToken *tokens;
+} HLiteralRun;
 
 static HParseResult *parse_sequence(void *env, HParseState *state) {
     HSequence *s = (HSequence *)env;
+    HInputStream *in = &state->input_stream;
+    // check once that there is room for the leading fixed-width elements,
+    // rather than finding out partway through
+    if (s->min_bits > 0 && h_input_stream_length(in) - h_input_stream_pos(in) < s->min_bits) {
+        in->overrun = true;
+        return NULL;
+    }
     HCountedArray *seq = h_carray_new_sized(state->arena, (s->len > 0) ? s->len : 4);
     for (size_t i = 0; i < s->len; ++i) {
+        // an instrumented parse calls the literals of a run one by one, as
+        // parse_choice does those of its trie, so that each call is counted
+        const HLiteralRun *run = s->runs && !state->options ? s->runs[i] : NULL;
+        // the literals read whole bytes in the default byte order; a run that
+        // leaves the current segment goes through the elements one by one
+        if (run && in->bit_offset == 0 && in->margin == 0 && in->endianness == DEFAULT_ENDIANNESS &&
+            run->len <= in->length - in->index) {
+            if (memcmp(in->input + in->index, run->bytes, run->len) != 0)
+                return NULL;
+            in->index += run->len;
+            h_input_stream_normalize(in);
+            if (run->ntokens > 0) {
+                HParsedToken *toks = a_new(HParsedToken, run->ntokens);
+                memcpy(toks, run->tokens, run->ntokens * sizeof(HParsedToken));
+                for (size_t k = 0; k < run->ntokens; k++)
+                    h_carray_append(seq, &toks[k]);
+            }
+            i += run->count - 1;
+            continue;
+        }
         HParseResult *tmp = h_do_parse(s->p_array[i], state);
         // if the interim parse fails, the whole thing fails
         if (NULL == tmp) {
@@ -84,14 +118,122 @@ static void desugar_sequence(HAllocator *mm__, HCFStack *stk__, void *env) {
     HCFS_END_CHOICE();
 }
 
-static const HParserVtable sequence_vt = {
+static bool sequence_width(void *env, size_t *bits) {
+    HSequence *s = (HSequence *)env;
+    size_t total = 0, w;
+    for (size_t i = 0; i < s->len; ++i) {
+        if (!h_fixed_width(s->p_array[i], &w) || w > SIZE_MAX - total)
+            return false;
+        total += w;
+    }
+    *bits = total;
+    return true;
+}
+
+static bool sequence_total(void *env) {
+    HSequence *s = (HSequence *)env;
+    for (size_t i = 0; i < s->len; ++i) {
+        HParser *p = s->p_array[i];
+        if (!p->vtable->total || !p->vtable->total(p->env))
+            return false;
+    }
+    return true;
+}
+
+static void sequence_walk(void *env, HParserVisitFn visit, void *ctx) {
+    HSequence *s = (HSequence *)env;
+    for (size_t i = 0; i < s->len; ++i)
+        visit(s->p_array[i], ctx);
+}
+
+static void sequence_relocate(void **env, HRelocation *r) {
+    h_relocate_block(r, env, sizeof(HSequence));
+    HSequence *s = (HSequence *)*env;
+    h_relocate_block(r, &s->p_array, s->len * sizeof(HParser *));
+    for (size_t i = 0; i < s->len; ++i)
+        h_relocate_parser(r, &s->p_array[i]);
+    if (!s->runs)
+        return;
+    // what h_compile found goes along
+    h_relocate_block(r, &s->runs, s->len * sizeof(HLiteralRun *));
+    for (size_t i = 0; i < s->len; ++i) {
+        if (!s->runs[i])
+            continue;
+        h_relocate_block(r, &s->runs[i], sizeof(HLiteralRun));
+        HLiteralRun *run = s->runs[i];
+        h_relocate_block(r, &run->bytes, run->len);
+        h_relocate_block(r, &run->tokens, run->ntokens * sizeof(HParsedToken));
+        for (size_t k = 0; k < run->ntokens; k++)
+            if (run->tokens[k].token_type == TT_BYTES)
+                h_relocate_block(r, &run->tokens[k].bytes.token, run->tokens[k].bytes.len);
+    }
+}
+
+const HParserVtable sequence_vt = {
     .parse = parse_sequence,
     .isValidRegular = sequence_isValidRegular,
     .isValidCF = sequence_isValidCF,
     .desugar = desugar_sequence,
     .higher = true,
+    .width = sequence_width,
+    .total = sequence_total,
+    .walk = sequence_walk,
+    .relocate = sequence_relocate,
 };
 
+static HLiteralRun *new_literal_run(HAllocator *mm__, HParser *const *elems, size_t count) {
+    HLiteralRun *run = h_new(HLiteralRun, 1);
+    HLiteral lit;
+
+    run->count = count;
+    run->len = 0;
+    run->ntokens = 0;
+    for (size_t i = 0; i < count; i++) {
+        h_as_literal(elems[i], &lit);
+        run->len += lit.len;
+        run->ntokens += !lit.ignored;
+    }
+    run->bytes = h_new(uint8_t, run->len > 0 ? run->len : 1);
+    run->tokens = h_new(HParsedToken, run->ntokens > 0 ? run->ntokens : 1);
+    for (size_t i = 0, pos = 0, k = 0; i < count; i++) {
+        h_as_literal(elems[i], &lit);
+        memcpy(run->bytes + pos, h_literal_bytes(&lit), lit.len);
+        pos += lit.len;
+        if (!lit.ignored)
+            run->tokens[k++] = lit.tok;
+    }
+    return run;
+}
+
+// Find the runs of literals in a sequence, for parse_sequence to match at
+// once, and the least input it needs.
+void h_sequence_compile(HAllocator *mm__, const HParser *p) {
+    if (p->vtable != &sequence_vt)
+        return;
+    HSequence *s = p->env;
+    size_t w;
+
+    if (s->runs || s->min_bits > 0)
+        return; // compiled before
+    // Only the leading fixed-width elements surely move forward by their
+    // widths; after an element without one, such as h_seek, the position may
+    // have moved back.
+    for (size_t i = 0; i < s->len && h_fixed_width(s->p_array[i], &w); i++)
+        if (w <= SIZE_MAX - s->min_bits)
+            s->min_bits += w;
+    for (size_t i = 0, j; i < s->len; i = j + 1) {
+        for (j = i; j < s->len && h_as_literal(s->p_array[j], NULL); j++)
+            ;
+        if (j - i < 2)
+            continue;
+        if (!s->runs) {
+            s->runs = h_new(HLiteralRun *, s->len);
+            memset(s->runs, 0, s->len * sizeof(HLiteralRun *));
+        }
+        s->runs[i] = new_literal_run(mm__, s->p_array + i, j - i);
+    }
+}
+
 HParser *h_sequence(HParser *p, ...) {
     va_list ap;
     va_start(ap, p);
@@ -113,6 +255,8 @@ HParser *h_sequence__v(HParser *p, va_list ap) { return h_sequence__mv(&system_a
 HParser *h_sequence__mv(HAllocator *mm__, HParser *p, va_list ap_) {
     HSequence *s = h_new(HSequence, 1);
     s->len = 0;
+    s->runs = NULL;
+    s->min_bits = 0;
 
     if (p) {
         // non-empty sequence
@@ -161,13 +305,9 @@ HParser *h_sequence__ma(HAllocator *mm__, void *args[]) {
     }
 
     s->len = len;
-    HParser *ret = h_new(HParser, 1);
-    ret->vtable = &sequence_vt;
-    ret->env = (void *)s;
-    ret->backend = h_get_default_backend();
-    ret->backend_vtable = h_get_default_backend_vtable();
-    ret->desugared = NULL;
-    return ret;
+    s->runs = NULL;
+    s->min_bits = 0;
+    return h_new_parser(mm__, &sequence_vt, s);
 }
 
 HParser *h_drop_from_(HParser *p, ...) {
@@ -218,6 +358,8 @@ HParser *h_drop_from___mv(HAllocator *mm__, HParser *p, va_list ap) {
     HSequence *rewrite = h_new(HSequence, 1);
     rewrite->p_array = h_new(HParser *, s->len);
     rewrite->len = s->len;
+    rewrite->runs = NULL;
+    rewrite->min_bits = 0;
     for (size_t i = 0, j = 0; i < s->len; ++i) {
         if (indices[j] == i) {
             rewrite->p_array[i] = h_ignore(s->p_array[i]);
@@ -239,6 +381,8 @@ HParser *h_drop_from___ma(HAllocator *mm__, void *args[]) {
     HSequence *rewrite = h_new(HSequence, 1);
     rewrite->p_array = h_new(HParser *, s->len);
     rewrite->len = s->len;
+    rewrite->runs = NULL;
+    rewrite->min_bits = 0;
 
     int i = 0, *argp = (int *)(args[1]);
     while (*argp >= 0) {
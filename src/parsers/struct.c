@@ -0,0 +1,123 @@
+#include "parser_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    HTokenType type;
+    size_t size, bits;
+    size_t nfields;
+    HStructField *fields; // sorted by offset
+} HStruct;
+
+static void store_field(uint8_t *dest, size_t size, int64_t v) {
+    switch (size) {
+    case 1: {
+        uint8_t x = (uint8_t)v;
+        memcpy(dest, &x, 1);
+        break;
+    }
+    case 2: {
+        uint16_t x = (uint16_t)v;
+        memcpy(dest, &x, 2);
+        break;
+    }
+    case 4: {
+        uint32_t x = (uint32_t)v;
+        memcpy(dest, &x, 4);
+        break;
+    }
+    default:
+        memcpy(dest, &v, 8);
+        break;
+    }
+}
+
+static HParseResult *parse_struct(void *env, HParseState *state) {
+    HStruct *s = (HStruct *)env;
+    HInputStream *in = &state->input_stream;
+
+    // one bounds check for the whole layout
+    if (h_input_stream_length(in) - h_input_stream_pos(in) < s->bits) {
+        in->overrun = true;
+        return NULL;
+    }
+
+    uint8_t *obj = a_new0(uint8_t, s->size > 0 ? s->size : 1);
+    HInputStream cur = *in;
+    size_t at = 0;
+    for (size_t i = 0; i < s->nfields; i++) {
+        const HStructField *f = &s->fields[i];
+        if (f->offset < at) { // overlaps the previous field
+            cur = *in;
+            at = 0;
+        }
+        if (f->offset > at)
+            h_skip_bits(&cur, f->offset - at);
+        cur.endianness = f->endianness;
+        store_field(obj + f->dest, f->size, h_read_bits(&cur, (int)f->bits, f->sign));
+        at = f->offset + f->bits;
+    }
+    h_skip_bits(in, s->bits);
+
+    HParsedToken *tok = a_new(HParsedToken, 1);
+    tok->token_type = s->type;
+    tok->user = obj;
+    tok->index = 0;
+    tok->bit_offset = 0;
+    tok->bit_length = 0;
+    return make_result(state->arena, tok);
+}
+
+static bool struct_width(void *env, size_t *bits) {
+    *bits = ((HStruct *)env)->bits;
+    return true;
+}
+
+static void struct_relocate(void **env, HRelocation *r) {
+    h_relocate_block(r, env, sizeof(HStruct));
+    HStruct *s = (HStruct *)*env;
+    h_relocate_block(r, &s->fields, s->nfields * sizeof(HStructField));
+}
+
+const HParserVtable struct_vt = {
+    .parse = parse_struct,
+    .isValidRegular = h_false,
+    .isValidCF = h_false,
+    .higher = false,
+    .width = struct_width,
+    .total = h_true,
+    .relocate = struct_relocate,
+};
+
+static int compare_offsets(const void *a, const void *b) {
+    const HStructField *x = a, *y = b;
+    return (x->offset > y->offset) - (x->offset < y->offset);
+}
+
+HParser *h_struct(HTokenType type, size_t size, size_t bits, const HStructField *fields,
+                  size_t nfields) {
+    return h_struct__m(&system_allocator, type, size, bits, fields, nfields);
+}
+HParser *h_struct__m(HAllocator *mm__, HTokenType type, size_t size, size_t bits,
+                     const HStructField *fields, size_t nfields) {
+    for (size_t i = 0; i < nfields; i++) {
+        const HStructField *f = &fields[i];
+        if (f->bits == 0 || f->bits > 64 || f->offset > bits || f->bits > bits - f->offset)
+            return NULL;
+        if ((f->size != 1 && f->size != 2 && f->size != 4 && f->size != 8) || f->dest > size ||
+            f->size > size - f->dest)
+            return NULL;
+    }
+
+    HStruct *s = h_new(HStruct, 1);
+    s->type = type;
+    s->size = size;
+    s->bits = bits;
+    s->nfields = nfields;
+    s->fields = h_new(HStructField, nfields > 0 ? nfields : 1);
+    if (nfields > 0)
+        memcpy(s->fields, fields, nfields * sizeof(HStructField));
+    qsort(s->fields, nfields, sizeof(HStructField), compare_offsets);
+    return h_new_parser(mm__, &struct_vt, s);
+}
@@ -2,11 +2,6 @@
 
 #include <assert.h>
 
-typedef struct {
-    uint8_t *str;
-    uint8_t len;
-} HToken;
-
 static HParseResult *parse_token(void *env, HParseState *state) {
     HToken *t = (HToken *)env;
     for (int i = 0; i < t->len; ++i) {
@@ -63,14 +58,60 @@ static void desugar_token(HAllocator *mm__, HCFStack *stk__, void *env) {
     HCFS_END_CHOICE();
 }
 
+static bool token_width(void *env, size_t *bits) {
+    *bits = (size_t)((HToken *)env)->len * 8;
+    return true;
+}
+
+static void token_relocate(void **env, HRelocation *r) {
+    h_relocate_block(r, env, sizeof(HToken));
+    HToken *t = (HToken *)*env;
+    h_relocate_block(r, &t->str, t->len);
+}
+
 const HParserVtable token_vt = {
     .parse = parse_token,
     .isValidRegular = h_true,
     .isValidCF = h_true,
     .desugar = desugar_token,
     .higher = false,
+    .width = token_width,
+    .relocate = token_relocate,
 };
 
+bool h_as_literal(const HParser *p, HLiteral *lit) {
+    bool ignored = false;
+    while (p->vtable == &ignore_vt) {
+        ignored = true;
+        p = p->env;
+    }
+    if (p->vtable != &ch_vt && p->vtable != &token_vt)
+        return false;
+    if (!lit)
+        return true;
+
+    lit->ignored = ignored;
+    lit->tok.index = 0;
+    lit->tok.bit_length = 0;
+    lit->tok.bit_offset = 0;
+    if (p->vtable == &ch_vt) {
+        lit->str = NULL;
+        lit->len = 1;
+        lit->byte = (uint8_t)(uintptr_t)p->env;
+        lit->tok.token_type = TT_UINT;
+        lit->tok.uint = lit->byte;
+    } else {
+        const HToken *t = p->env;
+        lit->str = t->str;
+        lit->len = t->len;
+        lit->byte = 0;
+        lit->tok.token_type = TT_BYTES;
+        lit->tok.bytes.token = t->str;
+        lit->tok.bytes.len = t->len;
+    }
+    return true;
+}
+
 HParser *h_token(const uint8_t *str, const size_t len) {
     return h_token__m(&system_allocator, str, len);
 }
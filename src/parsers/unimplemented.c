@@ -8,15 +8,16 @@ static HParseResult *parse_unimplemented(void *env, HParseState *state) {
     return &result;
 }
 
-static const HParserVtable unimplemented_vt = {
+const HParserVtable unimplemented_vt = {
     .parse = parse_unimplemented,
     .isValidRegular = h_false,
     .isValidCF = h_false,
     .desugar = NULL,
     .higher = true,
+    .relocate = h_relocate_value,
 };
 
-static HParser unimplemented = {.vtable = &unimplemented_vt, .env = NULL};
+static HParserPrivate unimplemented = {.parser = {.vtable = &unimplemented_vt, .env = NULL}};
 
-const HParser *h_unimplemented() { return &unimplemented; }
-const HParser *h_unimplemented__m(HAllocator *mm__) { return &unimplemented; }
+const HParser *h_unimplemented() { return &unimplemented.parser; }
+const HParser *h_unimplemented__m(HAllocator *mm__) { return &unimplemented.parser; }
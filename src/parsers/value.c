@@ -5,6 +5,8 @@
 
 #include "parser_internal.h"
 
+#include <string.h>
+
 typedef struct {
     const HParser *p;
     const char *key;
@@ -26,11 +28,27 @@ static HParseResult *parse_put(void *env, HParseState *state) {
     return NULL;
 }
 
-static const HParserVtable put_vt = {
+static void put_walk(void *env, HParserVisitFn visit, void *ctx) {
+    HStoredValue *s = (HStoredValue *)env;
+    if (s->p)
+        visit(s->p, ctx);
+}
+
+static void value_relocate(void **env, HRelocation *r) {
+    h_relocate_block(r, env, sizeof(HStoredValue));
+    HStoredValue *v = (HStoredValue *)*env;
+    if (v->key)
+        h_relocate_block(r, &v->key, strlen(v->key) + 1);
+    h_relocate_parser(r, &v->p);
+}
+
+const HParserVtable put_value_vt = {
     .parse = parse_put,
     .isValidRegular = h_false,
     .isValidCF = h_false,
     .higher = true,
+    .walk = put_walk,
+    .relocate = value_relocate,
 };
 
 HParser *h_put_value(const HParser *p, const char *name) {
@@ -41,7 +59,7 @@ HParser *h_put_value__m(HAllocator *mm__, const HParser *p, const char *name) {
     HStoredValue *env = h_new(HStoredValue, 1);
     env->p = p;
     env->key = name;
-    return h_new_parser(mm__, &put_vt, env);
+    return h_new_parser(mm__, &put_value_vt, env);
 }
 
 /* Retrieve a stashed result from the symbol table. */
@@ -55,11 +73,12 @@ static HParseResult *parse_get(void *env, HParseState *state) {
     }
 }
 
-static const HParserVtable get_vt = {
+const HParserVtable get_value_vt = {
     .parse = parse_get,
     .isValidRegular = h_false,
     .isValidCF = h_false,
     .higher = true,
+    .relocate = value_relocate,
 };
 
 HParser *h_get_value(const char *name) { return h_get_value__m(&system_allocator, name); }
@@ -68,7 +87,7 @@ HParser *h_get_value__m(HAllocator *mm__, const char *name) {
     HStoredValue *env = h_new(HStoredValue, 1);
     env->p = NULL;
     env->key = name;
-    return h_new_parser(mm__, &get_vt, env);
+    return h_new_parser(mm__, &get_value_vt, env);
 }
 
 /*
@@ -87,11 +106,12 @@ static HParseResult *parse_free(void *env, HParseState *state) {
     }
 }
 
-static const HParserVtable free_vt = {
+const HParserVtable free_value_vt = {
     .parse = parse_free,
     .isValidRegular = h_false,
     .isValidCF = h_false,
     .higher = true,
+    .relocate = value_relocate,
 };
 
 HParser *h_free_value(const char *name) { return h_free_value__m(&system_allocator, name); }
@@ -100,5 +120,5 @@ HParser *h_free_value__m(HAllocator *mm__, const char *name) {
     HStoredValue *env = h_new(HStoredValue, 1);
     env->p = NULL;
     env->key = name;
-    return h_new_parser(mm__, &free_vt, env);
+    return h_new_parser(mm__, &free_value_vt, env);
 }
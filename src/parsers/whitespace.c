@@ -56,12 +56,14 @@ static bool ws_isValidCF(void *env) {
     return p->vtable->isValidCF(p->env);
 }
 
-static const HParserVtable whitespace_vt = {
+const HParserVtable whitespace_vt = {
     .parse = parse_whitespace,
     .isValidRegular = ws_isValidRegular,
     .isValidCF = ws_isValidCF,
     .desugar = desugar_whitespace,
     .higher = false,
+    .walk = walk_env_parser,
+    .relocate = relocate_env_parser,
 };
 
 HParser *h_whitespace(const HParser *p) { return h_whitespace__m(&system_allocator, p); }
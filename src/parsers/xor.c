@@ -34,11 +34,26 @@ static HParseResult *parse_xor(void *env, HParseState *state) {
     }
 }
 
-static const HParserVtable xor_vt = {
+static void xor_walk(void *env, HParserVisitFn visit, void *ctx) {
+    HTwoParsers *parsers = (HTwoParsers *)env;
+    visit(parsers->p1, ctx);
+    visit(parsers->p2, ctx);
+}
+
+static void xor_relocate(void **env, HRelocation *r) {
+    h_relocate_block(r, env, sizeof(HTwoParsers));
+    HTwoParsers *parsers = (HTwoParsers *)*env;
+    h_relocate_parser(r, &parsers->p1);
+    h_relocate_parser(r, &parsers->p2);
+}
+
+const HParserVtable xor_vt = {
     .parse = parse_xor,
     .isValidRegular = h_false,
     .isValidCF = h_false, // XXX should this be true if both p1 and p2 are CF?
     .higher = true,
+    .walk = xor_walk,
+    .relocate = xor_relocate,
 };
 
 HParser *h_xor(const HParser *p1, const HParser *p2) { return h_xor__m(&system_allocator, p1, p2); }
@@ -1,10 +1,23 @@
 #define _GNU_SOURCE // to obtain asprintf/vasprintf
 #include "platform.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
 #include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
 
 int h_platform_asprintf(char **strp, const char *fmt, ...) {
     va_list ap;
@@ -27,6 +40,26 @@ void h_platform_errx(int err, const char *format, ...) {
     exit(err);
 }
 
+const void *h_platform_map_file(const char *path, size_t *len) {
+    struct stat st;
+    void *data = NULL;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    // an empty file cannot be mapped, and is no use to anyone
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+            data = NULL;
+        else
+            *len = (size_t)st.st_size;
+    }
+    close(fd);
+    return data;
+}
+
+void h_platform_unmap_file(const void *data, size_t len) { munmap((void *)data, len); }
+
 // TODO: replace this with a posix timer-based benchmark. (cf. timerfd_create, timer_create,
 // setitimer)
 
@@ -46,3 +79,137 @@ int64_t h_platform_stopwatch_ns(struct HStopWatch *stopwatch) {
     return (ts_now.tv_sec - stopwatch->start.tv_sec) * 1000000000 +
            (ts_now.tv_nsec - stopwatch->start.tv_nsec);
 }
+
+int64_t h_platform_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Performance counters: Linux perf_event where the kernel allows it, for the calling thread only.
+// The software events fall back to getrusage and the thread clock, so that they are counted on
+// any POSIX system; the hardware events have no fallback. getrusage counts for the thread where
+// the system has RUSAGE_THREAD, as Linux does, and for the whole process elsewhere.
+
+#ifdef __linux__
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} perf_events[H_PERF_NEVENTS] = {
+    [H_PERF_INSTRUCTIONS] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    [H_PERF_CYCLES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    [H_PERF_BRANCHES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS},
+    [H_PERF_BRANCH_MISSES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    [H_PERF_L1D_MISSES] = {PERF_TYPE_HW_CACHE,
+                           PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                               (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    [H_PERF_LLC_MISSES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    [H_PERF_TASK_CLOCK_NS] = {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+    [H_PERF_PAGE_FAULTS] = {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+    [H_PERF_CONTEXT_SWITCHES] = {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+};
+
+static int perf_open_attr(int event, bool exclude_kernel) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = perf_events[event].type;
+    attr.config = perf_events[event].config;
+    attr.disabled = 1;
+    attr.exclude_kernel = exclude_kernel;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+// Counting in the kernel takes perf_event_paranoid <= 1 or CAP_PERFMON, which most systems do not
+// grant, so it is only tried for the software events, whose cost is partly in the kernel, and
+// they go on to count user space alone when it is refused. Context switches only ever happen in
+// the kernel; without it they are left to the fallback.
+static int perf_open(int event) {
+    if (event <= H_PERF_HARDWARE)
+        return perf_open_attr(event, true);
+    int fd = perf_open_attr(event, false);
+    if (fd < 0 && errno == EACCES && event != H_PERF_CONTEXT_SWITCHES)
+        fd = perf_open_attr(event, true);
+    return fd;
+}
+#endif
+
+#ifdef RUSAGE_THREAD
+#define H_RUSAGE RUSAGE_THREAD
+#else
+#define H_RUSAGE RUSAGE_SELF
+#endif
+
+static void perf_fallback_sample(uint64_t values[H_PERF_NEVENTS]) {
+    struct rusage ru;
+    struct timespec ts;
+    getrusage(H_RUSAGE, &ru);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    values[H_PERF_TASK_CLOCK_NS] = (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+    values[H_PERF_PAGE_FAULTS] = (uint64_t)(ru.ru_minflt + ru.ru_majflt);
+    values[H_PERF_CONTEXT_SWITCHES] = (uint64_t)(ru.ru_nvcsw + ru.ru_nivcsw);
+}
+
+bool h_platform_perf_open(struct HPerfCounters *counters) {
+    bool hardware = false;
+    memset(counters, 0, sizeof(*counters));
+    for (int i = 0; i < H_PERF_NEVENTS; i++) {
+#ifdef __linux__
+        counters->fds[i] = perf_open(i);
+#else
+        counters->fds[i] = -1;
+#endif
+        if (i <= H_PERF_HARDWARE && counters->fds[i] >= 0)
+            hardware = true;
+    }
+    return hardware;
+}
+
+void h_platform_perf_start(struct HPerfCounters *counters) {
+    perf_fallback_sample(counters->started);
+#ifdef __linux__
+    for (int i = 0; i < H_PERF_NEVENTS; i++)
+        if (counters->fds[i] >= 0)
+            ioctl(counters->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+#endif
+}
+
+void h_platform_perf_stop(struct HPerfCounters *counters) {
+    uint64_t now[H_PERF_NEVENTS];
+#ifdef __linux__
+    for (int i = 0; i < H_PERF_NEVENTS; i++)
+        if (counters->fds[i] >= 0)
+            ioctl(counters->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+#endif
+    perf_fallback_sample(now);
+    for (int i = H_PERF_HARDWARE + 1; i < H_PERF_NEVENTS; i++)
+        counters->fallback[i] += now[i] - counters->started[i];
+}
+
+bool h_platform_perf_read(struct HPerfCounters *counters, int event, uint64_t *value) {
+    if (event < 0 || event >= H_PERF_NEVENTS)
+        return false;
+    if (counters->fds[event] < 0) {
+        *value = counters->fallback[event];
+        return event > H_PERF_HARDWARE;
+    }
+    // {value, time enabled, time running}: scale up if the kernel multiplexed the counter
+    uint64_t buf[3];
+    if (read(counters->fds[event], buf, sizeof(buf)) != (ssize_t)sizeof(buf))
+        return false;
+    if (buf[1] > 0 && buf[2] == 0)
+        return false; // enabled, but never got onto the PMU
+    *value = buf[2] < buf[1] ? (uint64_t)((double)buf[0] * (double)buf[1] / (double)buf[2])
+                             : buf[0];
+    return true;
+}
+
+void h_platform_perf_close(struct HPerfCounters *counters) {
+    for (int i = 0; i < H_PERF_NEVENTS; i++) {
+        if (counters->fds[i] >= 0)
+            close(counters->fds[i]);
+        counters->fds[i] = -1;
+    }
+}
@@ -9,6 +9,8 @@
 #include "compiler_specifics.h"
 
 #include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 /* String Formatting */
@@ -25,6 +27,14 @@ int h_platform_vasprintf(char **strp, const char *fmt, va_list arg);
 void h_platform_errx(int err, const char *format, ...)
     H_GCC_ATTRIBUTE((noreturn, format(printf, 2, 3)));
 
+/* Files */
+
+/* map a file read-only into memory; NULL on error */
+const void *h_platform_map_file(const char *path, size_t *len);
+
+/* undo h_platform_map_file */
+void h_platform_unmap_file(const void *data, size_t len);
+
 /* Time Measurement */
 
 struct HStopWatch; /* forward definition */
@@ -35,7 +45,45 @@ void h_platform_stopwatch_reset(struct HStopWatch *stopwatch);
 /* return difference between last reset point and now */
 int64_t h_platform_stopwatch_ns(struct HStopWatch *stopwatch);
 
-/* Platform dependent definitions for HStopWatch */
+/* monotonic wall-clock time in ns, cheap enough to take around every parser call */
+int64_t h_platform_time_ns(void);
+
+/* Performance Counters */
+
+/* the events an HPerfCounters counts, where the kernel and hardware allow */
+enum {
+    H_PERF_INSTRUCTIONS,
+    H_PERF_CYCLES,
+    H_PERF_BRANCHES,
+    H_PERF_BRANCH_MISSES,
+    H_PERF_L1D_MISSES, /* L1 data cache read misses */
+    H_PERF_LLC_MISSES, /* last level cache misses */
+    H_PERF_HARDWARE = H_PERF_LLC_MISSES,
+    /* software events: counted by the kernel, or failing that by getrusage and the thread clock,
+       so these are always available; getrusage counts the whole process where the system has no
+       RUSAGE_THREAD */
+    H_PERF_TASK_CLOCK_NS,
+    H_PERF_PAGE_FAULTS,
+    H_PERF_CONTEXT_SWITCHES,
+    H_PERF_NEVENTS
+};
+
+struct HPerfCounters; /* forward definition */
+
+/* open counters for the calling thread (see above for where getrusage falls short), stopped,
+   at zero; false if no hardware event is available */
+bool h_platform_perf_open(struct HPerfCounters *counters);
+
+/* resume and pause counting */
+void h_platform_perf_start(struct HPerfCounters *counters);
+void h_platform_perf_stop(struct HPerfCounters *counters);
+
+/* totals while started, per event; false for an event that could not be counted */
+bool h_platform_perf_read(struct HPerfCounters *counters, int event, uint64_t *value);
+
+void h_platform_perf_close(struct HPerfCounters *counters);
+
+/* Platform dependent definitions for HStopWatch and HPerfCounters */
 
 #include <time.h>
 
@@ -43,4 +91,11 @@ struct HStopWatch {
     struct timespec start;
 };
 
+struct HPerfCounters {
+    int fds[H_PERF_NEVENTS]; /* perf_event descriptors, -1 where not opened */
+    /* the software fallback: totals so far, and their values at the last start */
+    uint64_t fallback[H_PERF_NEVENTS];
+    uint64_t started[H_PERF_NEVENTS];
+};
+
 #endif
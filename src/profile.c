@@ -0,0 +1,225 @@
+/* Per-parser profiles of parse runs */
+
+#include "hammer.h"
+#include "internal.h"
+#include "parsers/parser_internal.h"
+#include "platform.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct HProfileRecord_ {
+    HProfileEntry entry;
+    size_t active; // calls in progress, for recursive parsers
+    uint64_t key;  // for h_profile_sort
+};
+
+// Unnamed parsers are shown by kind and address.
+static const struct {
+    const HParserVtable *vt;
+    const char *kind;
+} kinds[] = {
+    {&action_vt, "action"},
+    {&and_vt, "and"},
+    {&attr_bool_vt, "attr_bool"},
+    {&bind_vt, "bind"},
+    {&bits_vt, "bits"},
+    {&butnot_vt, "butnot"},
+    {&bytes_vt, "bytes"},
+    {&ch_vt, "ch"},
+    {&charset_vt, "charset"},
+    {&choice_vt, "choice"},
+    {&difference_vt, "difference"},
+    {&end_vt, "end"},
+    {&endianness_vt, "endianness"},
+    {&epsilon_vt, "epsilon"},
+    {&ignore_vt, "ignore"},
+    {&ignoreseq_vt, "ignoreseq"},
+    {&indirect_vt, "indirect"},
+    {&int_range_vt, "int_range"},
+    {&many_vt, "many"},
+    {&length_value_vt, "length_value"},
+    {&many_parallel_vt, "many_parallel"},
+    {&not_vt, "not"},
+    {&nothing_vt, "nothing"},
+    {&optional_vt, "optional"},
+    {&permutation_vt, "permutation"},
+    {&skip_vt, "skip"},
+    {&seek_vt, "seek"},
+    {&tell_vt, "tell"},
+    {&sequence_vt, "sequence"},
+    {&struct_vt, "struct"},
+    {&token_vt, "token"},
+    {&unimplemented_vt, "unimplemented"},
+    {&put_value_vt, "put_value"},
+    {&get_value_vt, "get_value"},
+    {&free_value_vt, "free_value"},
+    {&whitespace_vt, "whitespace"},
+    {&xor_vt, "xor"},
+};
+
+const char *h_parser_label(HArena *arena, const HParser *parser) {
+    const char *kind = "parser";
+    char buf[64];
+
+    const char *name = h_parser_private(parser)->name;
+    if (name)
+        return name;
+    for (size_t i = 0; i < sizeof(kinds) / sizeof(kinds[0]); i++) {
+        if (kinds[i].vt == parser->vtable)
+            kind = kinds[i].kind;
+    }
+    int n = snprintf(buf, sizeof(buf), "<%s %p>", kind, (const void *)parser);
+    char *copy = h_arena_malloc(arena, (size_t)n + 1);
+    memcpy(copy, buf, (size_t)n + 1);
+    return copy;
+}
+
+HProfile *h_profile_new(void) { return h_profile_new__m(&system_allocator); }
+HProfile *h_profile_new__m(HAllocator *mm__) {
+    HProfile *profile = h_new(HProfile, 1);
+    profile->mm__ = mm__;
+    profile->arena = h_new_arena(mm__, 0);
+    profile->records = h_hashtable_new(profile->arena, h_eq_ptr, h_hash_ptr);
+    profile->order = h_carray_new(profile->arena);
+    profile->current = NULL;
+    profile->child_ns = 0;
+    profile->child_arena = 0;
+    return profile;
+}
+
+void h_profile_free(HProfile *profile) {
+    HAllocator *mm__ = profile->mm__;
+    h_delete_arena(profile->arena);
+    h_free(profile);
+}
+
+size_t h_profile_count(const HProfile *profile) { return profile->order->used; }
+
+const HProfileEntry *h_profile_entry(const HProfile *profile, size_t i) {
+    if (i >= profile->order->used)
+        return NULL;
+    return &((HProfileRecord *)profile->order->elements[i])->entry;
+}
+
+// A parse that ran out of memory left its calls open.
+void h_profile_begin(HProfile *profile) {
+    for (size_t i = 0; i < profile->order->used; i++)
+        ((HProfileRecord *)profile->order->elements[i])->active = 0;
+    profile->current = NULL;
+    profile->child_ns = 0;
+    profile->child_arena = 0;
+}
+
+static size_t arena_used(const HParseState *state) {
+    HArenaStats stats;
+    h_allocator_stats(state->arena, &stats);
+    size_t used = stats.used;
+    if (state->memo_arena != state->arena) {
+        h_allocator_stats(state->memo_arena, &stats);
+        used += stats.used;
+    }
+    return used;
+}
+
+void h_profile_enter(HProfile *profile, const HParser *parser, HParseState *state,
+                     HProfileFrame *frame) {
+    HProfileRecord *rec = h_hashtable_get(profile->records, parser);
+    if (!rec) {
+        rec = h_arena_malloc(profile->arena, sizeof(HProfileRecord));
+        memset(rec, 0, sizeof(HProfileRecord));
+        rec->entry.parser = parser;
+        rec->entry.name = h_parser_label(profile->arena, parser);
+        h_hashtable_put(profile->records, parser, rec);
+        h_carray_append(profile->order, rec);
+    }
+    rec->active++;
+    frame->record = rec;
+    frame->outer = profile->current;
+    frame->outer_child_ns = profile->child_ns;
+    frame->outer_child_arena = profile->child_arena;
+    frame->start_pos = h_input_stream_pos(&state->input_stream);
+    frame->start_arena = arena_used(state);
+    profile->current = rec;
+    profile->child_ns = 0;
+    profile->child_arena = 0;
+    frame->start_ns = h_platform_time_ns();
+}
+
+void h_profile_exit(HProfile *profile, HParseState *state, HProfileFrame *frame, bool success) {
+    uint64_t ns = (uint64_t)(h_platform_time_ns() - frame->start_ns);
+    HProfileRecord *rec = frame->record;
+    HProfileEntry *e = &rec->entry;
+
+    e->calls++;
+    if (success) {
+        e->successes++;
+        e->bytes_consumed += (h_input_stream_pos(&state->input_stream) - frame->start_pos) / 8;
+    } else {
+        e->failures++;
+    }
+    if (--rec->active == 0)
+        e->inclusive_ns += ns;
+    e->exclusive_ns += ns > profile->child_ns ? ns - profile->child_ns : 0;
+    size_t used = arena_used(state);
+    size_t grew = used > frame->start_arena ? used - frame->start_arena : 0;
+    e->arena_bytes += grew;
+    e->arena_exclusive_bytes += grew > profile->child_arena ? grew - profile->child_arena : 0;
+
+    profile->current = frame->outer;
+    profile->child_ns = frame->outer_child_ns + ns;
+    profile->child_arena = frame->outer_child_arena + grew;
+}
+
+void h_profile_memo(HProfile *profile, bool hit) {
+    if (hit)
+        profile->current->entry.memo_hits++;
+    else
+        profile->current->entry.memo_misses++;
+}
+
+static uint64_t sort_key(const HProfileEntry *e, HProfileSort by) {
+    switch (by) {
+    case H_PROFILE_BY_INCLUSIVE:
+        return e->inclusive_ns;
+    case H_PROFILE_BY_CALLS:
+        return e->calls;
+    case H_PROFILE_BY_ARENA:
+        return e->arena_bytes;
+    case H_PROFILE_BY_ARENA_EXCLUSIVE:
+        return e->arena_exclusive_bytes;
+    default:
+        return e->exclusive_ns;
+    }
+}
+
+static int cmp_records(const void *a, const void *b) {
+    uint64_t x = (*(HProfileRecord *const *)a)->key;
+    uint64_t y = (*(HProfileRecord *const *)b)->key;
+    return (x < y) - (x > y);
+}
+
+void h_profile_sort(HProfile *profile, HProfileSort by) {
+    for (size_t i = 0; i < profile->order->used; i++) {
+        HProfileRecord *rec = (HProfileRecord *)profile->order->elements[i];
+        rec->key = sort_key(&rec->entry, by);
+    }
+    qsort(profile->order->elements, profile->order->used, sizeof(void *), cmp_records);
+}
+
+void h_profile_report(FILE *stream, HProfile *profile, HProfileSort by) {
+    h_profile_sort(profile, by);
+    fprintf(stream, "%-32s %10s %10s %10s %10s %10s %12s %12s %10s %10s %10s\n", "parser",
+            "calls", "ok", "failed", "memo hits", "misses", "incl us", "excl us", "bytes", "arena",
+            "excl arena");
+    for (size_t i = 0; i < profile->order->used; i++) {
+        const HProfileEntry *e = &((HProfileRecord *)profile->order->elements[i])->entry;
+        fprintf(stream,
+                "%-32s %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64
+                " %12.1f %12.1f %10" PRIu64 " %10" PRIu64 " %10" PRIu64 "\n",
+                e->name, e->calls, e->successes, e->failures, e->memo_hits, e->memo_misses,
+                e->inclusive_ns / 1e3, e->exclusive_ns / 1e3, e->bytes_consumed, e->arena_bytes,
+                e->arena_exclusive_bytes);
+    }
+}
@@ -17,9 +17,10 @@
 
 #include "hammer.h"
 #include "internal.h"
-#include "tsearch.h"
 
-#include <stdlib.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
 
 #if defined(_MSC_VER)
 #define h_strdup _strdup
@@ -27,11 +28,26 @@
 #define h_strdup strdup
 #endif
 
-static void *tt_registry = NULL;
-static HTTEntry **tt_by_id = NULL;
-static unsigned int tt_by_id_sz = 0;
+// Readers (h_get_token_type_*) never lock: entries, id buckets and name
+// tables are published with release stores and are never moved or freed
+// once visible. Writers serialize on tt_lock. A replaced name table is kept
+// on its successor's retired list, since a reader may still be probing it.
+
 #define TT_START TT_USER
+#define TT_BUCKETS 27 // bucket b holds TT_BUCKET0 << b entries
+#define TT_BUCKET0 16
+
+typedef struct HTTIndex_ {
+    size_t capacity; // power of two
+    size_t used;
+    struct HTTIndex_ *retired;
+    HTTEntry *slots[];
+} HTTIndex;
+
+static HTTEntry **tt_by_id[TT_BUCKETS];
+static HTTIndex *tt_index = NULL;
 static HTokenType tt_next = TT_START;
+static pthread_mutex_t tt_lock = PTHREAD_MUTEX_INITIALIZER;
 
 /*
   // TODO: These are for the extension registry, which does not yet have a good name.
@@ -41,9 +57,72 @@ static int ext_by_id_sz = 0;
 static int ext_next = 0;
 */
 
-static int compare_entries(const void *v1, const void *v2) {
-    const HTTEntry *e1 = (HTTEntry *)v1, *e2 = (HTTEntry *)v2;
-    return strcmp(e1->name, e2->name);
+static size_t name_hash(const char *name) {
+    size_t h = 2166136261u; // FNV-1a
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++)
+        h = (h ^ *p) * 16777619u;
+    return h;
+}
+
+// Map an id offset to its bucket and the slot within it.
+static HTTEntry **id_slot(size_t n, bool create) {
+    size_t b = 0, first = 0;
+    while (n - first >= ((size_t)TT_BUCKET0 << b)) {
+        first += (size_t)TT_BUCKET0 << b;
+        if (++b == TT_BUCKETS)
+            return NULL;
+    }
+    HTTEntry **bucket = __atomic_load_n(&tt_by_id[b], __ATOMIC_ACQUIRE);
+    if (!bucket && create) {
+        HAllocator *mm__ = &system_allocator;
+        bucket = h_new(HTTEntry *, (size_t)TT_BUCKET0 << b);
+        memset(bucket, 0, sizeof(HTTEntry *) * ((size_t)TT_BUCKET0 << b));
+        __atomic_store_n(&tt_by_id[b], bucket, __ATOMIC_RELEASE);
+    }
+    return bucket ? &bucket[n - first] : NULL;
+}
+
+static HTTEntry *index_find(const HTTIndex *idx, const char *name, size_t hash) {
+    if (!idx)
+        return NULL;
+    size_t mask = idx->capacity - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        HTTEntry *e = __atomic_load_n(&idx->slots[i], __ATOMIC_ACQUIRE);
+        if (!e)
+            return NULL;
+        if (strcmp(e->name, name) == 0)
+            return e;
+    }
+}
+
+static void index_put(HTTIndex *idx, HTTEntry *entry) {
+    size_t mask = idx->capacity - 1;
+    size_t i = name_hash(entry->name) & mask;
+    while (idx->slots[i])
+        i = (i + 1) & mask;
+    __atomic_store_n(&idx->slots[i], entry, __ATOMIC_RELEASE);
+    idx->used++;
+}
+
+// Called with tt_lock held.
+static void index_insert(HTTEntry *entry) {
+    HTTIndex *idx = tt_index;
+    if (!idx || (idx->used + 1) * 2 > idx->capacity) {
+        HAllocator *mm__ = &system_allocator;
+        size_t capacity = idx ? idx->capacity * 2 : 64;
+        HTTIndex *grown = h_alloc(mm__, sizeof(HTTIndex) + capacity * sizeof(HTTEntry *));
+        grown->capacity = capacity;
+        grown->used = 0;
+        grown->retired = idx;
+        memset(grown->slots, 0, capacity * sizeof(HTTEntry *));
+        if (idx)
+            for (size_t i = 0; i < idx->capacity; i++)
+                if (idx->slots[i])
+                    index_put(grown, idx->slots[i]);
+        __atomic_store_n(&tt_index, grown, __ATOMIC_RELEASE);
+        idx = grown;
+    }
+    index_put(idx, entry);
 }
 
 static void default_unamb_sub(const HParsedToken *tok, struct result_buf *buf) {
@@ -54,63 +133,50 @@ HTokenType h_allocate_token_new(const char *name,
                                 void (*unamb_sub)(const HParsedToken *tok, struct result_buf *buf),
                                 void (*pprint)(FILE *stream, const HParsedToken *tok, int indent,
                                                int delta)) {
-    HTTEntry *new_entry = h_alloc(&system_allocator, sizeof(*new_entry));
-    assert(new_entry != NULL);
-    new_entry->name = name;
-    new_entry->value = 0;
-    new_entry->unamb_sub = unamb_sub ? unamb_sub : default_unamb_sub;
-    new_entry->pprint = pprint;
-    HTTEntry *probe = *(HTTEntry **)tsearch(new_entry, &tt_registry, compare_entries);
-    if (probe->value != 0) {
+    HTokenType value = h_get_token_type_number(name);
+    if (value != 0) {
         // Token type already exists...
         // TODO: treat this as a bug?
-        (&system_allocator)->free(&system_allocator, new_entry);
-        return probe->value;
-    } else {
-        // new value
-        probe->name = h_strdup(probe->name); // drop ownership of name
-        probe->value = tt_next++;
-        if ((probe->value - TT_START) >= tt_by_id_sz) {
-            if (tt_by_id_sz == 0) {
-                tt_by_id = malloc(sizeof(*tt_by_id) * ((tt_by_id_sz = (tt_next - TT_START) * 16)));
-            } else {
-                HTTEntry **temp = realloc(tt_by_id, sizeof(*tt_by_id) * ((tt_by_id_sz *= 2)));
-                if (!temp) {
-                    free(tt_by_id);
-                    return TT_INVALID;
-                }
-                tt_by_id = temp;
-            }
-            if (!tt_by_id) {
-                return TT_INVALID;
-            }
-        }
-        assert(probe->value - TT_START < tt_by_id_sz);
-        tt_by_id[probe->value - TT_START] = probe;
+        return value;
+    }
+
+    pthread_mutex_lock(&tt_lock);
+    HTTEntry *probe = index_find(tt_index, name, name_hash(name));
+    if (probe) {
+        // lost a race with another thread registering the same name
+        pthread_mutex_unlock(&tt_lock);
         return probe->value;
     }
+    HTTEntry **slot = id_slot(tt_next - TT_START, true);
+    if (!slot) {
+        pthread_mutex_unlock(&tt_lock);
+        return TT_INVALID;
+    }
+    HTTEntry *new_entry = h_alloc(&system_allocator, sizeof(*new_entry));
+    new_entry->name = h_strdup(name); // drop ownership of name
+    new_entry->value = tt_next;
+    new_entry->unamb_sub = unamb_sub ? unamb_sub : default_unamb_sub;
+    new_entry->pprint = pprint;
+    __atomic_store_n(slot, new_entry, __ATOMIC_RELEASE);
+    index_insert(new_entry);
+    __atomic_store_n(&tt_next, tt_next + 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&tt_lock);
+    return new_entry->value;
 }
 HTokenType h_allocate_token_type(const char *name) {
     return h_allocate_token_new(name, NULL, NULL);
 }
 HTokenType h_get_token_type_number(const char *name) {
-    HTTEntry e;
-    e.name = name;
-    HTTEntry **ret = (HTTEntry **)tfind(&e, &tt_registry, compare_entries);
-    if (ret == NULL)
-        return 0;
-    else
-        return (*ret)->value;
+    HTTIndex *idx = __atomic_load_n(&tt_index, __ATOMIC_ACQUIRE);
+    HTTEntry *e = index_find(idx, name, name_hash(name));
+    return e ? e->value : 0;
 }
 const char *h_get_token_type_name(HTokenType token_type) {
-    if (token_type >= tt_next || token_type < TT_START)
-        return NULL;
-    else
-        return tt_by_id[token_type - TT_START]->name;
+    const HTTEntry *e = h_get_token_type_entry(token_type);
+    return e ? e->name : NULL;
 }
 const HTTEntry *h_get_token_type_entry(HTokenType token_type) {
-    if (token_type >= tt_next || token_type < TT_START)
+    if (token_type >= __atomic_load_n(&tt_next, __ATOMIC_ACQUIRE) || token_type < TT_START)
         return NULL;
-    else
-        return tt_by_id[token_type - TT_START];
+    return *id_slot(token_type - TT_START, false);
 }
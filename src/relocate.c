@@ -0,0 +1,205 @@
+/* Relocation of parser graphs into one contiguous block */
+
+#include "hammer.h"
+#include "internal.h"
+
+#include <string.h>
+
+#define RELOC_ALIGN 16
+#define ALIGN_UP(n) (((n) + RELOC_ALIGN - 1) & ~(size_t)(RELOC_ALIGN - 1))
+
+// The block starts with this, followed by the parsers, root first, and then
+// their environments in the same order.
+typedef struct {
+    HAllocator *mm__;
+    size_t size;
+    size_t count; // parsers
+} HRelocatedHeader;
+
+struct HRelocation_ {
+    HArena *arena;        // scratch
+    HHashTable *moved;    // original parser -> copy
+    HHashTable *interned; // contents -> copy, for h_relocate_shared
+    uint8_t *block;       // NULL while measuring
+    size_t used;
+    // where the block holds pointers, if the caller asked; see h_relocate_logged
+    HCountedArray *internal, *data, *functions;
+};
+
+typedef struct {
+    const void *data;
+    size_t size;
+} HInternKey;
+
+static bool intern_eq(const void *a, const void *b) {
+    const HInternKey *x = a, *y = b;
+    return x->size == y->size && memcmp(x->data, y->data, x->size) == 0;
+}
+
+static HHashValue intern_hash(const void *key) {
+    const HInternKey *k = key;
+    return h_djbhash(k->data, k->size);
+}
+
+#define NODES_OFFSET ALIGN_UP(sizeof(HRelocatedHeader))
+
+// Note the offset from the first parser of a pointer slot in the block.
+static void note(HRelocation *r, HCountedArray *slots, void *slot) {
+    if (r->block && slots)
+        h_carray_append(slots, (void *)(uintptr_t)((uint8_t *)slot - (r->block + NODES_OFFSET)));
+}
+
+void h_relocate_block(HRelocation *r, void *slot, size_t size) {
+    void **field = slot;
+    void *copy;
+
+    if (!*field)
+        return;
+    note(r, r->internal, slot);
+    // while measuring, copy to scratch memory so that the caller can go on
+    // to relocate what the copy points to
+    if (r->block)
+        copy = r->block + r->used;
+    else
+        copy = h_arena_malloc_noinit(r->arena, size > 0 ? size : 1);
+    memcpy(copy, *field, size);
+    r->used += ALIGN_UP(size);
+    *field = copy;
+}
+
+void h_relocate_shared(HRelocation *r, void *slot, size_t size) {
+    void **field = slot;
+    HInternKey key = {*field, size};
+
+    if (!*field)
+        return;
+    void *copy = h_hashtable_get(r->interned, &key);
+    if (copy) {
+        note(r, r->internal, slot);
+        *field = copy;
+        return;
+    }
+    h_relocate_block(r, slot, size);
+    HInternKey *k = h_arena_malloc(r->arena, sizeof(HInternKey));
+    k->data = *field;
+    k->size = size;
+    h_hashtable_put(r->interned, k, *field);
+}
+
+void h_relocate_alias(HRelocation *r, void *slot, const void *other) {
+    void **field = slot;
+    *field = *(void *const *)other;
+    if (*field)
+        note(r, r->internal, slot);
+}
+
+void h_relocate_parser(HRelocation *r, void *slot) {
+    const HParser **field = slot;
+    if (r->block && *field) {
+        HParser *copy = h_hashtable_get(r->moved, *field);
+        assert(copy != NULL);
+        note(r, r->internal, slot);
+        *field = copy;
+    }
+}
+
+void h_relocate_extern(HRelocation *r, void *slot) {
+    if (*(void **)slot)
+        note(r, r->data, slot);
+}
+
+void h_relocate_function(HRelocation *r, void *slot) {
+    void (*fn)(void);
+    memcpy(&fn, slot, sizeof(fn));
+    if (fn)
+        note(r, r->functions, slot);
+}
+
+void h_relocate_value(void **env, HRelocation *r) {}
+
+static void collect(const HParser *p, void *ctx) { h_carray_append(ctx, (void *)p); }
+
+HParser *h_relocate(const HParser *parser) { return h_relocate__m(&system_allocator, parser); }
+HParser *h_relocate__m(HAllocator *mm__, const HParser *parser) {
+    return h_relocate_logged(mm__, parser, NULL);
+}
+
+HParser *h_relocate_logged(HAllocator *mm__, const HParser *parser, HRelocationLog *log) {
+    HArena *arena = h_new_arena(mm__, 0);
+    HCountedArray *order = h_carray_new(arena);
+    HRelocation r = {arena, h_hashtable_new(arena, h_eq_ptr, h_hash_ptr),
+                     h_hashtable_new(arena, intern_eq, intern_hash), NULL, 0, NULL, NULL, NULL};
+    if (log) {
+        r.internal = log->internal;
+        r.data = log->data;
+        r.functions = log->functions;
+    }
+
+    h_walk_parsers(mm__, parser, collect, order);
+    size_t n = order->used;
+    for (size_t i = 0; i < n; i++) {
+        if (!((HParser *)order->elements[i])->vtable->relocate) {
+            h_delete_arena(arena);
+            return NULL;
+        }
+    }
+
+    // measure
+    r.used = NODES_OFFSET + ALIGN_UP(n * sizeof(HParserPrivate));
+    for (size_t i = 0; i < n; i++) {
+        const HParser *p = (const HParser *)order->elements[i];
+        void *env = p->env;
+        const char *name = h_parser_private(p)->name;
+        p->vtable->relocate(&env, &r);
+        if (name)
+            h_relocate_block(&r, &name, strlen(name) + 1);
+    }
+    size_t size = r.used;
+
+    HParserPrivate *nodes = h_parser_private(h_relocated_new(mm__, size - NODES_OFFSET, n));
+    uint8_t *block = (uint8_t *)nodes - NODES_OFFSET;
+
+    // the walk puts children before parents; lay them out the other way
+    for (size_t k = 0; k < n; k++) {
+        const HParser *p = (const HParser *)order->elements[n - 1 - k];
+        nodes[k] = *h_parser_private(p);
+        nodes[k].parser.desugared = NULL;
+        h_hashtable_put(r.moved, p, &nodes[k].parser);
+    }
+    // the second pass has to make the same choices as the first
+    r.interned = h_hashtable_new(arena, intern_eq, intern_hash);
+    r.block = block;
+    r.used = NODES_OFFSET + ALIGN_UP(n * sizeof(HParserPrivate));
+    for (size_t k = 0; k < n; k++) {
+        nodes[k].parser.vtable->relocate(&nodes[k].parser.env, &r);
+        if (nodes[k].name)
+            h_relocate_block(&r, &nodes[k].name, strlen(nodes[k].name) + 1);
+    }
+    assert(r.used == size);
+
+    h_delete_arena(arena);
+    return &nodes[0].parser;
+}
+
+HParser *h_relocated_new(HAllocator *mm__, size_t size, size_t count) {
+    uint8_t *block = h_alloc(mm__, NODES_OFFSET + size);
+    HRelocatedHeader *hdr = (HRelocatedHeader *)block;
+    hdr->mm__ = mm__;
+    hdr->size = NODES_OFFSET + size;
+    hdr->count = count;
+    return (HParser *)(block + NODES_OFFSET);
+}
+
+size_t h_relocated_size(const HParser *parser, size_t *count) {
+    const HRelocatedHeader *hdr =
+        (const HRelocatedHeader *)((const uint8_t *)parser - NODES_OFFSET);
+    if (count)
+        *count = hdr->count;
+    return hdr->size - NODES_OFFSET;
+}
+
+void h_relocated_free(HParser *parser) {
+    HRelocatedHeader *hdr = (HRelocatedHeader *)((uint8_t *)parser - NODES_OFFSET);
+    HAllocator *mm__ = hdr->mm__;
+    h_free(hdr);
+}
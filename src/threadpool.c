@@ -0,0 +1,221 @@
+/* Work-stealing thread pool for parallel parsing */
+
+#include "hammer.h"
+#include "internal.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+// Each worker owns a range [begin, end) of item indices, packed into one
+// 64-bit word so that it can be updated with a single compare-and-swap. The
+// owner takes items from the front; thieves take the back half. Ranges only
+// ever shrink or move between workers, so a stale snapshot never compares
+// equal to a newer value within one job.
+#define RANGE(b, e) (((uint64_t)(b) << 32) | (uint64_t)(e))
+#define RANGE_BEGIN(r) ((size_t)((r) >> 32))
+#define RANGE_END(r) ((size_t)((r)&0xFFFFFFFFu))
+#define MAX_ROUND ((size_t)0xFFFFFFFFu)
+
+typedef struct {
+    uint64_t range;
+    char pad[64 - sizeof(uint64_t)]; // keep queues on separate cache lines
+} HWorkQueue;
+
+struct HThreadPool_ {
+    HAllocator *mm__;
+    size_t nthreads; // workers, including the thread calling h_thread_pool_run
+    pthread_t *threads;
+    HWorkQueue *queues;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    uint64_t generation; // incremented for every job
+    size_t running;      // helper threads still busy with the current job
+    bool shutdown;
+    bool busy; // a job is in progress; guards against nested runs
+
+    // the current job
+    HWorkFn work;
+    void *ctx;
+    size_t base;
+};
+
+typedef struct {
+    HThreadPool *pool;
+    size_t id;
+} HWorkerArg;
+
+static bool pop_item(HWorkQueue *q, size_t *item) {
+    uint64_t r = __atomic_load_n(&q->range, __ATOMIC_ACQUIRE);
+    for (;;) {
+        size_t b = RANGE_BEGIN(r), e = RANGE_END(r);
+        if (b >= e)
+            return false;
+        if (__atomic_compare_exchange_n(&q->range, &r, RANGE(b + 1, e), false, __ATOMIC_ACQ_REL,
+                                        __ATOMIC_ACQUIRE)) {
+            *item = b;
+            return true;
+        }
+    }
+}
+
+static bool steal_item(HThreadPool *pool, size_t id, size_t *item) {
+    for (size_t k = 1; k < pool->nthreads; k++) {
+        HWorkQueue *victim = &pool->queues[(id + k) % pool->nthreads];
+        uint64_t r = __atomic_load_n(&victim->range, __ATOMIC_ACQUIRE);
+        for (;;) {
+            size_t b = RANGE_BEGIN(r), e = RANGE_END(r);
+            if (b >= e)
+                break;
+            size_t mid = b + (e - b) / 2; // thief gets [mid, e)
+            if (__atomic_compare_exchange_n(&victim->range, &r, RANGE(b, mid), false,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                // keep the first stolen item, queue the rest as our own
+                *item = mid;
+                __atomic_store_n(&pool->queues[id].range, RANGE(mid + 1, e), __ATOMIC_RELEASE);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static void run_worker(HThreadPool *pool, size_t id) {
+    size_t item;
+    while (pop_item(&pool->queues[id], &item) || steal_item(pool, id, &item))
+        pool->work(pool->ctx, id, pool->base + item);
+}
+
+static void *worker_main(void *arg) {
+    HWorkerArg *wa = arg;
+    HThreadPool *pool = wa->pool;
+    size_t id = wa->id;
+    uint64_t seen = 0;
+    HAllocator *mm__ = pool->mm__;
+
+    h_free(wa);
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->generation == seen && !pool->shutdown)
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        if (pool->shutdown) {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        run_worker(pool, id);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->running == 0)
+            pthread_cond_signal(&pool->done);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+HThreadPool *h_thread_pool_new(size_t nthreads) {
+    return h_thread_pool_new__m(&system_allocator, nthreads);
+}
+HThreadPool *h_thread_pool_new__m(HAllocator *mm__, size_t nthreads) {
+    if (nthreads == 0) {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = ncpu > 0 ? (size_t)ncpu : 1;
+    }
+
+    HThreadPool *pool = h_new(HThreadPool, 1);
+    pool->mm__ = mm__;
+    pool->threads = h_new(pthread_t, nthreads);
+    pool->queues = h_new(HWorkQueue, nthreads);
+    memset(pool->queues, 0, nthreads * sizeof(HWorkQueue));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->generation = 0;
+    pool->running = 0;
+    pool->shutdown = false;
+    pool->busy = false;
+    pool->work = NULL;
+    pool->ctx = NULL;
+    pool->base = 0;
+
+    // worker 0 is whoever calls h_thread_pool_run
+    pool->nthreads = 1;
+    for (size_t i = 1; i < nthreads; i++) {
+        HWorkerArg *wa = h_new(HWorkerArg, 1);
+        wa->pool = pool;
+        wa->id = i;
+        if (pthread_create(&pool->threads[i], NULL, worker_main, wa) != 0) {
+            h_free(wa);
+            break; // run with the threads we got
+        }
+        pool->nthreads++;
+    }
+    return pool;
+}
+
+size_t h_thread_pool_size(const HThreadPool *pool) { return pool->nthreads; }
+
+bool h_thread_pool_run(HThreadPool *pool, size_t n, HWorkFn work, void *ctx) {
+    size_t base = 0;
+    bool idle = false;
+
+    // a worker calling back into its own pool would wait for itself
+    if (!__atomic_compare_exchange_n(&pool->busy, &idle, true, false, __ATOMIC_ACQUIRE,
+                                     __ATOMIC_RELAXED))
+        return false;
+
+    while (base < n) {
+        size_t count = n - base;
+        if (count > MAX_ROUND)
+            count = MAX_ROUND;
+
+        // deal the items out evenly; stealing evens out the rest
+        for (size_t i = 0; i < pool->nthreads; i++) {
+            size_t b = count * i / pool->nthreads;
+            size_t e = count * (i + 1) / pool->nthreads;
+            __atomic_store_n(&pool->queues[i].range, RANGE(b, e), __ATOMIC_RELAXED);
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        pool->work = work;
+        pool->ctx = ctx;
+        pool->base = base;
+        pool->running = pool->nthreads - 1;
+        pool->generation++;
+        pthread_cond_broadcast(&pool->wake);
+        pthread_mutex_unlock(&pool->lock);
+
+        run_worker(pool, 0);
+
+        pthread_mutex_lock(&pool->lock);
+        while (pool->running > 0)
+            pthread_cond_wait(&pool->done, &pool->lock);
+        pthread_mutex_unlock(&pool->lock);
+
+        base += count;
+    }
+    __atomic_store_n(&pool->busy, false, __ATOMIC_RELEASE);
+    return true;
+}
+
+void h_thread_pool_free(HThreadPool *pool) {
+    HAllocator *mm__ = pool->mm__;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    for (size_t i = 1; i < pool->nthreads; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+    pthread_cond_destroy(&pool->done);
+    h_free(pool->queues);
+    h_free(pool->threads);
+    h_free(pool);
+}
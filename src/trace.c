@@ -0,0 +1,224 @@
+/* Traces of parser calls, for timelines and flame graphs */
+
+#include "hammer.h"
+#include "internal.h"
+
+#include <inttypes.h>
+#include <string.h>
+
+HTrace *h_trace_new(size_t capacity) { return h_trace_new__m(&system_allocator, capacity); }
+HTrace *h_trace_new__m(HAllocator *mm__, size_t capacity) {
+    size_t size = 1;
+    while (size < capacity)
+        size *= 2;
+
+    HTrace *trace = h_new(HTrace, 1);
+    trace->mm__ = mm__;
+    trace->events = h_new(HTraceEvent, size);
+    trace->mask = size - 1;
+    trace->head = 0;
+    return trace;
+}
+
+void h_trace_free(HTrace *trace) {
+    HAllocator *mm__ = trace->mm__;
+    h_free(trace->events);
+    h_free(trace);
+}
+
+void h_trace_clear(HTrace *trace) { trace->head = 0; }
+
+size_t h_trace_dropped(const HTrace *trace) {
+    size_t capacity = trace->mask + 1;
+    return trace->head > capacity ? (size_t)(trace->head - capacity) : 0;
+}
+
+// A call whose enter event is still in the ring.
+typedef struct {
+    const HTraceEvent *enter;
+    int64_t child_ns;
+} HTraceFrame;
+
+typedef struct {
+    HArena *arena;
+    HHashTable *labels; // parser -> h_parser_label
+    HTraceFrame *stack;
+    size_t depth;
+    const HTraceEvent *last;
+} HTraceWalk;
+
+typedef void (*HTraceCallFn)(HTraceWalk *w, const HTraceFrame *frame, const HTraceEvent *exit,
+                             void *ctx);
+
+// Match the enter and exit events of every call in the ring, innermost
+// first. Exits whose enter was overwritten are skipped; calls still open at
+// the end are closed by the last event, as failures.
+static void walk_calls(HTraceWalk *w, const HTrace *trace, HTraceCallFn call, void *ctx) {
+    w->depth = 0;
+    w->last = NULL;
+    for (uint64_t i = h_trace_dropped(trace); i < trace->head; i++) {
+        const HTraceEvent *ev = &trace->events[i & trace->mask];
+        w->last = ev;
+        if (ev->kind == H_TRACE_ENTER) {
+            HTraceFrame *f = &w->stack[w->depth++];
+            f->enter = ev;
+            f->child_ns = 0;
+        } else if (w->depth > 0 && w->stack[w->depth - 1].enter->parser == ev->parser) {
+            w->depth--;
+            call(w, &w->stack[w->depth], ev, ctx);
+        }
+    }
+    while (w->depth > 0) {
+        w->depth--;
+        HTraceEvent end = *w->last;
+        end.kind = H_TRACE_FAIL;
+        end.parser = w->stack[w->depth].enter->parser;
+        call(w, &w->stack[w->depth], &end, ctx);
+    }
+}
+
+static void new_walk(HTraceWalk *w, HArena *arena, const HTrace *trace) {
+    size_t n = (size_t)(trace->head - h_trace_dropped(trace));
+    w->arena = arena;
+    w->labels = h_hashtable_new(arena, h_eq_ptr, h_hash_ptr);
+    w->stack = h_arena_malloc(arena, (n > 0 ? n : 1) * sizeof(HTraceFrame));
+}
+
+static const char *label(HTraceWalk *w, const HParser *parser) {
+    const char *l = h_hashtable_get(w->labels, parser);
+    if (!l) {
+        l = h_parser_label(w->arena, parser);
+        h_hashtable_put(w->labels, parser, (void *)l);
+    }
+    return l;
+}
+
+void h_write_json_string(FILE *stream, const char *s) {
+    fputc('"', stream);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            fprintf(stream, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20)
+            fprintf(stream, "\\u%04x", (unsigned char)*s);
+        else
+            fputc(*s, stream);
+    }
+    fputc('"', stream);
+}
+
+typedef struct {
+    FILE *stream;
+    size_t tid;
+    int64_t t0;
+    bool first;
+} HChromeCtx;
+
+static void chrome_call(HTraceWalk *w, const HTraceFrame *frame, const HTraceEvent *exit,
+                        void *ctx) {
+    HChromeCtx *c = ctx;
+    bool ok = exit->kind == H_TRACE_EXIT;
+
+    fputs(c->first ? "\n  {\"name\": " : ",\n  {\"name\": ", c->stream);
+    h_write_json_string(c->stream, label(w, frame->enter->parser));
+    fprintf(c->stream,
+            ", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, "
+            "\"tid\": %zu, \"args\": {\"pos\": %zu",
+            ok ? "parse" : "backtrack", (frame->enter->ns - c->t0) / 1e3,
+            (exit->ns - frame->enter->ns) / 1e3, c->tid, frame->enter->pos);
+    if (ok)
+        fprintf(c->stream, ", \"end\": %zu", exit->pos);
+    fputs("}}", c->stream);
+    c->first = false;
+}
+
+void h_trace_write_chrome(FILE *stream, HTrace *const traces[], size_t n) {
+    HArena *arena = h_new_arena(&system_allocator, 0);
+    HChromeCtx c = {stream, 0, INT64_MAX, true};
+
+    // one clock for all threads
+    for (size_t t = 0; t < n; t++) {
+        const HTrace *trace = traces[t];
+        if (trace->head > 0 && trace->events[h_trace_dropped(trace) & trace->mask].ns < c.t0)
+            c.t0 = trace->events[h_trace_dropped(trace) & trace->mask].ns;
+    }
+    fputs("{\"traceEvents\": [", stream);
+    for (size_t t = 0; t < n; t++) {
+        HTraceWalk w;
+        new_walk(&w, arena, traces[t]);
+        c.tid = t + 1;
+        walk_calls(&w, traces[t], chrome_call, &c);
+    }
+    fputs("\n], \"displayTimeUnit\": \"ns\"}\n", stream);
+    h_delete_arena(arena);
+}
+
+typedef struct {
+    char *path; // the folded stack of the current call
+    size_t cap;
+    HHashTable *totals; // path -> HFoldedStack
+    HCountedArray *order;
+} HFoldedCtx;
+
+typedef struct {
+    const char *path;
+    uint64_t ns;
+} HFoldedStack;
+
+static bool eq_str(const void *p, const void *q) { return strcmp(p, q) == 0; }
+static HHashValue hash_str(const void *p) { return h_djbhash(p, strlen(p)); }
+
+static void folded_call(HTraceWalk *w, const HTraceFrame *frame, const HTraceEvent *exit,
+                        void *ctx) {
+    HFoldedCtx *c = ctx;
+    int64_t ns = exit->ns - frame->enter->ns;
+
+    // the path is rebuilt from the stack, whose frames are all still open
+    size_t len = 0;
+    for (size_t i = 0; i <= w->depth; i++) {
+        const HTraceFrame *f = i < w->depth ? &w->stack[i] : frame;
+        const char *l = label(w, f->enter->parser);
+        size_t n = strlen(l);
+        while (len + n + 2 > c->cap) {
+            char *bigger = h_arena_malloc(w->arena, c->cap * 2);
+            memcpy(bigger, c->path, len);
+            c->path = bigger;
+            c->cap *= 2;
+        }
+        if (i > 0)
+            c->path[len++] = ';';
+        memcpy(c->path + len, l, n);
+        len += n;
+    }
+    c->path[len] = 0;
+
+    HFoldedStack *s = h_hashtable_get(c->totals, c->path);
+    if (!s) {
+        s = h_arena_malloc(w->arena, sizeof(HFoldedStack));
+        char *path = h_arena_malloc(w->arena, len + 1);
+        memcpy(path, c->path, len + 1);
+        s->path = path;
+        s->ns = 0;
+        h_hashtable_put(c->totals, path, s);
+        h_carray_append(c->order, s);
+    }
+    s->ns += ns > frame->child_ns ? (uint64_t)(ns - frame->child_ns) : 0;
+    if (w->depth > 0)
+        w->stack[w->depth - 1].child_ns += ns;
+}
+
+void h_trace_write_folded(FILE *stream, HTrace *const traces[], size_t n) {
+    HArena *arena = h_new_arena(&system_allocator, 0);
+    HFoldedCtx c = {h_arena_malloc(arena, 256), 256, h_hashtable_new(arena, eq_str, hash_str),
+                    h_carray_new(arena)};
+
+    for (size_t t = 0; t < n; t++) {
+        HTraceWalk w;
+        new_walk(&w, arena, traces[t]);
+        walk_calls(&w, traces[t], folded_call, &c);
+    }
+    for (size_t i = 0; i < c.order->used; i++) {
+        const HFoldedStack *s = (const HFoldedStack *)c.order->elements[i];
+        fprintf(stream, "%s %" PRIu64 "\n", s->path, s->ns);
+    }
+    h_delete_arena(arena);
+}
@@ -0,0 +1,27 @@
+/* Traversal of parser graphs */
+
+#include "hammer.h"
+#include "internal.h"
+
+typedef struct {
+    HHashSet *seen;
+    HParserVisitFn fn;
+    void *ctx;
+} HParserWalk;
+
+static void walk_visit(const HParser *p, void *ctx) {
+    HParserWalk *w = ctx;
+    if (h_hashset_present(w->seen, p))
+        return;
+    h_hashset_put(w->seen, (void *)p);
+    if (p->vtable->walk)
+        p->vtable->walk(p->env, walk_visit, w);
+    w->fn(p, w->ctx);
+}
+
+void h_walk_parsers(HAllocator *mm__, const HParser *p, HParserVisitFn fn, void *ctx) {
+    HArena *arena = h_new_arena(mm__, 0);
+    HParserWalk w = {h_hashset_new(arena, h_eq_ptr, h_hash_ptr), fn, ctx};
+    walk_visit(p, &w);
+    h_delete_arena(arena);
+}
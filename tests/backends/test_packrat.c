@@ -79,6 +79,157 @@ static void test_packrat_grow_null_result(gconstpointer backend) {
     (void)res;
 }
 
+// Parsing segmented input must give the same result as the concatenation, for every split.
+static void test_packrat_parse_segments(gconstpointer backend) {
+    HParserBackend be = (HParserBackend)GPOINTER_TO_INT(backend);
+    const uint8_t input[] = "12+34*5+6";
+    size_t len = sizeof(input) - 1;
+
+    HParser *num = h_many1(h_ch_range('0', '9'));
+    HParser *expr = h_indirect();
+    HParser *term = h_choice(h_sequence(num, h_ch('*'), num, NULL), num, NULL);
+    h_bind_indirect(expr, h_choice(h_sequence(expr, h_ch('+'), term, NULL), term, NULL));
+    HParser *p = h_sequence(expr, h_end_p(), NULL);
+    h_compile(p, be, NULL);
+
+    HParseResult *whole = h_parse(p, input, len);
+    g_check_cmp_ptr(whole, !=, NULL);
+    char *expected = h_write_result_unamb(whole->ast);
+
+    for (size_t i = 0; i <= len; i++) {
+        for (size_t j = i; j <= len; j++) {
+            HInputSegment segs[] = {{input, i}, {input + i, j - i}, {input + j, len - j}};
+            HParseResult *res = h_parse_segments(p, segs, 3);
+            g_check_cmp_ptr(res, !=, NULL);
+            if (!res)
+                continue;
+            char *actual = h_write_result_unamb(res->ast);
+            g_check_string(actual, ==, expected);
+            g_check_cmp_int64(res->bit_length, ==, whole->bit_length);
+            system_allocator.free(&system_allocator, actual);
+            h_parse_result_free(res);
+        }
+    }
+    system_allocator.free(&system_allocator, expected);
+    h_parse_result_free(whole);
+
+    HInputSegment bad[] = {{input, 3}, {(const uint8_t *)"+", 1}};
+    g_check_cmp_ptr(h_parse_segments(p, bad, 2), ==, NULL);
+}
+
+// Chunked parsing saves the chunks as segments; the result must not depend on chunking.
+static void test_packrat_parse_chunks(gconstpointer backend) {
+    HParserBackend be = (HParserBackend)GPOINTER_TO_INT(backend);
+    HParser *p = h_sequence(h_many(h_uint16()), h_ch('.'), NULL);
+    h_compile(p, be, NULL);
+
+    HSuspendedParser *s = h_parse_start(p);
+    g_check_cmp_ptr(s, !=, NULL);
+    g_check_cmp_int(h_parse_chunk(s, (const uint8_t *)"\x01", 1), ==, false);
+    g_check_cmp_int(h_parse_chunk(s, (const uint8_t *)"\x02\x03", 2), ==, false);
+    g_check_cmp_int(h_parse_chunk(s, (const uint8_t *)"", 0), ==, false);
+    g_check_cmp_int(h_parse_chunk(s, (const uint8_t *)"\x04.", 2), ==, false);
+    HParseResult *res = h_parse_finish(s);
+    g_check_cmp_ptr(res, !=, NULL);
+    if (res) {
+        char *actual = h_write_result_unamb(res->ast);
+        g_check_string(actual, ==, "((u0x102 u0x304) u0x2e)");
+        g_check_cmp_int64(res->bit_length, ==, 40);
+        system_allocator.free(&system_allocator, actual);
+        h_parse_result_free(res);
+    }
+}
+
+// Parsers that only one path can reach skip the cache; shared ones, cycles and
+// anything that touches the symbol table keep it.
+static void test_packrat_memo_elision(gconstpointer backend) {
+    HParserBackend be = (HParserBackend)GPOINTER_TO_INT(backend);
+
+    HParser *shared = h_ch('x');
+    HParser *tree = h_sequence(h_ch('a'), h_ch('b'), NULL);
+    HParser *put = h_put_value(h_sequence(h_ch('c'), NULL), "k");
+    HParser *p = h_choice(h_sequence(shared, shared, NULL), tree, put, NULL);
+
+    g_check_cmp_int(h_compile(p, be, NULL), ==, 0);
+    g_check_cmp_int(h_parser_private(tree)->memo, ==, H_MEMO_OFF);
+    g_check_cmp_int(h_parser_private(shared)->memo, ==, H_MEMO_ON);
+    g_check_cmp_int(h_parser_private(put)->memo, ==, H_MEMO_ON);
+    g_check_parse_match(p, be, "xx", 2, "(u0x78 u0x78)");
+    g_check_parse_match(p, be, "ab", 2, "(u0x61 u0x62)");
+    g_check_parse_match(p, be, "c", 1, "(u0x63)");
+    g_check_parse_failed(p, be, "a", 1);
+
+    // left recursion needs the cache to grow its seed
+    HParser *a = h_ch('a');
+    HParser *lr = h_indirect();
+    HParser *step = h_sequence(lr, a, NULL);
+    h_bind_indirect(lr, h_choice(step, a, NULL));
+    g_check_cmp_int(h_compile(lr, be, NULL), ==, 0);
+    g_check_cmp_int(h_parser_private(lr)->memo, ==, H_MEMO_ON);
+    g_check_cmp_int(h_parser_private(step)->memo, ==, H_MEMO_ON);
+    g_check_parse_match(lr, be, "aaa", 3, "((u0x61 u0x61) u0x61)");
+
+    // a permutation tries its members at every position
+    HParser *member = h_sequence(h_ch('m'), NULL);
+    HParser *perm = h_permutation(member, h_ch('n'), NULL);
+    g_check_cmp_int(h_compile(perm, be, NULL), ==, 0);
+    g_check_cmp_int(h_parser_private(member)->memo, ==, H_MEMO_ON);
+    g_check_parse_match(perm, be, "nm", 2, "((u0x6d) u0x6e)");
+
+    // a parser once shared stays memoized when compiled on its own
+    g_check_cmp_int(h_compile(shared, be, NULL), ==, 0);
+    g_check_cmp_int(h_parser_private(shared)->memo, ==, H_MEMO_ON);
+}
+
+// The second alternative finds the shared prefix in the cache.
+static void test_packrat_stats(gconstpointer backend) {
+    HParserBackend be = (HParserBackend)GPOINTER_TO_INT(backend);
+    HParser *xs = h_many1(h_ch('x'));
+    HParser *p = h_choice(h_sequence(xs, h_ch('a'), NULL), h_sequence(xs, h_ch('b'), NULL), NULL);
+    HParseStats stats;
+    HParseOptions options = {.stats = &stats};
+
+    g_check_cmp_int(h_compile(p, be, NULL), ==, 0);
+    HParseResult *res = h_parse_with_options(p, (const uint8_t *)"xxb", 3, &options);
+    g_check_cmp_ptr(res, !=, NULL);
+    g_check_cmp_int(stats.memo_hits, ==, 1);
+    g_check_cmp_int(stats.memo_entries, ==, stats.memo_lookups - stats.memo_hits);
+    g_check_cmp_int(stats.memo_hash_bytes, ==, stats.memo_lookups * sizeof(HParserCacheKey));
+    g_check_cmp_int(stats.memo_capacity, >=, stats.memo_entries);
+    g_check_cmp_int(stats.memo_chain_max, >=, 1);
+    g_check_cmpdouble(stats.memo_load, ==, (double)stats.memo_entries / stats.memo_capacity);
+    g_check_cmpdouble(stats.memo_chain_mean, >=, 1);
+    g_check_cmp_int(stats.arena.blocks, >=, 1);
+    g_check_cmp_int(stats.arena.used, >, 0);
+    g_check_cmp_int(stats.arena.arena_malloc_count, >, 0);
+    h_parse_result_free(res);
+
+    // a failed parse still reports
+    g_check_cmp_ptr(h_parse_with_options(p, (const uint8_t *)"xxc", 3, &options), ==, NULL);
+    g_check_cmp_int(stats.memo_hits, ==, 1);
+    g_check_cmp_int(stats.memo_entries, >, 0);
+}
+
+// An indirect bound to itself, alone or through other indirects, has no
+// context-free form; compiling for packrat still works, and only asks for a
+// grammar when there is a choice to compile.
+static void test_packrat_indirect_loop(gconstpointer backend) {
+    HParserBackend be = (HParserBackend)GPOINTER_TO_INT(backend);
+    HParser *i = h_indirect();
+    h_bind_indirect(i, i);
+    g_check_cmp_int(i->vtable->isValidCF(i->env), ==, false);
+    g_check_cmp_int(h_compile(i, be, NULL), ==, 0);
+    g_check_parse_failed(i, be, "a", 1);
+
+    HParser *j = h_indirect(), *k = h_indirect();
+    h_bind_indirect(j, k);
+    h_bind_indirect(k, j);
+    HParser *p = h_choice(j, h_ch('a'), NULL);
+    g_check_cmp_int(p->vtable->isValidCF(p->env), ==, false);
+    g_check_cmp_int(h_compile(p, be, NULL), ==, 0);
+    g_check_parse_match(p, be, "a", 1, "u0x61");
+}
+
 void register_packrat_tests(void) {
     g_test_add_data_func("/core/parser/packrat/ast_bit_length", GINT_TO_POINTER(PB_PACKRAT),
                          test_packrat_ast_bit_length);
@@ -88,4 +239,14 @@ void register_packrat_tests(void) {
                          test_packrat_recall_cache_update);
     g_test_add_data_func("/core/parser/packrat/grow_null_result", GINT_TO_POINTER(PB_PACKRAT),
                          test_packrat_grow_null_result);
+    g_test_add_data_func("/core/parser/packrat/parse_segments", GINT_TO_POINTER(PB_PACKRAT),
+                         test_packrat_parse_segments);
+    g_test_add_data_func("/core/parser/packrat/parse_chunks", GINT_TO_POINTER(PB_PACKRAT),
+                         test_packrat_parse_chunks);
+    g_test_add_data_func("/core/parser/packrat/memo_elision", GINT_TO_POINTER(PB_PACKRAT),
+                         test_packrat_memo_elision);
+    g_test_add_data_func("/core/parser/packrat/stats", GINT_TO_POINTER(PB_PACKRAT),
+                         test_packrat_stats);
+    g_test_add_data_func("/core/parser/packrat/indirect_loop", GINT_TO_POINTER(PB_PACKRAT),
+                         test_packrat_indirect_loop);
 }
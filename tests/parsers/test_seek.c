@@ -26,6 +26,16 @@ static void test_seek_default_case(gconstpointer backend) {
 }
 
 // Test seek.c: underflow check (line 41)
+// The elements after a seek back need no more input than is left before it.
+static void test_seek_back_in_sequence(gconstpointer backend) {
+    HParserBackend be = (HParserBackend)GPOINTER_TO_INT(backend);
+    HParser *p = h_sequence(h_uint8(), h_seek(0, SEEK_SET), h_uint8(), NULL);
+    HParseResult *r = h_parse(p, (const uint8_t *)"a", 1);
+    g_check_cmp_ptr(r, !=, NULL);
+    h_parse_result_free(r);
+    g_check_parse_match(p, be, "a", 1, "(u0x61 u0 u0x61)");
+}
+
 static void test_seek_underflow(gconstpointer backend) {
     HParserBackend be = (HParserBackend)GPOINTER_TO_INT(backend);
     HParser *seek_underflow = h_seek(-1, SEEK_SET);
@@ -57,6 +67,8 @@ static void test_seek_overflow(gconstpointer backend) {
 void register_seek_tests(void) {
     g_test_add_data_func("/core/parser/packrat/seek_default_case", GINT_TO_POINTER(PB_PACKRAT),
                          test_seek_default_case);
+    g_test_add_data_func("/core/parser/packrat/seek_back_in_sequence", GINT_TO_POINTER(PB_PACKRAT),
+                         test_seek_back_in_sequence);
     g_test_add_data_func("/core/parser/packrat/seek_underflow", GINT_TO_POINTER(PB_PACKRAT),
                          test_seek_underflow);
     g_test_add_data_func("/core/parser/packrat/seek_overflow", GINT_TO_POINTER(PB_PACKRAT),
@@ -3,6 +3,7 @@
 
 #include <glib.h>
 #include <stdio.h>
+#include <string.h>
 
 HParserTestcase testcases[] = {{(unsigned char *)"1,2,3", 5, "(u0x31 u0x32 u0x33)"},
                                {(unsigned char *)"1,3,2", 5, "(u0x31 u0x33 u0x32)"},
@@ -81,6 +82,102 @@ static void test_benchmark_multiple_backends(void) {
     fclose(tmp);
 }
 
+static void test_benchmark_stats(void) {
+    HParser *parser = h_sepBy1(h_choice(h_ch('1'), h_ch('2'), h_ch('3'), NULL), h_ch(','));
+    HBenchmarkOptions opts = {100000, 100000, 5, false};
+
+    HBenchmarkResults *res = h_benchmark_with_options(parser, testcases, &opts);
+    const HBackendResults *br = &res->results[PB_PACKRAT];
+    g_check_cmp_ptr(br->cases, !=, NULL);
+    for (size_t i = 0; i < br->n_testcases; i++) {
+        const HBenchmarkStats *st = h_benchmark_stats(res, PB_PACKRAT, i);
+        g_check_cmp_int(br->cases[i].success, ==, true);
+        g_check_cmp_uint64(st->samples, ==, 5);
+        g_check_cmp_uint64(st->iterations, >=, 1);
+        g_check_cmp_int(st->min_ns <= st->median_ns, ==, true);
+        g_check_cmp_int(st->median_ns <= st->p99_ns, ==, true);
+        g_check_cmp_int(st->min_ns <= st->mean_ns && st->mean_ns <= st->p99_ns, ==, true);
+        g_check_cmp_int(st->stddev_ns >= 0, ==, true);
+        g_check_cmp_int(st->mb_per_s > 0, ==, true);
+        g_check_cmp_uint64(st->allocations, >, 0);
+        g_check_cmp_uint64(st->bytes_allocated, >, 0);
+        g_check_cmp_uint64(st->peak_bytes, >, 0);
+        g_check_cmp_uint64(st->peak_bytes, <=, st->bytes_allocated);
+        size_t classified = 0;
+        for (size_t c = 0; c < H_ALLOC_SIZE_CLASSES; c++)
+            classified += st->size_classes[c];
+        g_check_cmp_uint64(classified, ==, st->allocations);
+        g_check_cmp_ptr(st->top_allocators[0].parser, !=, NULL);
+        for (size_t k = 1; k < H_BENCHMARK_TOP_ALLOCATORS && st->top_allocators[k].parser; k++)
+            g_check_cmp_uint64(st->top_allocators[k - 1].arena_bytes, >=,
+                               st->top_allocators[k].arena_bytes);
+    }
+    g_check_cmp_ptr(h_benchmark_stats(res, PB_PACKRAT, br->n_testcases), ==, NULL);
+    g_check_cmp_ptr(h_benchmark_stats(res, res->len, 0), ==, NULL);
+
+    char buf[4096];
+    FILE *tmp = tmpfile();
+    h_benchmark_write_csv(tmp, res);
+    rewind(tmp);
+    size_t lines = 0;
+    g_check_cmp_ptr(fgets(buf, sizeof(buf), tmp), !=, NULL);
+    g_check_cmp_int(strncmp(buf, "backend,case,length,", 20), ==, 0);
+    while (fgets(buf, sizeof(buf), tmp)) {
+        g_check_cmp_int(strncmp(buf, "packrat,", 8), ==, 0);
+        lines++;
+    }
+    g_check_cmp_uint64(lines, ==, br->n_testcases);
+    fclose(tmp);
+
+    tmp = tmpfile();
+    h_benchmark_write_json(tmp, res);
+    rewind(tmp);
+    size_t len = fread(buf, 1, sizeof(buf) - 1, tmp);
+    buf[len] = 0;
+    fclose(tmp);
+    g_check_cmp_int(strncmp(buf, "{\"cases\": [\n", 12), ==, 0);
+    g_check_cmp_ptr(strstr(buf, "{\"backend\": \"packrat\", \"case\": 0, \"length\": 5,"), !=,
+                    NULL);
+    g_check_cmp_ptr(strstr(buf, "\"case\": 3, \"length\": 1,"), !=, NULL);
+    g_check_cmp_ptr(strstr(buf, "\"top_allocators\": [{\"parser\": \""), !=, NULL);
+    g_check_string(buf + len - 4, ==, "\n]}\n");
+}
+
+static void test_benchmark_counters(void) {
+    HParser *parser = h_sepBy1(h_choice(h_ch('1'), h_ch('2'), h_ch('3'), NULL), h_ch(','));
+    HBenchmarkOptions opts = {100000, 100000, 5, true};
+
+    HBenchmarkResults *res = h_benchmark_with_options(parser, testcases, &opts);
+    const HBackendResults *br = &res->results[PB_PACKRAT];
+    g_check_cmp_ptr(br->cases, !=, NULL);
+    for (size_t i = 0; i < br->n_testcases; i++) {
+        const HBenchmarkCounters *c = &h_benchmark_stats(res, PB_PACKRAT, i)->counters;
+        g_check_cmpdouble(c->task_clock_ns, >, 0);
+        g_check_cmpdouble(c->page_faults, >=, 0);
+        g_check_cmpdouble(c->context_switches, >=, 0);
+        if (c->hardware && c->instructions >= 0 && c->cycles > 0)
+            g_check_cmpdouble(c->ipc, >, 0);
+        if (!c->hardware) {
+            g_check_cmpdouble(c->instructions, ==, -1);
+            g_check_cmpdouble(c->ipc, ==, -1);
+        }
+    }
+
+    char buf[8192];
+    FILE *tmp = tmpfile();
+    h_benchmark_report(tmp, res);
+    rewind(tmp);
+    size_t len = fread(buf, 1, sizeof(buf) - 1, tmp);
+    buf[len] = 0;
+    fclose(tmp);
+    g_check_cmp_ptr(strstr(buf, "ns CPU"), !=, NULL);
+
+    // without the option, nothing is counted
+    opts.counters = false;
+    res = h_benchmark_with_options(parser, testcases, &opts);
+    g_check_cmpdouble(h_benchmark_stats(res, PB_PACKRAT, 0)->counters.task_clock_ns, ==, -1);
+}
+
 void register_benchmark_tests(void) {
     g_test_add_func("/core/benchmark/1", test_benchmark_1);
     g_test_add_func("/core/benchmark/m", test_benchmark_m);
@@ -88,4 +185,6 @@ void register_benchmark_tests(void) {
     g_test_add_func("/core/benchmark/failed_testcases", test_benchmark_failed_testcases);
     g_test_add_func("/core/benchmark/report_null_cases", test_benchmark_report_null_cases);
     g_test_add_func("/core/benchmark/multiple_backends", test_benchmark_multiple_backends);
+    g_test_add_func("/core/benchmark/stats", test_benchmark_stats);
+    g_test_add_func("/core/benchmark/counters", test_benchmark_counters);
 }
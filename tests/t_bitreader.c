@@ -206,6 +206,64 @@ static void test_read_bits_byte_le_slow_path(void) {
     g_check_cmp_int(result, >=, 0);
 }
 
+#define MK_SEGMENTS(desc, arr)                                                                     \
+    HInputSegments desc = {.segs = arr, .count = sizeof(arr) / sizeof(arr[0]), .length = 0};       \
+    for (size_t i_ = 0; i_ < desc.count; i_++)                                                     \
+        desc.length += arr[i_].length;
+
+static void test_segments_read_across(void) {
+    HInputSegment segs[] = {{(const uint8_t *)"\x6A", 1},
+                            {NULL, 0},
+                            {(const uint8_t *)"\x5A\xFF", 2},
+                            {(const uint8_t *)"\x01", 1}};
+    MK_SEGMENTS(desc, segs);
+    HInputStream is = MK_INPUT_STREAM(NULL, 0, BIT_BIG_ENDIAN | BYTE_BIG_ENDIAN);
+    h_input_stream_init_segments(&is, &desc);
+
+    g_check_cmp_int32(h_read_bits(&is, 5, false), ==, 0xD);
+    g_check_cmp_int32(h_read_bits(&is, 11, false), ==, 0x25A); // crosses the empty segment
+    g_check_cmp_int(is.segment, ==, 2);
+    g_check_cmp_int(h_input_stream_pos(&is), ==, 16);
+    g_check_cmp_int32(h_read_bits(&is, 16, false), ==, 0xFF01);
+    g_check_cmp_int(is.overrun, ==, false);
+    g_check_cmp_int(is.segment, ==, 3); // stays on the last segment at the end
+    h_read_bits(&is, 8, false);
+    g_check_cmp_int(is.overrun, ==, true);
+}
+
+static void test_segments_read_across_le(void) {
+    HInputSegment segs[] = {{(const uint8_t *)"\x01\x02\x03", 3},
+                            {(const uint8_t *)"\x04\x05\x06\x07\x08", 5}};
+    MK_SEGMENTS(desc, segs);
+    HInputStream is = MK_INPUT_STREAM(NULL, 0, BIT_LITTLE_ENDIAN | BYTE_LITTLE_ENDIAN);
+    h_input_stream_init_segments(&is, &desc);
+
+    g_check_cmp_int64(h_read_bits(&is, 64, false), ==, 0x0807060504030201);
+    g_check_cmp_int(is.overrun, ==, false);
+    g_check_cmp_int(is.index, ==, is.length);
+}
+
+static void test_segments_skip_seek(void) {
+    HInputSegment segs[] = {{(const uint8_t *)"\x6A\x5A", 2},
+                            {(const uint8_t *)"\x11", 1},
+                            {(const uint8_t *)"\x22\x33", 2}};
+    MK_SEGMENTS(desc, segs);
+    HInputStream is = MK_INPUT_STREAM(NULL, 0, BIT_BIG_ENDIAN | BYTE_BIG_ENDIAN);
+    h_input_stream_init_segments(&is, &desc);
+
+    h_skip_bits(&is, 28);
+    g_check_cmp_int(is.segment, ==, 2);
+    g_check_cmp_int32(h_read_bits(&is, 8, false), ==, 0x23);
+    h_seek_bits(&is, 4);
+    g_check_cmp_int(is.segment, ==, 0);
+    g_check_cmp_int32(h_read_bits(&is, 8, false), ==, 0xA5);
+    g_check_cmp_int(h_input_stream_length(&is), ==, 40);
+    h_seek_bits(&is, 40);
+    g_check_cmp_int(is.overrun, ==, false);
+    h_skip_bits(&is, 1);
+    g_check_cmp_int(is.overrun, ==, true);
+}
+
 void register_bitreader_tests(void) {
     g_test_add_func("/core/bitreader/be", test_bitreader_be);
     g_test_add_func("/core/bitreader/le", test_bitreader_le);
@@ -233,5 +291,8 @@ void register_bitreader_tests(void) {
     g_test_add_func("/core/bitreader/seek_different_byte", test_seek_bits_different_byte);
     g_test_add_func("/core/bitreader/byte_le_fast_path", test_read_bits_byte_le_fast_path);
     g_test_add_func("/core/bitreader/byte_le_slow_path", test_read_bits_byte_le_slow_path);
+    g_test_add_func("/core/bitreader/segments_read_across", test_segments_read_across);
+    g_test_add_func("/core/bitreader/segments_read_across_le", test_segments_read_across_le);
+    g_test_add_func("/core/bitreader/segments_skip_seek", test_segments_skip_seek);
 }
 
@@ -2,6 +2,7 @@
 #include "test_suite.h"
 
 #include <glib.h>
+#include <pthread.h>
 #include <string.h>
 
 static void test_tt_backend_description(void) {
@@ -87,6 +88,34 @@ static void test_tt_h_compile_for_backend_with_params(void) {
     }
 }
 
+#define SPEC_CALLS 2000
+
+static void *resolve_specs(void *arg) {
+    bool *ok = arg;
+    for (int i = 0; i < SPEC_CALLS; i++) {
+        HParserBackendWithParams *be_w_p = h_get_backend_with_params_by_name("packrat(0)");
+        *ok &= be_w_p && be_w_p->backend == PB_PACKRAT;
+        h_free_backend_with_params(be_w_p);
+    }
+    return NULL;
+}
+
+// Resolving a spec reuses one parser, so it is safe to do from several
+// threads at once, starting with the first call. bench/micro times it.
+static void test_tt_get_backend_with_params_by_name_threads(void) {
+    pthread_t threads[4];
+    bool ok[4];
+
+    for (int t = 0; t < 4; t++) {
+        ok[t] = true;
+        g_check_cmp_int(pthread_create(&threads[t], NULL, resolve_specs, &ok[t]), ==, 0);
+    }
+    for (int t = 0; t < 4; t++) {
+        pthread_join(threads[t], NULL);
+        g_check_cmp_int(ok[t], ==, true);
+    }
+}
+
 void register_names_tests(void) {
     g_test_add_func("/core/names/tt_backend_short_name", test_tt_backend_short_name);
     g_test_add_func("/core/names/tt_backend_description", test_tt_backend_description);
@@ -99,4 +128,6 @@ void register_names_tests(void) {
                     test_tt_h_get_name_for_backend_with_params);
     g_test_add_func("/core/names/tt_h_compile_for_backend_with_params",
                     test_tt_h_compile_for_backend_with_params);
+    g_test_add_func("/core/names/tt_get_backend_with_params_by_name_threads",
+                    test_tt_get_backend_with_params_by_name_threads);
 }
@@ -350,6 +350,185 @@ static void test_choice(gconstpointer backend) {
     g_check_parse_failed(choice_, (HParserBackend)GPOINTER_TO_INT(backend), "c", 1);
 }
 
+static void test_choice_dispatch(gconstpointer backend) {
+    HParserBackend be = (HParserBackend)GPOINTER_TO_INT(backend);
+    // a wide choice as compiled into a dispatch table, with alternatives that
+    // share a first byte, can be empty, need the end, or have no CFG form
+    HParser *wide = h_choice(h_token((const uint8_t *)"ab", 2), h_token((const uint8_t *)"abc", 3),
+                             h_sequence(h_ch('x'), h_ch_range('0', '9'), NULL),
+                             h_length_value(h_int_range(h_uint8(), 1, 2), h_ch('z')),
+                             h_sequence(h_ch('q'), h_end_p(), NULL), h_ch_range('m', 'p'),
+                             h_epsilon_p(), NULL);
+
+    g_check_parse_match(wide, be, "abc", 3, "<61.62>");
+    g_check_parse_match(wide, be, "x7", 2, "(u0x78 u0x37)");
+    g_check_parse_match(wide, be, "\x02zz", 3, "(u0x7a u0x7a)");
+    g_check_parse_match(wide, be, "q", 1, "(u0x71)");
+    g_check_parse_match(wide, be, "qq", 2, "NULL");
+    g_check_parse_match(wide, be, "n", 1, "u0x6e");
+    g_check_parse_match(wide, be, "", 0, "NULL");
+    g_check_parse_match(wide, be, "x", 1, "NULL");
+
+    // left recursion still grows through the table
+    HParser *num = h_many1(h_ch_range('0', '9'));
+    HParser *expr = h_indirect();
+    h_bind_indirect(expr, h_choice(h_sequence(expr, h_ch('+'), num, NULL), num, NULL));
+    g_check_parse_match(expr, be, "1+23+4", 6,
+                        "(((u0x31) u0x2b (u0x32 u0x33)) u0x2b (u0x34))");
+
+    // byte order and alignment the first sets do not describe
+    HParser *ints = h_choice(h_int_range(h_uint16(), 0x0100, 0x01ff), h_ch('z'), NULL);
+    g_check_parse_match(ints, be, "\x01\x02", 2, "u0x102");
+    g_check_parse_match(h_with_endianness(BYTE_LITTLE_ENDIAN | BIT_BIG_ENDIAN, ints), be,
+                        "\x02\x01", 2, "u0x102");
+    g_check_parse_match(h_sequence(h_bits(4, false), h_choice(h_ch('q'), h_ch('z'), NULL),
+                                   NULL),
+                        be, "\x07\xa0", 2, "(u0 u0x7a)");
+}
+
+static void test_sequence_literals(gconstpointer backend) {
+    HParserBackend be = (HParserBackend)GPOINTER_TO_INT(backend);
+    // runs of literals are matched at once but must give the same tokens
+    HParser *get = h_sequence(h_ch('G'), h_ch('E'), h_token((const uint8_t *)"T /", 3),
+                              h_ignore(h_ch(' ')), h_ch_range('a', 'z'), h_ch('\n'), h_ch('\n'),
+                              NULL);
+
+    g_check_parse_match(get, be, "GET / x\n\n", 9, "(u0x47 u0x45 <54.20.2f> u0x78 u0xa u0xa)");
+    g_check_parse_failed(get, be, "GET /x\n\n", 8);
+    g_check_parse_failed(get, be, "GEX / x\n\n", 9);
+    g_check_parse_failed(get, be, "GE", 2);
+
+    // unaligned, the elements are matched one by one
+    HParser *bits = h_sequence(h_bits(4, false), h_ch('a'), h_ch('b'), h_bits(4, false), NULL);
+    g_check_parse_match(bits, be, "\x16\x16\x2f", 3, "(u0x1 u0x61 u0x62 u0xf)");
+
+    // a run spanning two segments
+    HInputSegment segs[] = {{(const uint8_t *)"GET", 3}, {(const uint8_t *)" / q\n\n", 6}};
+    h_compile(get, be, NULL);
+    HParseResult *res = h_parse_segments(get, segs, 2);
+    g_check_cmp_ptr(res, !=, NULL);
+    if (res) {
+        char *cres = h_write_result_unamb(res->ast);
+        g_check_string(cres, ==, "(u0x47 u0x45 <54.20.2f> u0x71 u0xa u0xa)");
+        (&system_allocator)->free(&system_allocator, cres);
+        h_parse_result_free(res);
+    }
+}
+
+static void test_choice_literals(gconstpointer backend) {
+    HParserBackend be = (HParserBackend)GPOINTER_TO_INT(backend);
+    // literal alternatives share a trie, but the first one to match still wins
+    HParser *kw = h_choice(h_literal("GET"), h_literal("GETALL"), h_literal("POSTAL"),
+                           h_literal("POST"), h_ch('P'), h_ignore(h_literal("PUT")), NULL);
+
+    g_check_parse_match(kw, be, "GETALL", 6, "<47.45.54>");
+    g_check_parse_match(kw, be, "POSTAL", 6, "<50.4f.53.54.41.4c>");
+    g_check_parse_match(kw, be, "POSTA", 5, "<50.4f.53.54>");
+    g_check_parse_match(kw, be, "PUT", 3, "u0x50");
+    g_check_parse_failed(kw, be, "GE", 2);
+    g_check_parse_failed(kw, be, "", 0);
+    g_check_parse_match(h_sequence(h_bits(4, false), kw, NULL), be, "\x05\x04\x54", 3,
+                        "(u0 u0x50)");
+
+    // other alternatives are tried in their place among the literals
+    HParser *digit = h_sequence(h_ch('a'), h_ch_range('0', '9'), NULL);
+    HParser *mixed = h_sequence(
+        h_choice(h_literal("ab"), digit, h_literal("a1x"), h_ignore(h_literal("zz")), NULL),
+        h_ch('.'), NULL);
+    g_check_parse_match(mixed, be, "ab.", 3, "(<61.62> u0x2e)");
+    g_check_parse_match(mixed, be, "a1.", 3, "((u0x61 u0x31) u0x2e)");
+    g_check_parse_failed(mixed, be, "a1x.", 4);
+    g_check_parse_match(mixed, be, "zz.", 3, "(u0x2e)");
+
+    // a literal cut off by the end of a chunk waits for the next one
+    HSuspendedParser *s = h_parse_start(kw);
+    g_check_cmp_ptr(s, !=, NULL);
+    h_parse_chunk(s, (const uint8_t *)"POS", 3);
+    h_parse_chunk(s, (const uint8_t *)"TAL", 3);
+    HParseResult *r = h_parse_finish(s);
+    g_check_cmp_ptr(r, !=, NULL);
+    if (r)
+        g_check_cmp_int64(r->bit_length, ==, 48);
+}
+
+static void test_ignore_skip(gconstpointer backend) {
+    HParserBackend be = (HParserBackend)GPOINTER_TO_INT(backend);
+    size_t bits = 0;
+
+    // fixed fields that match anything are skipped, not parsed
+    HParser *hdr = h_sequence(h_uint16(), h_bits(3, false), h_repeat_n(h_uint8(), 2), NULL);
+    g_check_cmp_int(h_skippable(hdr, &bits), ==, true);
+    g_check_cmp_int64(bits, ==, 35);
+    g_check_cmp_int(h_skippable(h_ch('x'), &bits), ==, false);
+    g_check_cmp_int(h_skippable(h_many(h_uint8()), &bits), ==, false);
+
+    HParser *p = h_sequence(h_ch('a'), h_ignore(hdr), h_bits(5, false), h_ch('z'), NULL);
+    g_check_parse_match(p, be, "a\x01\x02\xff\xff\xe7z", 7, "(u0x61 u0x7 u0x7a)");
+    g_check_parse_failed(p, be, "a\x01\x02", 3);
+
+    // others still have to match
+    HParser *q = h_sequence(h_ignore(h_sequence(h_uint8(), h_ch('x'), NULL)), h_ch('y'), NULL);
+    g_check_parse_match(q, be, "\x05xy", 3, "(u0x79)");
+    g_check_parse_failed(q, be, "\x05zy", 3);
+
+    // a sequence too long for the chunk at hand waits for the next one
+    HParser *r = h_sequence(h_uint32(), h_ignore(h_uint32()), NULL);
+    g_check_cmp_int(h_compile(r, be, NULL), ==, 0);
+    HSuspendedParser *s = h_parse_start(r);
+    g_check_cmp_ptr(s, !=, NULL);
+    h_parse_chunk(s, (const uint8_t *)"abc", 3);
+    h_parse_chunk(s, (const uint8_t *)"defgh", 5);
+    HParseResult *res = h_parse_finish(s);
+    g_check_cmp_ptr(res, !=, NULL);
+    if (res)
+        g_check_cmp_int64(res->bit_length, ==, 64);
+}
+
+typedef struct {
+    uint16_t id;
+    bool qr;
+    uint8_t opcode;
+    int8_t delta;
+    uint32_t le;
+    uint64_t unused;
+} test_header_t;
+
+static void test_struct(gconstpointer backend) {
+    HParserBackend be = (HParserBackend)GPOINTER_TO_INT(backend);
+    HStructField fields[] = {
+        H_STRUCT_FIELD(test_header_t, le, 32, 32),
+        H_STRUCT_FIELD(test_header_t, id, 0, 16),
+        H_STRUCT_FIELD(test_header_t, qr, 16, 1),
+        H_STRUCT_FIELD(test_header_t, opcode, 17, 4),
+        H_STRUCT_FIELD(test_header_t, delta, 24, 8),
+    };
+    fields[0].endianness = BYTE_LITTLE_ENDIAN | BIT_BIG_ENDIAN;
+    fields[4].sign = true;
+    HParser *p = h_struct(TT_USER, sizeof(test_header_t), 64, fields, 5);
+    g_check_cmp_ptr(p, !=, NULL);
+    g_check_cmp_int(h_compile(p, be, NULL), ==, 0);
+
+    HParseResult *res = h_parse(p, (const uint8_t *)"\x12\x34\xa8\xfe\x78\x56\x34\x12", 8);
+    g_check_cmp_ptr(res, !=, NULL);
+    if (res) {
+        g_check_cmp_int(res->ast->token_type, ==, TT_USER);
+        const test_header_t *h = res->ast->user;
+        g_check_cmp_uint64(h->id, ==, 0x1234);
+        g_check_cmp_int(h->qr, ==, true);
+        g_check_cmp_uint64(h->opcode, ==, 5);
+        g_check_cmp_int64(h->delta, ==, -2);
+        g_check_cmp_uint64(h->le, ==, 0x12345678);
+        g_check_cmp_uint64(h->unused, ==, 0);
+        g_check_cmp_int64(res->bit_length, ==, 64);
+        h_parse_result_free(res);
+    }
+    g_check_parse_failed(p, be, "\x12\x34\xa8\xfe\x78\x56\x34", 7);
+
+    // fields have to fit the layout and the struct
+    g_check_cmp_ptr(h_struct(TT_USER, sizeof(test_header_t), 48, fields, 5), ==, NULL);
+    g_check_cmp_ptr(h_struct(TT_USER, 4, 64, fields, 5), ==, NULL);
+}
+
 static void test_butnot(gconstpointer backend) {
     const HParser *butnot_1 = h_butnot(h_ch('a'), h_token((const uint8_t *)"ab", 2));
     const HParser *butnot_2 = h_butnot(h_ch_range('0', '9'), h_ch('6'));
@@ -391,6 +570,60 @@ static void test_many(gconstpointer backend) {
     //  (HParserBackend)GPOINTER_TO_INT(backend), "daabbabadef", 11, "()");
 }
 
+static void test_many_parallel(gconstpointer backend) {
+    HParserBackend be = (HParserBackend)GPOINTER_TO_INT(backend);
+    HThreadPool *pool = h_thread_pool_new(4);
+    HParser *record = h_length_value(h_uint8(), h_ch_range('a', 'z'));
+    const HParser *many_ = h_many_parallel(pool, record);
+
+    g_check_parse_match(many_, be, "", 0, "()");
+    g_check_parse_match(many_, be, "\x02" "ab\x01" "c\x00\x03" "xyz", 10,
+                        "((u0x61 u0x62) (u0x63) () (u0x78 u0x79 u0x7a))");
+    g_check_parse_match(many_, be, "\x02" "ab\x01!\x01" "c", 7, "((u0x61 u0x62))");
+    g_check_parse_match(many_, be, "\x02" "ab\x05" "cd", 6, "((u0x61 u0x62))");
+    g_check_parse_match(h_many_parallel(pool, h_ch('a')), be, "aab", 3, "(u0x61 u0x61)");
+
+    // enough records for the boundary table to be thinned out several times
+    size_t len = 0;
+    uint8_t *input = g_malloc(20000 * 8);
+    for (int i = 0; i < 20000; i++) {
+        input[len++] = i % 7;
+        for (int j = 0; j < i % 7; j++)
+            input[len++] = 'a' + (i + j) % 26;
+    }
+    input[len - 1] = '#'; // the last record fails
+    HParseResult *seq = h_parse(h_many(record), input, len);
+    HParseResult *par = h_parse(many_, input, len);
+    g_check_cmp_ptr(par, !=, NULL);
+    if (par) {
+        char *expected = h_write_result_unamb(seq->ast);
+        char *actual = h_write_result_unamb(par->ast);
+        g_check_cmp_int(par->ast->seq->used, ==, 19999);
+        g_check_cmp_int(par->bit_length, ==, seq->bit_length);
+        g_check_string(actual, ==, expected);
+        system_allocator.free(&system_allocator, expected);
+        system_allocator.free(&system_allocator, actual);
+    }
+    h_parse_result_free(seq);
+    h_parse_result_free(par);
+
+    // the workers' arenas, which hold most of the result, come from the
+    // parse's allocator, as they do when the records are parsed in turn
+    HAllocTracker tracker;
+    h_alloc_tracker_init(&tracker, &system_allocator);
+    seq = h_parse__m(&tracker.allocator, h_many(record), input, len);
+    size_t seq_live = tracker.live;
+    h_parse_result_free(seq);
+    h_alloc_tracker_reset(&tracker);
+    par = h_parse__m(&tracker.allocator, many_, input, len);
+    g_check_cmp_ptr(par, !=, NULL);
+    g_check_cmp_uint64(tracker.live, >, seq_live / 2);
+    h_parse_result_free(par);
+    g_check_cmp_uint64(tracker.live, ==, 0);
+    g_free(input);
+    h_thread_pool_free(pool);
+}
+
 static void test_many1(gconstpointer backend) {
     const HParser *many1_ = h_many1(h_choice(h_ch('a'), h_ch('b'), NULL));
 
@@ -997,11 +1230,22 @@ void register_parser_tests(void) {
     g_test_add_data_func("/core/parser/packrat/sequence", GINT_TO_POINTER(PB_PACKRAT),
                          test_sequence);
     g_test_add_data_func("/core/parser/packrat/choice", GINT_TO_POINTER(PB_PACKRAT), test_choice);
+    g_test_add_data_func("/core/parser/packrat/choice_dispatch", GINT_TO_POINTER(PB_PACKRAT),
+                         test_choice_dispatch);
+    g_test_add_data_func("/core/parser/packrat/sequence_literals", GINT_TO_POINTER(PB_PACKRAT),
+                         test_sequence_literals);
+    g_test_add_data_func("/core/parser/packrat/choice_literals", GINT_TO_POINTER(PB_PACKRAT),
+                         test_choice_literals);
+    g_test_add_data_func("/core/parser/packrat/ignore_skip", GINT_TO_POINTER(PB_PACKRAT),
+                         test_ignore_skip);
+    g_test_add_data_func("/core/parser/packrat/struct", GINT_TO_POINTER(PB_PACKRAT), test_struct);
     g_test_add_data_func("/core/parser/packrat/butnot", GINT_TO_POINTER(PB_PACKRAT), test_butnot);
     g_test_add_data_func("/core/parser/packrat/difference", GINT_TO_POINTER(PB_PACKRAT),
                          test_difference);
     g_test_add_data_func("/core/parser/packrat/xor", GINT_TO_POINTER(PB_PACKRAT), test_xor);
     g_test_add_data_func("/core/parser/packrat/many", GINT_TO_POINTER(PB_PACKRAT), test_many);
+    g_test_add_data_func("/core/parser/packrat/many_parallel", GINT_TO_POINTER(PB_PACKRAT),
+                         test_many_parallel);
     g_test_add_data_func("/core/parser/packrat/many1", GINT_TO_POINTER(PB_PACKRAT), test_many1);
     g_test_add_data_func("/core/parser/packrat/repeat_n", GINT_TO_POINTER(PB_PACKRAT),
                          test_repeat_n);
@@ -123,6 +123,10 @@ static void test_allocator_stats(void) {
         h_allocator_stats(arena, &stats);
         g_check_cmp_int(stats.used, >=, 100);
         g_check_cmp_int(stats.wasted, >=, 0);
+#ifndef DETAILED_ARENA_STATS
+        // the layout applications were built against
+        g_check_cmp_size(sizeof(HArenaStats), ==, 2 * sizeof(size_t));
+#endif
 
         h_delete_arena(arena);
     }
@@ -152,6 +156,112 @@ static void test_delete_arena(void) {
     }
 }
 
+static void test_arena_reset(void) {
+    HArena *arena = h_new_arena(&system_allocator, 256);
+    HArenaStats stats;
+
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < 10; i++)
+            memset(h_arena_malloc_noinit(arena, 100), 0xAA, 100);
+        memset(h_arena_malloc_noinit(arena, 1000), 0xBB, 1000); // large block
+        h_allocator_stats(arena, &stats);
+        g_check_cmp_int(stats.used, ==, 2000);
+
+        h_arena_reset(arena);
+        h_allocator_stats(arena, &stats);
+        g_check_cmp_int(stats.used, ==, 0);
+    }
+    h_delete_arena(arena);
+}
+
+static void test_arena_adopt(void) {
+    HArena *arena = h_new_arena(&system_allocator, 0);
+    HArena *child = h_new_arena(&system_allocator, 0);
+    HArenaStats stats;
+
+    h_arena_malloc(arena, 10);
+    h_arena_malloc(child, 20);
+    h_arena_adopt(arena, child);
+    h_arena_malloc(child, 30); // still usable after adoption
+    h_allocator_stats(arena, &stats);
+    g_check_cmp_int(stats.used, ==, 60);
+    h_delete_arena(arena); // deletes child too
+}
+
+static void test_arena_counts(void) {
+    HArena *arena = h_new_arena(&system_allocator, 256);
+    HArena *child = h_new_arena(&system_allocator, 256);
+    HArenaDetailedStats stats;
+
+    h_arena_malloc(arena, 100);
+    h_arena_malloc_noinit(arena, 100);
+    h_arena_malloc(arena, 100); // starts a second block
+    h_arena_malloc_noinit(arena, 1000);
+    h_allocator_detailed_stats(arena, &stats);
+    g_check_cmp_int(stats.blocks, ==, 3);
+    g_check_cmp_int(stats.arena_malloc_count, ==, 4);
+    g_check_cmp_int(stats.arena_malloc_bytes, ==, 1300);
+    g_check_cmp_int(stats.arena_si_malloc_count, ==, 2);
+    g_check_cmp_int(stats.arena_su_malloc_count, ==, 1);
+    g_check_cmp_int(stats.arena_lu_malloc_count, ==, 1);
+    g_check_cmp_int(stats.arena_lu_malloc_bytes, ==, 1000);
+    g_check_cmp_int(stats.memset_bytes, ==, 200);
+    g_check_cmp_int(stats.mm_malloc_count, ==, 4);
+
+    // counts survive a reset; blocks are what the arena holds now
+    h_arena_reset(arena);
+    h_arena_malloc(arena, 10);
+    h_allocator_detailed_stats(arena, &stats);
+    g_check_cmp_int(stats.blocks, ==, 1);
+    g_check_cmp_int(stats.arena_malloc_count, ==, 5);
+
+    h_arena_malloc(child, 20);
+    h_arena_adopt(arena, child);
+    h_allocator_detailed_stats(arena, &stats);
+    g_check_cmp_int(stats.blocks, ==, 2);
+    g_check_cmp_int(stats.arena_malloc_count, ==, 6);
+    g_check_cmp_int(stats.arena_malloc_bytes, ==, 1330);
+    h_delete_arena(arena);
+}
+
+static void test_alloc_tracker(void) {
+    HAllocTracker t;
+    h_alloc_tracker_init(&t, &system_allocator);
+    HAllocator *mm__ = &t.allocator;
+
+    char *a = h_alloc(mm__, 10);
+    char *b = h_alloc(mm__, 1000);
+    memset(a, 'a', 10);
+    g_check_cmp_uint64(t.live, ==, 1010);
+    a = h_realloc(mm__, a, 100);
+    g_check_cmp_int(a[9], ==, 'a');
+    g_check_cmp_uint64(t.live, ==, 1100);
+    g_check_cmp_uint64(t.peak, ==, 1100);
+    h_free(b);
+    g_check_cmp_uint64(t.live, ==, 100);
+    g_check_cmp_uint64(t.peak, ==, 1100);
+    g_check_cmp_uint64(t.allocs, ==, 3);
+    g_check_cmp_uint64(t.frees, ==, 1);
+    g_check_cmp_uint64(t.bytes, ==, 1110);
+    g_check_cmp_uint64(t.size_classes[0], ==, 1); // 10
+    g_check_cmp_uint64(t.size_classes[3], ==, 1); // 100, up to 128
+    g_check_cmp_uint64(t.size_classes[6], ==, 1); // 1000, up to 1024
+
+    // the peak starts over from what is held
+    h_alloc_tracker_reset(&t);
+    g_check_cmp_uint64(t.peak, ==, 100);
+    g_check_cmp_uint64(t.allocs, ==, 0);
+
+    // arenas get their blocks from the tracker too
+    HArena *arena = h_new_arena(mm__, 0);
+    h_arena_malloc(arena, 64 * 1024);
+    g_check_cmp_uint64(t.peak, >, 64 * 1024);
+    g_check_cmp_uint64(t.size_classes[H_ALLOC_SIZE_CLASSES - 1], ==, 0);
+    h_delete_arena(arena);
+    h_free(a);
+    g_check_cmp_uint64(t.live, ==, 0);
+}
+
 void register_allocator_tests(void) {
     g_test_add_func("/core/allocator/alloc_null_mm", test_alloc_null_mm);
     g_test_add_func("/core/allocator/realloc", test_realloc);
@@ -164,6 +274,10 @@ void register_allocator_tests(void) {
     g_test_add_func("/core/allocator/arena_set_except", test_arena_set_except);
     g_test_add_func("/core/allocator/arena_realloc", test_arena_realloc);
     g_test_add_func("/core/allocator/allocator_stats", test_allocator_stats);
+    g_test_add_func("/core/allocator/arena_counts", test_arena_counts);
     g_test_add_func("/core/allocator/arena_free", test_arena_free);
     g_test_add_func("/core/allocator/delete_arena", test_delete_arena);
+    g_test_add_func("/core/allocator/arena_reset", test_arena_reset);
+    g_test_add_func("/core/allocator/arena_adopt", test_arena_adopt);
+    g_test_add_func("/core/allocator/alloc_tracker", test_alloc_tracker);
 }
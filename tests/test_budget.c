@@ -0,0 +1,144 @@
+#include "glue.h"
+#include "hammer.h"
+#include "test_suite.h"
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LENGTH 100000
+
+static HParser *grammar(void) {
+    H_RULE(list, h_sequence(h_sepBy1(expr_grammar(), h_ch(',')), h_end_p(), NULL));
+    return list;
+}
+
+// "1+2,3,1+2,3,...", LENGTH bytes of it
+static uint8_t *input(void) {
+    uint8_t *buf = malloc(LENGTH);
+    for (size_t i = 0; i < LENGTH; i++)
+        buf[i] = "1+2,3,"[i % 6];
+    buf[LENGTH - 1] = '9'; // end on a number
+    return buf;
+}
+
+static void test_budget_unlimited(void) {
+    HParser *p = grammar();
+    uint8_t *in = input();
+    HParseBudget budget = {0};
+    HParseOptions opts = {.budget = &budget};
+
+    g_check_cmp_int(h_compile(p, PB_PACKRAT, NULL), ==, 0);
+    HParseResult *r = h_parse_with_options(p, in, LENGTH, &opts);
+    g_check_cmp_ptr(r, !=, NULL);
+    g_check_cmp_int(budget.exceeded, ==, H_BUDGET_OK);
+    g_check_cmp_uint64(budget.steps, >, LENGTH / 2);
+    h_parse_result_free(r);
+    free(in);
+}
+
+static void test_budget_steps(void) {
+    HParser *p = grammar();
+    uint8_t *in = input();
+    HParseBudget budget = {.max_steps = 1000};
+    HParseOptions opts = {.budget = &budget};
+
+    g_check_cmp_int(h_compile(p, PB_PACKRAT, NULL), ==, 0);
+    g_check_cmp_ptr(h_parse_with_options(p, in, LENGTH, &opts), ==, NULL);
+    g_check_cmp_int(budget.exceeded, ==, H_BUDGET_STEPS);
+    g_check_cmp_uint64(budget.steps, ==, 1001);
+    g_check_string(h_budget_reason_name(budget.exceeded), ==, "steps");
+
+    // the same budget, reset by the next parse, is plenty for a short input
+    HParseResult *r = h_parse_with_options(p, (const uint8_t *)"1+2,3", 5, &opts);
+    g_check_cmp_ptr(r, !=, NULL);
+    g_check_cmp_int(budget.exceeded, ==, H_BUDGET_OK);
+    h_parse_result_free(r);
+    free(in);
+}
+
+static void test_budget_memo(void) {
+    HParser *p = grammar();
+    uint8_t *in = input();
+    HParseStats stats;
+    HParseBudget budget = {.max_memo_entries = 100};
+    HParseOptions opts = {.budget = &budget, .stats = &stats};
+
+    g_check_cmp_int(h_compile(p, PB_PACKRAT, NULL), ==, 0);
+    g_check_cmp_ptr(h_parse_with_options(p, in, LENGTH, &opts), ==, NULL);
+    g_check_cmp_int(budget.exceeded, ==, H_BUDGET_MEMO_ENTRIES);
+    // the stats are those of the parse up to where it stopped
+    g_check_cmp_uint64(stats.memo_entries, ==, 101);
+    free(in);
+}
+
+static void test_budget_arena(void) {
+    HParser *p = grammar();
+    uint8_t *in = input();
+    HParseBudget budget = {.max_arena_bytes = 64 * 1024};
+    HParseOptions opts = {.budget = &budget};
+
+    g_check_cmp_int(h_compile(p, PB_PACKRAT, NULL), ==, 0);
+    g_check_cmp_ptr(h_parse_with_options(p, in, LENGTH, &opts), ==, NULL);
+    g_check_cmp_int(budget.exceeded, ==, H_BUDGET_ARENA_BYTES);
+    g_check_cmp_uint64(budget.steps % H_BUDGET_INTERVAL, ==, 0);
+    free(in);
+}
+
+static void test_budget_deadline(void) {
+    HParser *p = grammar();
+    uint8_t *in = input();
+    HParseBudget budget = {.deadline_ns = 1};
+    HParseOptions opts = {.budget = &budget};
+
+    g_check_cmp_int(h_compile(p, PB_PACKRAT, NULL), ==, 0);
+    g_check_cmp_ptr(h_parse_with_options(p, in, LENGTH, &opts), ==, NULL);
+    g_check_cmp_int(budget.exceeded, ==, H_BUDGET_DEADLINE);
+    g_check_cmp_uint64(budget.steps, ==, H_BUDGET_INTERVAL);
+    free(in);
+}
+
+// A choice of literals counts a call of the one that matches, as well as its own.
+static void test_budget_literals(void) {
+    HParser *p = h_choice(h_token((const uint8_t *)"abc", 3), h_token((const uint8_t *)"abd", 3),
+                          NULL);
+    HParseBudget budget = {.max_steps = 1};
+    HParseOptions opts = {.budget = &budget};
+
+    g_check_cmp_int(h_compile(p, PB_PACKRAT, NULL), ==, 0);
+    g_check_cmp_ptr(h_parse_with_options(p, (const uint8_t *)"abd", 3, &opts), ==, NULL);
+    g_check_cmp_int(budget.exceeded, ==, H_BUDGET_STEPS);
+
+    budget.max_steps = 0;
+    HParseResult *r = h_parse_with_options(p, (const uint8_t *)"abd", 3, &opts);
+    g_check_cmp_ptr(r, !=, NULL);
+    g_check_cmp_uint64(budget.steps, ==, 3);
+    h_parse_result_free(r);
+}
+
+// So does a sequence of literals, which h_compile fuses into one comparison.
+static void test_budget_literal_run(void) {
+    HParser *p = h_sequence(h_ch('a'), h_ch('b'), h_ch('c'), h_ch('d'), NULL);
+    HParseBudget budget = {.max_steps = 2};
+    HParseOptions opts = {.budget = &budget};
+
+    g_check_cmp_int(h_compile(p, PB_PACKRAT, NULL), ==, 0);
+    g_check_cmp_ptr(h_parse_with_options(p, (const uint8_t *)"abcd", 4, &opts), ==, NULL);
+    g_check_cmp_int(budget.exceeded, ==, H_BUDGET_STEPS);
+
+    budget.max_steps = 0;
+    HParseResult *r = h_parse_with_options(p, (const uint8_t *)"abcd", 4, &opts);
+    g_check_cmp_ptr(r, !=, NULL);
+    g_check_cmp_uint64(budget.steps, ==, 5);
+    h_parse_result_free(r);
+}
+
+void register_budget_tests(void) {
+    g_test_add_func("/core/budget/unlimited", test_budget_unlimited);
+    g_test_add_func("/core/budget/steps", test_budget_steps);
+    g_test_add_func("/core/budget/memo", test_budget_memo);
+    g_test_add_func("/core/budget/arena", test_budget_arena);
+    g_test_add_func("/core/budget/deadline", test_budget_deadline);
+    g_test_add_func("/core/budget/literals", test_budget_literals);
+    g_test_add_func("/core/budget/literal_run", test_budget_literal_run);
+}
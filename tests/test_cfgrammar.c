@@ -420,6 +420,7 @@ static void test_stringmap_get_lookahead(void) {
     lookahead.endianness = 0;
     lookahead.overrun = false;
     lookahead.last_chunk = true;
+    lookahead.segments = NULL;
 
     void *result = h_stringmap_get_lookahead(m, lookahead);
     g_check_cmp_ptr(result, ==, value);
@@ -439,6 +440,7 @@ static void test_stringmap_get_lookahead(void) {
     lookahead2.endianness = 0;
     lookahead2.overrun = true;
     lookahead2.last_chunk = true;
+    lookahead2.segments = NULL;
 
     result = h_stringmap_get_lookahead(m2, lookahead2);
     g_check_cmp_ptr(result, ==, end_value);
@@ -457,6 +459,7 @@ static void test_stringmap_get_lookahead(void) {
     lookahead3.endianness = 0;
     lookahead3.overrun = true;
     lookahead3.last_chunk = false;
+    lookahead3.segments = NULL;
 
     result = h_stringmap_get_lookahead(m3, lookahead3);
     g_check_cmp_ptr(result, ==, NEED_INPUT);
@@ -473,6 +476,7 @@ static void test_stringmap_get_lookahead(void) {
     lookahead4.endianness = 0;
     lookahead4.overrun = false;
     lookahead4.last_chunk = true;
+    lookahead4.segments = NULL;
 
     result = h_stringmap_get_lookahead(m4, lookahead4);
     g_check_cmp_ptr(result, ==, NULL);
@@ -0,0 +1,121 @@
+#include "glue.h"
+#include "hammer.h"
+#include "test_suite.h"
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+
+// Both alternatives parse a number with parsers of their own, so the second
+// one has to parse it again once the first fails on the byte after it.
+static HParser *backtracking(void) {
+    H_RULE(x, h_sequence(h_many1(h_ch_range('0', '9')), h_ch('x'), NULL));
+    H_RULE(y, h_sequence(h_many1(h_ch_range('0', '9')), h_ch('y'), NULL));
+    H_RULE(xy, h_choice(x, y, NULL));
+    return xy;
+}
+
+// expr = expr '+' digit | digit
+static HParser *left_recursive(void) {
+    H_RULE(digit, h_ch_range('0', '9'));
+    HParser *expr = h_indirect();
+    h_bind_indirect(expr, h_choice(h_sequence(expr, h_ch('+'), digit, NULL), digit, NULL));
+    h_name(expr, "expr");
+    return expr;
+}
+
+static void report(const HComplexity *c, char *buf, size_t size) {
+    FILE *tmp = tmpfile();
+    h_complexity_report(tmp, c);
+    rewind(tmp);
+    size_t len = fread(buf, 1, size - 1, tmp);
+    buf[len] = 0;
+    fclose(tmp);
+}
+
+static void test_complexity_backtracking(void) {
+    HParser *p = backtracking();
+    HComplexityStats stats;
+    char buf[4096];
+
+    g_check_cmp_int(h_compile(p, PB_PACKRAT, NULL), ==, 0);
+    HComplexity *c = h_complexity_new(p);
+    h_complexity_stats(c, &stats);
+    g_check_cmp_uint64(stats.overlapping_choices, ==, 1);
+    g_check_cmp_uint64(stats.left_recursive, ==, 0);
+    g_check_cmp_uint64(stats.parses, ==, 0);
+
+    HParseOptions opts = {.complexity = c};
+    HParseResult *r = h_parse_with_options(p, (const uint8_t *)"123y", 4, &opts);
+    g_check_cmp_ptr(r, !=, NULL);
+    h_parse_result_free(r);
+    h_complexity_stats(c, &stats);
+    g_check_cmp_uint64(stats.parses, ==, 1);
+    g_check_cmp_uint64(stats.reparses, >=, 1);
+    g_check_cmp_uint64(stats.reparses, <, stats.evaluations);
+    g_check_cmp_uint64(stats.max_backtrack, ==, 3);
+    g_check_cmp_uint64(stats.max_backtrack_pos, ==, 0);
+    g_check_cmp_uint64(stats.max_depth, >=, 2);
+
+    // no backtracking when the first alternative matches
+    r = h_parse_with_options(p, (const uint8_t *)"123x", 4, &opts);
+    h_parse_result_free(r);
+    HComplexityStats again;
+    h_complexity_stats(c, &again);
+    g_check_cmp_uint64(again.parses, ==, 2);
+    g_check_cmp_uint64(again.reparses, ==, stats.reparses);
+
+    report(c, buf, sizeof(buf));
+    g_check_cmp_int(strncmp(buf, "complexity of xy over 2 parses\n", 31), ==, 0);
+    g_check_cmp_ptr(strstr(buf, "3 bytes, to byte 0, in xy\n"), !=, NULL);
+    g_check_cmp_ptr(strstr(buf, "  xy   "), !=, NULL);
+    g_check_cmp_ptr(strstr(buf, "alternatives 1 and 2 on '0', and 9 more bytes"), !=, NULL);
+    g_check_cmp_ptr(strstr(buf, "  xy: make it a dispatch table"), !=, NULL);
+    h_complexity_free(c);
+}
+
+static void test_complexity_memo(void) {
+    // sum fails after number matched; the second try at number is a cache
+    // hit, which costs nothing to re-parse
+    HParser *expr = expr_grammar();
+    HComplexityStats stats;
+
+    g_check_cmp_int(h_compile(expr, PB_PACKRAT, NULL), ==, 0);
+    HComplexity *c = h_complexity_new(expr);
+    HParseOptions opts = {.complexity = c};
+    h_parse_result_free(h_parse_with_options(expr, (const uint8_t *)"123", 3, &opts));
+    h_complexity_stats(c, &stats);
+    g_check_cmp_uint64(stats.overlapping_choices, ==, 1);
+    g_check_cmp_uint64(stats.reparses, ==, 0);
+    g_check_cmp_uint64(stats.max_backtrack, ==, 0);
+    h_complexity_free(c);
+}
+
+static void test_complexity_left_recursion(void) {
+    HParser *p = left_recursive();
+    HComplexityStats stats;
+    char buf[4096];
+
+    g_check_cmp_int(h_compile(p, PB_PACKRAT, NULL), ==, 0);
+    HComplexity *c = h_complexity_new(p);
+    h_complexity_stats(c, &stats);
+    g_check_cmp_uint64(stats.left_recursive, >=, 1);
+
+    HParseOptions opts = {.complexity = c};
+    HParseResult *r = h_parse_with_options(p, (const uint8_t *)"1+2+3", 5, &opts);
+    g_check_cmp_ptr(r, !=, NULL);
+    h_parse_result_free(r);
+    h_complexity_stats(c, &stats);
+    g_check_cmp_uint64(stats.lr_grows, >=, 3);
+
+    report(c, buf, sizeof(buf));
+    g_check_cmp_ptr(strstr(buf, "\n  expr "), !=, NULL);
+    g_check_cmp_ptr(strstr(buf, "  expr: left-recursive, grown "), !=, NULL);
+    h_complexity_free(c);
+}
+
+void register_complexity_tests(void) {
+    g_test_add_func("/core/complexity/backtracking", test_complexity_backtracking);
+    g_test_add_func("/core/complexity/memo", test_complexity_memo);
+    g_test_add_func("/core/complexity/left_recursion", test_complexity_left_recursion);
+}
@@ -4,6 +4,7 @@
 #include "test_suite.h"
 
 #include <glib.h>
+#include <stddef.h>
 
 HParsedToken *act_param_name(const HParseResult *p, void *user_data);
 static void test_hammer_backend_available_invalid(void) {
@@ -267,6 +268,96 @@ static void test_hammer_parse_result_free_m_null(void) {
     h_parse_result_free__m(&system_allocator, NULL);
 }
 
+static void test_hammer_parse_batch(void) {
+    HParser *num = h_many1(h_ch_range('0', '9'));
+    HParser *expr = h_indirect();
+    h_bind_indirect(expr, h_choice(h_sequence(expr, h_ch('+'), num, NULL), num, NULL));
+    HParser *parser = h_sequence(expr, h_end_p(), NULL);
+    h_compile(parser, PB_PACKRAT, NULL);
+
+    const char *msgs[] = {"1+2", "12", "+", "3+45+6", "", "7+"};
+    const uint8_t *inputs[6];
+    size_t lengths[6];
+    HParseResult *results[6];
+    for (int i = 0; i < 6; i++) {
+        inputs[i] = (const uint8_t *)msgs[i];
+        lengths[i] = strlen(msgs[i]);
+    }
+
+    g_check_cmp_int(h_parse_batch(parser, inputs, lengths, 6, results), ==, 3);
+    for (int i = 0; i < 6; i++) {
+        HParseResult *single = h_parse(parser, inputs[i], lengths[i]);
+        g_check_cmp_int(single != NULL, ==, results[i] != NULL);
+        if (single && results[i]) {
+            char *a = h_write_result_unamb(results[i]->ast);
+            char *b = h_write_result_unamb(single->ast);
+            g_check_string(a, ==, b);
+            g_check_cmp_int64(results[i]->bit_length, ==, single->bit_length);
+            system_allocator.free(&system_allocator, a);
+            system_allocator.free(&system_allocator, b);
+        }
+        h_parse_result_free(single);
+    }
+    g_check_cmp_ptr(results[0]->arena, ==, results[3]->arena);
+    h_parse_batch_free(results, 6);
+
+    g_check_cmp_int(h_parse_batch(parser, inputs + 4, lengths + 4, 2, results), ==, 0);
+    h_parse_batch_free(results, 2);
+}
+
+static void test_hammer_parse_batch_parallel(void) {
+    HParser *num = h_many1(h_ch_range('0', '9'));
+    HParser *expr = h_indirect();
+    h_bind_indirect(expr, h_choice(h_sequence(expr, h_ch('+'), num, NULL), num, NULL));
+    HParser *parser = h_sequence(expr, h_end_p(), NULL);
+    h_compile(parser, PB_PACKRAT, NULL);
+
+    enum { N = 2000 };
+    char *msgs[N];
+    const uint8_t *inputs[N];
+    size_t lengths[N];
+    HParseResult *results[N];
+    size_t expect_ok = 0;
+    for (int i = 0; i < N; i++) {
+        msgs[i] = g_strdup_printf(i % 7 == 3 ? "%d+" : "%d+%d+%d", i, i % 13, i * 31);
+        inputs[i] = (const uint8_t *)msgs[i];
+        lengths[i] = strlen(msgs[i]);
+        if (i % 7 != 3)
+            expect_ok++;
+    }
+
+    HThreadPool *pool = h_thread_pool_new(4);
+    g_check_cmp_int(h_parse_batch_parallel(pool, parser, inputs, lengths, N, results), ==,
+                    expect_ok);
+    size_t mismatches = 0;
+    for (int i = 0; i < N; i++) {
+        HParseResult *single = h_parse(parser, inputs[i], lengths[i]);
+        if ((single != NULL) != (results[i] != NULL)) {
+            mismatches++;
+        } else if (single) {
+            char *a = h_write_result_unamb(results[i]->ast);
+            char *b = h_write_result_unamb(single->ast);
+            if (strcmp(a, b) != 0 || results[i]->arena != results[0]->arena)
+                mismatches++;
+            system_allocator.free(&system_allocator, a);
+            system_allocator.free(&system_allocator, b);
+        }
+        h_parse_result_free(single);
+        g_free(msgs[i]);
+    }
+    g_check_cmp_int(mismatches, ==, 0);
+    h_parse_batch_free(results, N);
+    h_thread_pool_free(pool);
+}
+
+// HParser keeps the layout applications were built against; a name is kept
+// beside it, by the library.
+static void test_hammer_parser_layout(void) {
+    g_check_cmp_size(sizeof(HParser), ==, offsetof(HParser, desugared) + sizeof(HCFChoice *));
+    HParser *p = h_name(h_ch('a'), "a");
+    g_check_string(h_parser_private(p)->name, ==, "a");
+}
+
 void register_hammer_tests(void) {
     g_test_add_func("/core/hammer/backend_available_invalid",
                     test_hammer_backend_available_invalid);
@@ -310,4 +401,7 @@ void register_hammer_tests(void) {
     g_test_add_func("/core/hammer/act_param_name", test_hammer_act_param_name);
     g_test_add_func("/core/hammer/parse_result_free_m", test_hammer_parse_result_free_m);
     g_test_add_func("/core/hammer/parse_result_free_m_null", test_hammer_parse_result_free_m_null);
+    g_test_add_func("/core/hammer/parse_batch", test_hammer_parse_batch);
+    g_test_add_func("/core/hammer/parse_batch_parallel", test_hammer_parse_batch_parallel);
+    g_test_add_func("/core/hammer/parser_layout", test_hammer_parser_layout);
 }
@@ -0,0 +1,147 @@
+#include "glue.h"
+#include "hammer.h"
+#include "test_suite.h"
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static bool not_zero(HParseResult *p, void *user_data) { return p->ast->uint != 0; }
+
+static HParsedToken *act_scale(const HParseResult *p, void *user_data) {
+    return H_MAKE_UINT(H_CAST_UINT(p->ast) * *(const uint64_t *)user_data);
+}
+
+static uint64_t ten = 10;
+
+static const HImageSymbol symbols[] = {
+    H_IMAGE_FUNCTION(not_zero),
+    H_IMAGE_FUNCTION(act_scale),
+    H_IMAGE_DATA(&ten),
+};
+#define NSYMBOLS (sizeof(symbols) / sizeof(symbols[0]))
+
+// Literals, charsets, a choice with a dispatch table and one with a trie,
+// actions with and without user_data, and a cycle.
+static HParser *grammar(void) {
+    H_RULE(digit, h_ch_range('0', '9'));
+    H_RULE(word, h_many1(h_choice(h_ch_range('a', 'z'), h_ch('_'), NULL)));
+    H_RULE(number, h_action(h_attr_bool(h_uint8(), not_zero, NULL), act_scale, &ten));
+    H_RULE(keyword, h_choice(h_token((const uint8_t *)"let", 3),
+                             h_token((const uint8_t *)"lets", 4), h_ch('!'), NULL));
+    H_RULE(list, h_middle(h_ch('['), h_sepBy(digit, h_ch(',')), h_ch(']')));
+    H_RULE(arrow, h_sequence(h_ch('-'), h_ch('>'), h_ignore(h_ch(' ')), word, NULL));
+
+    HParser *expr = h_indirect();
+    H_RULE(group, h_middle(h_ch('('), expr, h_ch(')')));
+    H_RULE(item, h_choice(group, keyword, arrow, word, list,
+                          h_right(h_ch('#'), h_action(h_sequence(number, NULL), h_act_first, NULL)),
+                          NULL));
+    h_bind_indirect(expr, h_sepBy1(item, h_ch(' ')));
+    return h_sequence(expr, h_end_p(), NULL);
+}
+
+static const char *inputs[] = {
+    "let", "lets", "!", "abc_d", "[1,2,3]", "(let (x))",
+    "-> ab", "->ab", "#\x05", "#\x00", "", NULL,
+};
+
+static void check_same(const HParser *a, const HParser *b) {
+    for (const char **in = inputs; *in; in++) {
+        size_t len = **in == '#' ? 2 : strlen(*in);
+        HParseResult *ra = h_parse(a, (const uint8_t *)*in, len);
+        HParseResult *rb = h_parse(b, (const uint8_t *)*in, len);
+        g_check_cmp_int(ra == NULL, ==, rb == NULL);
+        if (ra && rb) {
+            char *sa = h_write_result_unamb(ra->ast);
+            char *sb = h_write_result_unamb(rb->ast);
+            g_check_string(sa, ==, sb);
+            system_allocator.free(&system_allocator, sa);
+            system_allocator.free(&system_allocator, sb);
+        }
+        h_parse_result_free(ra);
+        h_parse_result_free(rb);
+    }
+}
+
+static void test_image_roundtrip(void) {
+    HParser *orig = grammar();
+    size_t len;
+
+    g_check_cmp_int(h_compile(orig, PB_PACKRAT, NULL), ==, 0);
+    uint8_t *image = h_image_write(orig, symbols, NSYMBOLS, &len);
+    g_check_cmp_ptr(image, !=, NULL);
+
+    // ready to parse without compiling again
+    HParser *loaded = h_image_read(image, len, symbols, NSYMBOLS);
+    g_check_cmp_ptr(loaded, !=, NULL);
+    check_same(orig, loaded);
+    g_check_parse_match_no_compile(loaded, "#\x05", 2, "((u0x32))");
+    h_relocated_free(loaded);
+    system_allocator.free(&system_allocator, image);
+}
+
+static void test_image_symbols(void) {
+    HParser *orig = grammar();
+    size_t len;
+
+    // every pointer out of the graph needs a name
+    g_check_cmp_ptr(h_image_write(orig, symbols, 1, &len), ==, NULL);
+
+    uint8_t *image = h_image_write(orig, symbols, NSYMBOLS, &len);
+    g_check_cmp_ptr(image, !=, NULL);
+    // and the reader has to know it
+    g_check_cmp_ptr(h_image_read(image, len, symbols, 2), ==, NULL);
+
+    // names are what count, not addresses
+    static uint64_t hundred = 100;
+    HImageSymbol renamed[NSYMBOLS];
+    memcpy(renamed, symbols, sizeof(symbols));
+    renamed[2].data = &hundred;
+    HParser *loaded = h_image_read(image, len, renamed, NSYMBOLS);
+    g_check_cmp_ptr(loaded, !=, NULL);
+    g_check_parse_match_no_compile(loaded, "#\x05", 2, "((u0x1f4))");
+    h_relocated_free(loaded);
+    system_allocator.free(&system_allocator, image);
+}
+
+static void test_image_malformed(void) {
+    HParser *orig = grammar();
+    size_t len;
+    uint8_t *image = h_image_write(orig, symbols, NSYMBOLS, &len);
+
+    g_check_cmp_ptr(h_image_read(image, len - 1, symbols, NSYMBOLS), ==, NULL);
+    g_check_cmp_ptr(h_image_read(image, 8, symbols, NSYMBOLS), ==, NULL);
+    image[0] ^= 1;
+    g_check_cmp_ptr(h_image_read(image, len, symbols, NSYMBOLS), ==, NULL);
+    system_allocator.free(&system_allocator, image);
+}
+
+static void test_image_load(void) {
+    HParser *orig = grammar();
+    char path[] = "/tmp/hammer-image-XXXXXX";
+    size_t len;
+
+    g_check_cmp_int(h_compile(orig, PB_PACKRAT, NULL), ==, 0);
+    uint8_t *image = h_image_write(orig, symbols, NSYMBOLS, &len);
+    int fd = mkstemp(path);
+    g_check_cmp_int(fd, >=, 0);
+    g_check_cmp_int64(write(fd, image, len), ==, (int64_t)len);
+    close(fd);
+
+    HParser *loaded = h_image_load(path, symbols, NSYMBOLS);
+    unlink(path);
+    g_check_cmp_ptr(loaded, !=, NULL);
+    check_same(orig, loaded);
+    h_relocated_free(loaded);
+    system_allocator.free(&system_allocator, image);
+    g_check_cmp_ptr(h_image_load(path, symbols, NSYMBOLS), ==, NULL);
+}
+
+void register_image_tests(void) {
+    g_test_add_func("/core/image/roundtrip", test_image_roundtrip);
+    g_test_add_func("/core/image/symbols", test_image_symbols);
+    g_test_add_func("/core/image/malformed", test_image_malformed);
+    g_test_add_func("/core/image/load", test_image_load);
+}
@@ -0,0 +1,115 @@
+#include "glue.h"
+#include "hammer.h"
+#include "test_suite.h"
+
+#include <glib.h>
+#include <string.h>
+
+// Parse every input with both parsers and count the inputs on which they disagree.
+static size_t count_differences(const HParser *a, const HParser *b, const char **inputs) {
+    size_t diffs = 0;
+    for (const char **in = inputs; *in; in++) {
+        HParseResult *ra = h_parse(a, (const uint8_t *)*in, strlen(*in));
+        HParseResult *rb = h_parse(b, (const uint8_t *)*in, strlen(*in));
+        if (!ra || !rb) {
+            diffs += ra != rb;
+        } else {
+            char *sa = h_write_result_unamb(ra->ast);
+            char *sb = h_write_result_unamb(rb->ast);
+            if (strcmp(sa, sb) != 0 || ra->bit_length != rb->bit_length) {
+                g_test_message("input \"%s\": %s vs. %s", *in, sa, sb);
+                diffs++;
+            }
+            system_allocator.free(&system_allocator, sa);
+            system_allocator.free(&system_allocator, sb);
+        }
+        h_parse_result_free(ra);
+        h_parse_result_free(rb);
+    }
+    return diffs;
+}
+
+static HParser *markup(void) {
+    H_RULE(name, h_many1(h_choice(h_ch('a'), h_ch('b'), h_ch_range('c', 'z'), NULL)));
+    H_RULE(open, h_sequence(h_ignore(h_ch('<')), name, h_ignore(h_ch('>')), NULL));
+    H_RULE(comment, h_sequence(h_ignore(h_sequence(h_ch('<'), h_token((const uint8_t *)"!--", 3),
+                                                   NULL)),
+                               h_many(h_ch_range('a', 'z')),
+                               h_ignore(h_ch('-')),
+                               h_ignore(h_ignore(h_token((const uint8_t *)"->", 2))), NULL));
+    HParser *item = h_indirect();
+    h_bind_indirect(item, h_choice(h_choice(comment, open, NULL), h_choice(name, NULL), NULL));
+    return h_sequence(h_many(item), h_end_p(), NULL);
+}
+
+static const char *markup_inputs[] = {
+    "", "abc", "<abc>", "<!--xyz-->", "<!--x-->q<b>", "<!--", "<a", "<>", "a<b>c<!---->", NULL,
+};
+
+static void test_optimize_equivalent(void) {
+    HParser *plain = markup();
+    HParser *opt = markup();
+    HOptimizeStats stats;
+
+    h_optimize(opt, H_OPT_ALL, &stats);
+    g_check_cmp_int(count_differences(plain, opt, markup_inputs), ==, 0);
+    g_check_cmp_int(stats.parsers_after, <, stats.parsers_before);
+    g_check_cmp_int(stats.indirects_inlined, ==, 1);
+    g_check_cmp_int(stats.choices_flattened, >=, 3);
+    g_check_cmp_int(stats.charsets_merged, ==, 2);
+    g_check_cmp_int(stats.ignores_collapsed, ==, 1);
+    g_check_cmp_int(stats.literals_fused, ==, 2);
+
+    g_check_cmp_int(h_compile(opt, PB_PACKRAT, NULL), ==, 0);
+    g_check_cmp_int(count_differences(plain, opt, markup_inputs), ==, 0);
+}
+
+static void test_optimize_passes(void) {
+    HOptimizeStats stats;
+    HParser *p = markup();
+
+    h_optimize(p, H_OPT_MERGE_CHARSETS, &stats);
+    g_check_cmp_int(stats.charsets_merged, ==, 2);
+    g_check_cmp_int(stats.choices_flattened, ==, 0);
+    g_check_cmp_int(stats.indirects_inlined, ==, 0);
+    g_check_cmp_int(stats.literals_fused, ==, 0);
+
+    // without flattening, the doubled ignore hides its token
+    h_optimize(p, H_OPT_FUSE_LITERALS, &stats);
+    g_check_cmp_int(stats.literals_fused, ==, 1);
+    g_check_cmp_int(stats.charsets_merged, ==, 0);
+
+    h_optimize(p, 0, &stats);
+    g_check_cmp_int(stats.parsers_after, ==, stats.parsers_before);
+    g_check_cmp_int(count_differences(markup(), p, markup_inputs), ==, 0);
+}
+
+static HParser *arith(void) {
+    HParser *num = h_many1(h_ch_range('0', '9'));
+    HParser *expr = h_indirect();
+    HParser *atom = h_choice(num, h_middle(h_ch('('), expr, h_ch(')')), NULL);
+    h_bind_indirect(expr, h_choice(h_sequence(expr, h_choice(h_ch('+'), h_ch('-'), NULL), atom,
+                                              NULL),
+                                   atom, NULL));
+    return expr;
+}
+
+static void test_optimize_recursive(void) {
+    static const char *inputs[] = {"1", "1+2", "(1-2)+3", "((4))", "1+", "(", NULL};
+    HParser *plain = arith();
+    HParser *opt = arith();
+    HOptimizeStats stats;
+
+    h_optimize(opt, H_OPT_ALL, &stats);
+    // the indirect closes the only cycle and has to stay
+    g_check_cmp_int(stats.indirects_inlined, ==, 0);
+    g_check_cmp_int(stats.charsets_merged, ==, 1);
+    g_check_cmp_int(opt->vtable->isValidCF(opt->env), ==, true);
+    g_check_cmp_int(count_differences(plain, opt, inputs), ==, 0);
+}
+
+void register_optimize_tests(void) {
+    g_test_add_func("/core/optimize/equivalent", test_optimize_equivalent);
+    g_test_add_func("/core/optimize/passes", test_optimize_passes);
+    g_test_add_func("/core/optimize/recursive", test_optimize_recursive);
+}
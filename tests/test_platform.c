@@ -89,6 +89,27 @@ static void test_platform_errx_compiles(void) {
     // If we reach here, compilation succeeded
 }
 
+// Test platform.c: the software events are counted with or without perf_event
+static void test_platform_perf(void) {
+    struct HPerfCounters pc;
+    uint64_t value;
+    bool hardware = h_platform_perf_open(&pc);
+    h_platform_perf_start(&pc);
+    volatile uint64_t sink = 0;
+    for (int i = 0; i < 1000000; i++)
+        sink += (uint64_t)i;
+    h_platform_perf_stop(&pc);
+
+    g_check_cmp_int(h_platform_perf_read(&pc, H_PERF_TASK_CLOCK_NS, &value), ==, true);
+    g_check_cmp_uint64(value, >, 0);
+    g_check_cmp_int(h_platform_perf_read(&pc, H_PERF_PAGE_FAULTS, &value), ==, true);
+    g_check_cmp_int(h_platform_perf_read(&pc, H_PERF_CONTEXT_SWITCHES, &value), ==, true);
+    if (hardware && h_platform_perf_read(&pc, H_PERF_INSTRUCTIONS, &value))
+        g_check_cmp_uint64(value, >=, 1000000);
+    g_check_cmp_int(h_platform_perf_read(&pc, H_PERF_NEVENTS, &value), ==, false);
+    h_platform_perf_close(&pc);
+}
+
 void register_platform_tests(void) {
     g_test_add_func("/core/platform/asprintf", test_platform_asprintf);
     g_test_add_func("/core/platform/asprintf_null_strp", test_platform_asprintf_null_strp);
@@ -98,4 +119,5 @@ void register_platform_tests(void) {
     g_test_add_func("/core/platform/stopwatch_ns", test_platform_stopwatch_ns);
     g_test_add_func("/core/platform/stopwatch_ns_negative", test_platform_stopwatch_ns_negative);
     g_test_add_func("/core/platform/errx_compiles", test_platform_errx_compiles);
+    g_test_add_func("/core/platform/perf", test_platform_perf);
 }
@@ -0,0 +1,121 @@
+#include "glue.h"
+#include "hammer.h"
+#include "test_suite.h"
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+
+static HParser *grammar(void) {
+    H_RULE(line, h_sequence(expr_grammar(), h_end_p(), NULL));
+    return line;
+}
+
+static const HProfileEntry *find(const HProfile *profile, const char *name) {
+    for (size_t i = 0; i < h_profile_count(profile); i++) {
+        const HProfileEntry *e = h_profile_entry(profile, i);
+        if (strcmp(e->name, name) == 0)
+            return e;
+    }
+    return NULL;
+}
+
+static void test_profile_counts(void) {
+    HParser *p = grammar();
+    HProfile *profile = h_profile_new();
+    HParseOptions opts = {.profile = profile};
+
+    g_check_cmp_int(h_compile(p, PB_PACKRAT, NULL), ==, 0);
+    HParseResult *r = h_parse_with_options(p, (const uint8_t *)"123", 3, &opts);
+    g_check_cmp_ptr(r, !=, NULL);
+    h_parse_result_free(r);
+
+    const HProfileEntry *line = find(profile, "line");
+    g_check_cmp_ptr(line, !=, NULL);
+    g_check_cmp_uint64(line->calls, ==, 1);
+    g_check_cmp_uint64(line->successes, ==, 1);
+    g_check_cmp_uint64(line->bytes_consumed, ==, 3);
+    g_check_cmp_int(line->inclusive_ns >= line->exclusive_ns, ==, true);
+    g_check_cmp_uint64(line->arena_bytes, >, 0);
+    g_check_cmp_uint64(line->arena_exclusive_bytes, <=, line->arena_bytes);
+
+    // sum fails after number matched; the second try at number is a cache hit
+    const HProfileEntry *sum = find(profile, "sum");
+    g_check_cmp_uint64(sum->calls, ==, 1);
+    g_check_cmp_uint64(sum->failures, ==, 1);
+    const HProfileEntry *number = find(profile, "number");
+    g_check_cmp_uint64(number->calls, ==, 2);
+    g_check_cmp_uint64(number->successes, ==, 2);
+    g_check_cmp_uint64(number->memo_hits, ==, 1);
+    g_check_cmp_uint64(number->memo_misses, ==, 1);
+    g_check_cmp_uint64(number->bytes_consumed, ==, 6);
+    // four tries, the last of which fails
+    const HProfileEntry *digit = find(profile, "digit");
+    g_check_cmp_uint64(digit->calls, ==, 4);
+    g_check_cmp_uint64(digit->failures, ==, 1);
+    // no parser is called within itself, so what each took adds up to the whole
+    uint64_t exclusive = 0;
+    for (size_t i = 0; i < h_profile_count(profile); i++)
+        exclusive += h_profile_entry(profile, i)->arena_exclusive_bytes;
+    g_check_cmp_uint64(exclusive, ==, line->arena_bytes);
+
+    // a profile adds up over parses
+    r = h_parse_with_options(p, (const uint8_t *)"1+2", 3, &opts);
+    g_check_cmp_ptr(r, !=, NULL);
+    h_parse_result_free(r);
+    g_check_cmp_uint64(find(profile, "line")->calls, ==, 2);
+    g_check_cmp_uint64(find(profile, "sum")->successes, ==, 1);
+
+    h_profile_sort(profile, H_PROFILE_BY_CALLS);
+    for (size_t i = 1; i < h_profile_count(profile); i++)
+        g_check_cmp_uint64(h_profile_entry(profile, i - 1)->calls, >=,
+                           h_profile_entry(profile, i)->calls);
+    g_check_cmp_ptr(h_profile_entry(profile, h_profile_count(profile)), ==, NULL);
+    h_profile_free(profile);
+}
+
+static void test_profile_report(void) {
+    HParser *p = grammar();
+    HProfile *profile = h_profile_new();
+    HParseOptions opts = {.profile = profile};
+    char buf[4096];
+
+    g_check_cmp_int(h_compile(p, PB_PACKRAT, NULL), ==, 0);
+    h_parse_result_free(h_parse_with_options(p, (const uint8_t *)"12+3", 4, &opts));
+
+    FILE *tmp = tmpfile();
+    h_profile_report(tmp, profile, H_PROFILE_BY_EXCLUSIVE);
+    rewind(tmp);
+    size_t len = fread(buf, 1, sizeof(buf) - 1, tmp);
+    buf[len] = 0;
+    fclose(tmp);
+    g_check_cmp_int(strncmp(buf, "parser ", 7), ==, 0);
+    g_check_cmp_ptr(strstr(buf, "\nnumber "), !=, NULL);
+    // unnamed parsers go by their kind
+    g_check_cmp_ptr(strstr(buf, "\n<ch "), !=, NULL);
+    h_profile_free(profile);
+}
+
+static void test_profile_off(void) {
+    HParser *p = grammar();
+    HParseOptions opts = {.profile = NULL};
+
+    g_check_cmp_int(h_compile(p, PB_PACKRAT, NULL), ==, 0);
+    HParseResult *a = h_parse_with_options(p, (const uint8_t *)"1+2", 3, &opts);
+    HParseResult *b = h_parse_with_options(p, (const uint8_t *)"1+2", 3, NULL);
+    g_check_cmp_ptr(a, !=, NULL);
+    g_check_cmp_ptr(b, !=, NULL);
+    char *sa = h_write_result_unamb(a->ast);
+    char *sb = h_write_result_unamb(b->ast);
+    g_check_string(sa, ==, sb);
+    system_allocator.free(&system_allocator, sa);
+    system_allocator.free(&system_allocator, sb);
+    h_parse_result_free(a);
+    h_parse_result_free(b);
+}
+
+void register_profile_tests(void) {
+    g_test_add_func("/core/profile/counts", test_profile_counts);
+    g_test_add_func("/core/profile/report", test_profile_report);
+    g_test_add_func("/core/profile/off", test_profile_off);
+}
@@ -4,6 +4,7 @@
 
 #include <glib.h>
 #include <stdio.h>
+#include <string.h>
 
 static void test_registry_allocate_token_new_with_unamb(void) {
     void unamb_sub(const HParsedToken *tok, struct result_buf *buf) {
@@ -99,6 +100,36 @@ static void test_registry_allocate_token_new_realloc_path(void) {
     }
 }
 
+static HTokenType concurrent_ids[64];
+
+static void register_concurrently(void *ctx, size_t worker, size_t item) {
+    char name[64];
+    snprintf(name, sizeof(name), "test.registry.concurrent.%zu", item % 64);
+    HTokenType id = h_allocate_token_type(name);
+    bool *failed = ctx;
+    const char *found = h_get_token_type_name(id);
+    if (h_get_token_type_number(name) != id || !found || strcmp(found, name) != 0)
+        __atomic_store_n(failed, true, __ATOMIC_RELAXED);
+    if (item < 64)
+        concurrent_ids[item] = id;
+}
+
+static void test_registry_concurrent(void) {
+    HThreadPool *pool = h_thread_pool_new(4);
+    bool failed = false;
+    h_thread_pool_run(pool, 4096, register_concurrently, &failed);
+    h_thread_pool_free(pool);
+    g_check_cmp_int(failed, ==, false);
+
+    char name[64];
+    for (size_t i = 0; i < 64; i++) {
+        snprintf(name, sizeof(name), "test.registry.concurrent.%zu", i);
+        g_check_cmp_int(h_get_token_type_number(name), ==, concurrent_ids[i]);
+        for (size_t j = 0; j < i; j++)
+            g_check_cmp_int(concurrent_ids[j], !=, concurrent_ids[i]);
+    }
+}
+
 void register_registry_tests(void) {
     g_test_add_func("/core/registry/allocate_token_new_with_unamb",
                     test_registry_allocate_token_new_with_unamb);
@@ -121,4 +152,5 @@ void register_registry_tests(void) {
                     test_registry_allocate_token_new_initial_allocation);
     g_test_add_func("/core/registry/allocate_token_new_realloc_path",
                     test_registry_allocate_token_new_realloc_path);
+    g_test_add_func("/core/registry/concurrent", test_registry_concurrent);
 }
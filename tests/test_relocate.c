@@ -0,0 +1,113 @@
+#include "glue.h"
+#include "hammer.h"
+#include "internal.h"
+#include "test_suite.h"
+
+#include <glib.h>
+#include <string.h>
+
+static bool not_zero(HParseResult *p, void *user_data) { return p->ast->uint != 0; }
+
+// A grammar that uses most combinators, with a cycle through an indirect.
+static HParser *kitchen_sink(void) {
+    H_RULE(digit, h_ch_range('0', '9'));
+    H_RULE(word, h_many1(h_choice(h_ch_range('a', 'z'), h_ch('_'), NULL)));
+    H_RULE(number, h_attr_bool(h_int_range(h_uint8(), '1', '9'), not_zero, NULL));
+    H_RULE(keyword, h_choice(h_token((const uint8_t *)"let", 3),
+                             h_token((const uint8_t *)"lets", 4), NULL));
+    H_RULE(list, h_middle(h_ch('['), h_sepBy(digit, h_whitespace(h_ch(','))), h_ch(']')));
+    H_RULE(blob, h_length_value(h_int_range(h_uint8(), 0, 3), h_bits(8, false)));
+    H_RULE(perm, h_right(h_ch('%'), h_permutation(h_ch('x'), h_ch('y'), NULL)));
+    H_RULE(be, h_right(h_ch('#'), h_with_endianness(BYTE_LITTLE_ENDIAN, h_uint16())));
+    H_RULE(named, h_right(h_ch('$'), h_put_value(word, "name")));
+    H_RULE(other, h_butnot(h_difference(h_xor(h_ch('!'), h_ch('?')), h_ch('?')), h_ch('~')));
+    H_RULE(look, h_sequence(h_and(h_ch('@')), h_not(h_ch('a')), h_ch('@'), NULL));
+
+    HParser *expr = h_indirect();
+    H_RULE(group, h_middle(h_ch('('), expr, h_ch(')')));
+    H_RULE(item, h_choice(group, keyword, word, list, blob, perm, be, named, other, look,
+                          h_action(h_sequence(number, NULL), h_act_first, NULL), NULL));
+    h_bind_indirect(expr, h_sepBy1(item, h_ch(' ')));
+    return h_sequence(expr, h_optional(h_ch(';')), h_ignore(h_repeat_n(h_epsilon_p(), 2)),
+                      h_end_p(), NULL);
+}
+
+static const char *inputs[] = {
+    "let", "lets", "abc_d", "[1 ,2,3]", "(let (x))", "\x02" "ab", "0", "%yx", "#\x01", "#\x01\x02",
+    "$foo;", "!", "?", "@", "a b (c d) [] 3;", "", NULL,
+};
+
+static void check_same(const HParser *a, const HParser *b) {
+    for (const char **in = inputs; *in; in++) {
+        size_t len = strlen(*in);
+        HParseResult *ra = h_parse(a, (const uint8_t *)*in, len);
+        HParseResult *rb = h_parse(b, (const uint8_t *)*in, len);
+        g_check_cmp_int(ra == NULL, ==, rb == NULL);
+        if (ra && rb) {
+            char *sa = h_write_result_unamb(ra->ast);
+            char *sb = h_write_result_unamb(rb->ast);
+            g_check_string(sa, ==, sb);
+            g_check_cmp_int64(ra->bit_length, ==, rb->bit_length);
+            system_allocator.free(&system_allocator, sa);
+            system_allocator.free(&system_allocator, sb);
+        }
+        h_parse_result_free(ra);
+        h_parse_result_free(rb);
+    }
+}
+
+static void test_relocate_equivalent(void) {
+    HParser *orig = kitchen_sink();
+    HParser *copy = h_relocate(orig);
+
+    g_check_cmp_ptr(copy, !=, NULL);
+    g_check_cmp_int(h_compile(orig, PB_PACKRAT, NULL), ==, 0);
+    g_check_cmp_int(h_compile(copy, PB_PACKRAT, NULL), ==, 0);
+    check_same(orig, copy);
+    h_relocated_free(copy);
+}
+
+typedef struct {
+    const HParser *lo, *hi;
+    size_t count;
+} Extent;
+
+static void extent(const HParser *p, void *ctx) {
+    Extent *e = ctx;
+    if (!e->lo || p < e->lo)
+        e->lo = p;
+    if (!e->hi || p > e->hi)
+        e->hi = p;
+    e->count++;
+}
+
+static void test_relocate_layout(void) {
+    HParser *orig = h_name(kitchen_sink(), "root");
+    HParser *copy = h_relocate(orig);
+    Extent e = {NULL, NULL, 0}, o = {NULL, NULL, 0};
+
+    // the parsers are packed together, root first
+    h_walk_parsers(&system_allocator, copy, extent, &e);
+    h_walk_parsers(&system_allocator, orig, extent, &o);
+    g_check_cmp_int(e.count, ==, o.count);
+    g_check_cmp_ptr(e.lo, ==, copy);
+    g_check_cmp_int64(h_parser_private(e.hi) - h_parser_private(e.lo), ==, e.count - 1);
+
+    // names are copied into the block too
+    size_t size = h_relocated_size(copy, NULL);
+    const char *name = h_parser_private(copy)->name;
+    g_check_string(name, ==, "root");
+    g_check_cmp_int(name > (const char *)copy && name < (const char *)copy + size, ==, true);
+
+    // and the original still works on its own
+    h_relocated_free(copy);
+    g_check_cmp_int(h_compile(orig, PB_PACKRAT, NULL), ==, 0);
+    HParseResult *r = h_parse(orig, (const uint8_t *)"(x)", 3);
+    g_check_cmp_ptr(r, !=, NULL);
+    h_parse_result_free(r);
+}
+
+void register_relocate_tests(void) {
+    g_test_add_func("/core/relocate/equivalent", test_relocate_equivalent);
+    g_test_add_func("/core/relocate/layout", test_relocate_layout);
+}
@@ -17,6 +17,7 @@
 
 #include "test_suite.h"
 
+#include "glue.h"
 #include "hammer.h"
 
 #include <glib.h>
@@ -57,6 +58,22 @@ extern void register_datastructures_tests();
 extern void register_pprint_tests();
 extern void register_sloballoc_tests();
 extern void register_system_allocator_tests();
+extern void register_threadpool_tests();
+extern void register_optimize_tests();
+extern void register_relocate_tests();
+extern void register_image_tests();
+extern void register_profile_tests();
+extern void register_complexity_tests();
+extern void register_budget_tests();
+extern void register_trace_tests();
+
+HParser *expr_grammar(void) {
+    H_RULE(digit, h_ch_range('0', '9'));
+    H_RULE(number, h_many1(digit));
+    H_RULE(sum, h_sequence(number, h_ch('+'), number, NULL));
+    H_RULE(expr, h_choice(sum, number, NULL));
+    return expr;
+}
 
 int main(int argc, char **argv) {
     g_test_init(&argc, &argv, NULL);
@@ -98,6 +115,14 @@ int main(int argc, char **argv) {
     register_pprint_tests();
     register_sloballoc_tests();
     register_system_allocator_tests();
+    register_threadpool_tests();
+    register_optimize_tests();
+    register_relocate_tests();
+    register_image_tests();
+    register_profile_tests();
+    register_complexity_tests();
+    register_budget_tests();
+    register_trace_tests();
 
     g_test_run();
 }
@@ -519,4 +519,9 @@
 #define g_check_cmpfloat(n1, op, n2) g_check_inttype("%g", float, n1, op, n2)
 #define g_check_cmpdouble(n1, op, n2) g_check_inttype("%g", double, n1, op, n2)
 
+// expr = sum | number, sum = number '+' number, number = digit+, each rule
+// named: both alternatives start with number, which the second finds in the
+// packrat cache. Shared by the instrumentation tests.
+HParser *expr_grammar(void);
+
 #endif // #ifndef HAMMER_TEST_SUITE__H
@@ -0,0 +1,56 @@
+#include "hammer.h"
+#include "internal.h"
+#include "test_suite.h"
+
+#include <glib.h>
+
+static void count_item(void *ctx, size_t worker, size_t item) {
+    unsigned *counts = ctx;
+    __atomic_add_fetch(&counts[item], 1, __ATOMIC_RELAXED);
+}
+
+static void test_thread_pool_run(void) {
+    HThreadPool *pool = h_thread_pool_new(4);
+    size_t n = 10007;
+    unsigned *counts = g_new0(unsigned, n);
+
+    g_check_cmp_int(h_thread_pool_size(pool), ==, 4);
+    for (int round = 0; round < 3; round++)
+        h_thread_pool_run(pool, n, count_item, counts);
+    h_thread_pool_run(pool, 0, count_item, counts);
+
+    size_t bad = 0;
+    for (size_t i = 0; i < n; i++)
+        if (counts[i] != 3)
+            bad++;
+    g_check_cmp_int(bad, ==, 0);
+
+    g_free(counts);
+    h_thread_pool_free(pool);
+}
+
+// Uneven work per item must still be spread over all workers.
+static void slow_item(void *ctx, size_t worker, size_t item) {
+    unsigned *per_worker = ctx;
+    volatile unsigned spin = 0;
+    for (size_t i = 0; i < (item < 8 ? 2000000 : 10); i++)
+        spin++;
+    __atomic_add_fetch(&per_worker[worker], 1, __ATOMIC_RELAXED);
+}
+
+static void test_thread_pool_steal(void) {
+    HThreadPool *pool = h_thread_pool_new(4);
+    unsigned per_worker[4] = {0, 0, 0, 0};
+
+    h_thread_pool_run(pool, 64, slow_item, per_worker);
+    g_check_cmp_int(per_worker[0] + per_worker[1] + per_worker[2] + per_worker[3], ==, 64);
+    // worker 0 starts with all the slow items; the others must take some of its share
+    g_check_cmp_int(per_worker[0], <, 16);
+
+    h_thread_pool_free(pool);
+}
+
+void register_threadpool_tests(void) {
+    g_test_add_func("/core/threadpool/run", test_thread_pool_run);
+    g_test_add_func("/core/threadpool/steal", test_thread_pool_steal);
+}
@@ -0,0 +1,120 @@
+#include "glue.h"
+#include "hammer.h"
+#include "test_suite.h"
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+
+static HParser *grammar(void) {
+    H_RULE(line, h_sequence(expr_grammar(), h_end_p(), NULL));
+    return line;
+}
+
+static char *contents(FILE *tmp) {
+    static char buf[65536];
+    rewind(tmp);
+    size_t len = fread(buf, 1, sizeof(buf) - 1, tmp);
+    buf[len] = 0;
+    fclose(tmp);
+    return buf;
+}
+
+static size_t count(const char *s, const char *needle) {
+    size_t n = 0;
+    for (; (s = strstr(s, needle)); s++)
+        n++;
+    return n;
+}
+
+static void test_trace_chrome(void) {
+    HParser *p = grammar();
+    HTrace *trace = h_trace_new(1024);
+    HParseOptions opts = {.trace = trace};
+
+    g_check_cmp_int(h_compile(p, PB_PACKRAT, NULL), ==, 0);
+    HParseResult *r = h_parse_with_options(p, (const uint8_t *)"12", 2, &opts);
+    g_check_cmp_ptr(r, !=, NULL);
+    h_parse_result_free(r);
+    g_check_cmp_uint64(h_trace_dropped(trace), ==, 0);
+
+    FILE *tmp = tmpfile();
+    h_trace_write_chrome(tmp, &trace, 1);
+    char *out = contents(tmp);
+    g_check_cmp_int(strncmp(out, "{\"traceEvents\": [", 17), ==, 0);
+    // line, expr, sum, number twice, digit three times, '+', end
+    g_check_cmp_uint64(count(out, "\"ph\": \"X\""), ==, 10);
+    // sum fails at '+' after the digits
+    g_check_cmp_ptr(strstr(out, "{\"name\": \"sum\", \"cat\": \"backtrack\""), !=, NULL);
+    g_check_cmp_ptr(strstr(out, "\"tid\": 1, \"args\": {\"pos\": 0, \"end\": 2}"), !=, NULL);
+    // the last digit, '+' and sum
+    g_check_cmp_uint64(count(out, "\"cat\": \"backtrack\""), ==, 3);
+    g_check_string(out + strlen(out) - 29, ==, "\n], \"displayTimeUnit\": \"ns\"}\n");
+    h_trace_free(trace);
+}
+
+static void test_trace_folded(void) {
+    HParser *p = grammar();
+    HTrace *traces[2] = {h_trace_new(1024), h_trace_new(1024)};
+    HParseOptions opts = {.trace = traces[0]};
+
+    g_check_cmp_int(h_compile(p, PB_PACKRAT, NULL), ==, 0);
+    h_parse_result_free(h_parse_with_options(p, (const uint8_t *)"1+2", 3, &opts));
+    opts.trace = traces[1];
+    h_parse_result_free(h_parse_with_options(p, (const uint8_t *)"3", 1, &opts));
+
+    FILE *tmp = tmpfile();
+    h_trace_write_folded(tmp, traces, 2);
+    char *out = contents(tmp);
+    // the same stacks from both traces are added up
+    g_check_cmp_int(strncmp(out, "line;expr;sum;number;digit ", 27), ==, 0);
+    g_check_cmp_uint64(count(out, "line;expr;sum;number;digit "), ==, 1);
+    // the second try at number is a cache hit
+    g_check_cmp_ptr(strstr(out, "\nline;expr;number "), !=, NULL);
+    g_check_cmp_ptr(strstr(out, "\nline;expr;number;"), ==, NULL);
+    g_check_cmp_ptr(strstr(out, "\nline "), !=, NULL);
+    h_trace_free(traces[0]);
+    h_trace_free(traces[1]);
+}
+
+static void test_trace_ring(void) {
+    HParser *p = grammar();
+    HTrace *trace = h_trace_new(5);
+    HProfile *profile = h_profile_new();
+    HParseOptions opts = {.profile = profile, .trace = trace};
+
+    g_check_cmp_int(h_compile(p, PB_PACKRAT, NULL), ==, 0);
+    HParseResult *r = h_parse_with_options(p, (const uint8_t *)"1234+5678", 9, &opts);
+    g_check_cmp_ptr(r, !=, NULL);
+    h_parse_result_free(r);
+
+    // only the last eight events are kept: the last digit's and end's calls,
+    // and exits whose calls started before those
+    g_check_cmp_uint64(h_trace_dropped(trace), >, 0);
+    FILE *tmp = tmpfile();
+    h_trace_write_chrome(tmp, &trace, 1);
+    char *out = contents(tmp);
+    g_check_cmp_uint64(count(out, "\"ph\": \"X\""), ==, 2);
+    g_check_cmp_ptr(strstr(out, "{\"name\": \"digit\", \"cat\": \"backtrack\""), !=, NULL);
+    tmp = tmpfile();
+    h_trace_write_folded(tmp, &trace, 1);
+    out = contents(tmp);
+    g_check_cmp_int(strncmp(out, "digit ", 6), ==, 0);
+    g_check_cmp_ptr(strstr(out, "\n<end "), !=, NULL);
+    g_check_cmp_ptr(strstr(out, "line"), ==, NULL);
+
+    h_trace_clear(trace);
+    g_check_cmp_uint64(h_trace_dropped(trace), ==, 0);
+    tmp = tmpfile();
+    h_trace_write_folded(tmp, &trace, 1);
+    g_check_string(contents(tmp), ==, "");
+    g_check_cmp_uint64(h_profile_entry(profile, 0)->calls, ==, 1);
+    h_profile_free(profile);
+    h_trace_free(trace);
+}
+
+void register_trace_tests(void) {
+    g_test_add_func("/core/trace/chrome", test_trace_chrome);
+    g_test_add_func("/core/trace/folded", test_trace_folded);
+    g_test_add_func("/core/trace/ring", test_trace_ring);
+}